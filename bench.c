@@ -0,0 +1,712 @@
+// Microbenchmarks for the game's collision, physics and drawing code
+// Built by `make bench`. The game is compiled into this file without its main()
+// so the benchmarks call the real functions on the real globals. `make check`
+// runs the correctness checks below instead of timing anything.
+#define NINJA_NO_MAIN
+#include "game.c"
+#include <limits.h>
+
+#define BENCH_REPETITIONS 10       // Timed repetitions per benchmark
+#define BENCH_MIN_TIME_NS 50000000 // Each repetition runs at least this long
+#define BENCH_WARMUP_NS 100000000  // Untimed warm-up before the repetitions
+#define BENCH_INPUTS 1024          // Pre-generated random inputs, cycled through
+#define BENCH_MAX_RESULTS 64
+#define PHYSICS_RESET_FRAMES 60    // Restore objects before they all fall off screen
+#define SLICE_RESET_PASSES 16      // Restore objects before slicing empties the screen
+#define CHECK_BROADPHASE_SCENES 200000 // Random scenes slicePass() must slice exactly like the brute-force pass
+#define CHECK_DETERMINISM_STEPS 3000   // Single-thread simulation steps per run, 50 s of play
+#define CHECK_DETERMINISM_SEED 7
+#define CHECK_SLICE_EVERY 5            // Steps between scripted blade strokes
+
+// Runs iters iterations and returns the nanoseconds spent in the timed part
+typedef double (*BenchFn)(void *arg, long iters);
+
+typedef struct
+{
+    char name[64];
+    long iterations;     // Per repetition
+    double per_iter_ns[BENCH_REPETITIONS];
+    double mean_ns;
+    double median_ns;
+    double stddev_ns;
+    double min_ns;
+    double max_ns;
+    double cv;           // Coefficient of variation, stddev / mean
+    double items_per_sec;
+} BenchResult;
+
+// Random line segment and circle, the shape of the inputs the game passes
+typedef struct
+{
+    float x1, y1, x2, y2;
+    float cx, cy, radius;
+} LineCircleInput;
+
+typedef struct
+{
+    GameObject *objects;
+    GameObject *initial; // Snapshot restored between batches
+    int count;
+} PhysicsBench;
+
+BenchResult bench_results[BENCH_MAX_RESULTS];
+int num_bench_results = 0;
+int bench_repetitions = BENCH_REPETITIONS;
+const char *bench_filter = NULL;
+volatile long bench_sink = 0; // Keeps results alive so calls aren't optimised away
+int saved_stdout = -1;
+
+LineCircleInput line_inputs[BENCH_INPUTS];
+float point_inputs[BENCH_INPUTS][2];
+GameObject slice_initial[MAX_FRUITS];
+
+double benchNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+float randRange(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// The game prints a line for every slice; keep it out of the benchmark output
+void benchQuiet(int quiet)
+{
+    fflush(stdout);
+    if (quiet && saved_stdout < 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+        {
+            saved_stdout = dup(STDOUT_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    }
+    else if (!quiet && saved_stdout >= 0)
+    {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+// Place an unsliced object of the given type where the game would have it mid-flight
+void randomObject(GameObject *obj, ObjectType type)
+{
+    memset(obj, 0, sizeof(*obj));
+    obj->active = 1;
+    obj->type = type;
+    obj->x = randRange(0, WINDOW_WIDTH - FRUIT_SIZE);
+    obj->y = randRange(WINDOW_HEIGHT / 4, WINDOW_HEIGHT / 2);
+    obj->vx = randRange(-3.0f, 3.0f);
+    obj->vy = randRange(-10.0f, -7.0f);
+    obj->rotation = randRange(0, 360);
+    obj->rotSpeed = randRange(-5.0f, 5.0f);
+}
+
+int compareResultNs(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Calibrate, warm up and time one benchmark, then summarise its repetitions
+void runBenchmark(const char *name, BenchFn fn, void *arg, int items_per_iter)
+{
+    if (bench_filter != NULL && strstr(name, bench_filter) == NULL)
+    {
+        return;
+    }
+    if (num_bench_results >= BENCH_MAX_RESULTS)
+    {
+        fprintf(stderr, "Too many benchmarks, skipping %s\n", name);
+        return;
+    }
+
+    // Grow the iteration count until one repetition takes long enough to time reliably
+    long iters = 1;
+    double elapsed = fn(arg, iters);
+    while (elapsed < BENCH_MIN_TIME_NS)
+    {
+        double scale = elapsed > 0 ? 1.4 * BENCH_MIN_TIME_NS / elapsed : 10.0;
+        long next = (long)(iters * (scale > 10.0 ? 10.0 : scale));
+        iters = next > iters ? next : iters + 1;
+        elapsed = fn(arg, iters);
+    }
+
+    double warmup_end = benchNowNs() + BENCH_WARMUP_NS;
+    while (benchNowNs() < warmup_end)
+    {
+        fn(arg, iters);
+    }
+
+    BenchResult *r = &bench_results[num_bench_results++];
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->iterations = iters;
+
+    double sorted[BENCH_REPETITIONS];
+    double sum = 0;
+    for (int rep = 0; rep < bench_repetitions; rep++)
+    {
+        r->per_iter_ns[rep] = fn(arg, iters) / iters;
+        sorted[rep] = r->per_iter_ns[rep];
+        sum += r->per_iter_ns[rep];
+    }
+
+    int n = bench_repetitions;
+    qsort(sorted, n, sizeof(double), compareResultNs);
+    r->mean_ns = sum / n;
+    r->median_ns = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    r->min_ns = sorted[0];
+    r->max_ns = sorted[n - 1];
+    double var = 0;
+    for (int rep = 0; rep < n; rep++)
+    {
+        var += (r->per_iter_ns[rep] - r->mean_ns) * (r->per_iter_ns[rep] - r->mean_ns);
+    }
+    r->stddev_ns = n > 1 ? sqrt(var / (n - 1)) : 0;
+    r->cv = r->mean_ns > 0 ? r->stddev_ns / r->mean_ns : 0;
+    r->items_per_sec = r->median_ns > 0 ? items_per_iter * 1e9 / r->median_ns : 0;
+
+    benchQuiet(0);
+    printf("%-32s %12.1f %12.1f %10.1f %7.2f%% %12ld\n",
+           r->name, r->mean_ns, r->median_ns, r->stddev_ns, 100.0 * r->cv, r->iterations);
+}
+
+// Collision primitives
+
+double benchLineCircle(void *arg, long iters)
+{
+    (void)arg;
+    long hits = 0;
+    double start = benchNowNs();
+    for (long i = 0; i < iters; i++)
+    {
+        const LineCircleInput *in = &line_inputs[i & (BENCH_INPUTS - 1)];
+        hits += lineCircleIntersect(in->x1, in->y1, in->x2, in->y2, in->cx, in->cy, in->radius);
+    }
+    double elapsed = benchNowNs() - start;
+    bench_sink += hits;
+    return elapsed;
+}
+
+double benchCheckCollision(void *arg, long iters)
+{
+    GameObject *obj = arg;
+    long hits = 0;
+    double start = benchNowNs();
+    for (long i = 0; i < iters; i++)
+    {
+        const float *p = point_inputs[i & (BENCH_INPUTS - 1)];
+        hits += checkCollision(p[0], p[1], obj);
+    }
+    double elapsed = benchNowNs() - start;
+    bench_sink += hits;
+    return elapsed;
+}
+
+// One slicePass per iteration across the screen, as handleEvents makes on mouse motion
+double benchSlicePass(void *arg, long iters)
+{
+    (void)arg;
+    double elapsed = 0;
+    for (long i = 0; i < iters; i++)
+    {
+        if (i % SLICE_RESET_PASSES == 0)
+        {
+            memcpy(gameObjects, slice_initial, sizeof(gameObjects));
+            num_pending_splats = 0;
+            health = INT_MAX; // Bombs never end the game mid-run
+        }
+
+        const LineCircleInput *in = &line_inputs[i & (BENCH_INPUTS - 1)];
+        prev_mouse_x = in->x1;
+        prev_mouse_y = in->y1;
+        mouse_x = in->x2;
+        mouse_y = in->y2;
+
+        double start = benchNowNs();
+        slicePass(in->x1, in->y1, in->x2, in->y2);
+        elapsed += benchNowNs() - start;
+    }
+    return elapsed;
+}
+
+// Checks
+
+// The slice pass as it was before the broadphase: every live object gets the
+// line pass and then the sampled pass, in slot order
+void bruteForceSlicePass(float x1, float y1, float x2, float y2)
+{
+    int hit[MAX_FRUITS] = {0};
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        GameObject *obj = &gameObjects[i];
+        if (!obj->active || obj->sliced)
+        {
+            continue;
+        }
+        HitShape shape;
+        computeHitShape(obj, &shape);
+        if ((shape.has_banana_box &&
+             lineCircleIntersect(x1, y1, x2, y2, shape.center_x + shape.offset_x, shape.center_y + shape.offset_y,
+                                 shape.line_radius)) ||
+            lineCircleIntersect(x1, y1, x2, y2, shape.center_x, shape.center_y, shape.line_radius))
+        {
+            hit[i] = 1;
+            applySlice(i);
+        }
+    }
+
+    for (int t = 0; t <= SLICE_SAMPLES; t++)
+    {
+        float lerp = (float)t / SLICE_SAMPLES;
+        int slice_x = x1 + (x2 - x1) * lerp;
+        int slice_y = y1 + (y2 - y1) * lerp;
+        for (int i = 0; i < MAX_FRUITS; i++)
+        {
+            GameObject *obj = &gameObjects[i];
+            if (obj->active && !hit[i] && !obj->sliced && checkCollision(slice_x, slice_y, obj))
+            {
+                hit[i] = 1;
+                applySlice(i);
+            }
+        }
+    }
+}
+
+// slicePass() must slice the same objects in the same order as the brute-force
+// pass on random scenes: comparing the whole object array after each pass also
+// compares the rand() draws applySlice() makes, which follow the slice order
+int checkBroadphase()
+{
+    GameObject *scene = malloc(sizeof(gameObjects));
+    GameObject *expected = malloc(sizeof(gameObjects));
+    if (scene == NULL || expected == NULL)
+    {
+        fprintf(stderr, "Out of memory for the broadphase check\n");
+        return 0;
+    }
+
+    long mismatches = 0, sliced = 0;
+    benchQuiet(1);
+    for (int n = 0; n < CHECK_BROADPHASE_SCENES; n++)
+    {
+        memset(scene, 0, sizeof(gameObjects));
+        int count = 1 + rand() % MAX_FRUITS;
+        for (int i = 0; i < count; i++)
+        {
+            randomObject(&scene[rand() % MAX_FRUITS], rand() % 4);
+        }
+
+        // Mostly short strokes like mouse motion, some long swipes, the odd click
+        float x1 = randRange(-FRUIT_SIZE, WINDOW_WIDTH + FRUIT_SIZE);
+        float y1 = randRange(-FRUIT_SIZE, WINDOW_HEIGHT + FRUIT_SIZE);
+        float reach = n % 10 == 0 ? WINDOW_WIDTH : n % 50 == 1 ? 0 : 80;
+        float x2 = x1 + randRange(-reach, reach);
+        float y2 = y1 + randRange(-reach, reach);
+        unsigned int seed = rand();
+
+        memcpy(gameObjects, scene, sizeof(gameObjects));
+        health = INT_MAX;
+        score = 0;
+        srand(seed);
+        bruteForceSlicePass(x1, y1, x2, y2);
+        memcpy(expected, gameObjects, sizeof(gameObjects));
+        int expected_score = score;
+
+        memcpy(gameObjects, scene, sizeof(gameObjects));
+        health = INT_MAX;
+        score = 0;
+        srand(seed);
+        slicePass(x1, y1, x2, y2);
+
+        if (memcmp(expected, gameObjects, sizeof(gameObjects)) != 0 || score != expected_score)
+        {
+            mismatches++;
+        }
+        sliced += expected_score;
+        srand(seed + 1);
+    }
+    num_pending_splats = 0;
+    benchQuiet(0);
+
+    printf("broadphase: %d scenes, %ld fruit sliced, %ld scenes differ from the brute-force pass\n",
+           CHECK_BROADPHASE_SCENES, sliced, mismatches);
+    free(scene);
+    free(expected);
+    return mismatches == 0;
+}
+
+// FNV-1a over a block of memory
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Play CHECK_DETERMINISM_STEPS single-thread steps, drawing a frame every
+// render_every steps, and hash the simulation state after every step. The
+// blade strokes are scripted per step, the way a recorded replay feeds them.
+uint64_t runDeterministicGame(int render_every)
+{
+    single_thread.enabled = 1;
+    single_thread.seed = CHECK_DETERMINISM_SEED;
+    single_thread.steps = 0;
+    memset(&single_thread.spawner, 0, sizeof(single_thread.spawner));
+    spawn_governor.enabled = 0;
+    srand(single_thread.seed);
+    initDeadlockDetector();
+    memset(gameObjects, 0, sizeof(gameObjects)); // As at startup; a reset leaves inactive slots' old values
+    resetGame();
+    health = INT_MAX; // Bombs never end the game, so every step has objects to simulate
+
+    unsigned int script_seed = CHECK_DETERMINISM_SEED;
+    uint64_t hash = 14695981039346656037ULL;
+    for (int step = 1; step <= CHECK_DETERMINISM_STEPS; step++)
+    {
+        if (step % CHECK_SLICE_EVERY == 0)
+        {
+            prev_mouse_x = rand_r(&script_seed) % WINDOW_WIDTH;
+            prev_mouse_y = rand_r(&script_seed) % WINDOW_HEIGHT;
+            mouse_x = prev_mouse_x + rand_r(&script_seed) % 201 - 100;
+            mouse_y = prev_mouse_y + rand_r(&script_seed) % 201 - 100;
+            lockGameMutex();
+            slicePass(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y);
+            unlockGameMutex();
+        }
+
+        singleThreadStep();
+        updateGame();
+        if (step % render_every == 0)
+        {
+            renderGame();
+        }
+
+        hash = hashBytes(hash, gameObjects, sizeof(gameObjects));
+        hash = hashBytes(hash, &score, sizeof(score));
+        hash = hashBytes(hash, &health, sizeof(health));
+        hash = hashBytes(hash, &game_time, sizeof(game_time));
+        hash = hashBytes(hash, &game_state, sizeof(game_state));
+        hash = hashBytes(hash, deadlock_detector.allocation, sizeof(deadlock_detector.allocation));
+    }
+    cleanupDeadlockDetector();
+    return hash;
+}
+
+// --single-thread must play out the same whether every step is drawn or only
+// every third: drawing has its own random numbers and never touches the state
+int checkDeterminism()
+{
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL)
+    {
+        fprintf(stderr, "No offscreen renderer for the determinism check: %s\n", SDL_GetError());
+        return 0;
+    }
+    background_seed = CHECK_DETERMINISM_SEED;
+    createBackground();
+    initSplats();
+
+    benchQuiet(1);
+    uint64_t every_step = runDeterministicGame(1);
+    int final_score = score;
+    uint64_t every_third = runDeterministicGame(3);
+    uint64_t again = runDeterministicGame(1);
+    benchQuiet(0);
+
+    printf("determinism: %d steps, score %d, state hash %016llx drawing every step, %016llx every third, %016llx repeated\n",
+           CHECK_DETERMINISM_STEPS, final_score, (unsigned long long)every_step, (unsigned long long)every_third,
+           (unsigned long long)again);
+
+    single_thread.enabled = 0;
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    renderer = NULL;
+    return every_step == every_third && every_step == again;
+}
+
+// Physics
+
+double benchUpdateObjects(void *arg, long iters)
+{
+    PhysicsBench *pb = arg;
+    double elapsed = 0;
+    long active = 0;
+    for (long i = 0; i < iters; i++)
+    {
+        if (i % PHYSICS_RESET_FRAMES == 0)
+        {
+            memcpy(pb->objects, pb->initial, pb->count * sizeof(GameObject));
+        }
+
+        double start = benchNowNs();
+        active += updateObjects(pb->objects, pb->count);
+        elapsed += benchNowNs() - start;
+    }
+    bench_sink += active;
+    return elapsed;
+}
+
+// The game's own per-frame update, lock and state checks included
+double benchUpdateGame(void *arg, long iters)
+{
+    PhysicsBench *pb = arg;
+    double elapsed = 0;
+    for (long i = 0; i < iters; i++)
+    {
+        if (i % PHYSICS_RESET_FRAMES == 0)
+        {
+            memcpy(gameObjects, pb->initial, sizeof(gameObjects));
+            game_state = STATE_PLAYING;
+            health = INT_MAX;
+        }
+
+        double start = benchNowNs();
+        updateGame();
+        elapsed += benchNowNs() - start;
+    }
+    return elapsed;
+}
+
+// Drawing, against a software renderer on an offscreen surface
+
+double benchFilledCircle(void *arg, long iters)
+{
+    int radius = (int)(intptr_t)arg;
+    double start = benchNowNs();
+    for (long i = 0; i < iters; i++)
+    {
+        filledCircleRGBA(renderer, WINDOW_WIDTH / 2 + radius, WINDOW_HEIGHT / 2 + radius, radius, 255, 30, 30, 255);
+    }
+    return benchNowNs() - start;
+}
+
+double benchDrawFruit(void *arg, long iters)
+{
+    ObjectType type = (ObjectType)(intptr_t)arg;
+    double start = benchNowNs();
+    for (long i = 0; i < iters; i++)
+    {
+        drawFruit(type, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, (i % 360), 0);
+    }
+    return benchNowNs() - start;
+}
+
+void writeBenchJson(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        perror("Failed to write benchmark results");
+        return;
+    }
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host));
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n    \"host_name\": \"%s\",\n", date, host);
+    fprintf(file, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(file, "    \"repetitions\": %d,\n    \"min_time_ns\": %d,\n", bench_repetitions, BENCH_MIN_TIME_NS);
+#ifdef __OPTIMIZE__
+    fprintf(file, "    \"optimized\": true\n");
+#else
+    fprintf(file, "    \"optimized\": false\n");
+#endif
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+
+    for (int b = 0; b < num_bench_results; b++)
+    {
+        const BenchResult *r = &bench_results[b];
+        fprintf(file, "    {\n      \"name\": \"%s\",\n      \"iterations\": %ld,\n", r->name, r->iterations);
+        fprintf(file, "      \"mean_ns\": %.3f,\n      \"median_ns\": %.3f,\n      \"stddev_ns\": %.3f,\n",
+                r->mean_ns, r->median_ns, r->stddev_ns);
+        fprintf(file, "      \"min_ns\": %.3f,\n      \"max_ns\": %.3f,\n      \"cv\": %.5f,\n",
+                r->min_ns, r->max_ns, r->cv);
+        fprintf(file, "      \"items_per_second\": %.1f,\n      \"repetitions_ns\": [", r->items_per_sec);
+        for (int rep = 0; rep < bench_repetitions; rep++)
+        {
+            fprintf(file, "%s%.3f", rep > 0 ? ", " : "", r->per_iter_ns[rep]);
+        }
+        fprintf(file, "]\n    }%s\n", b + 1 < num_bench_results ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    printf("\nResults written to %s\n", path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *json_path = "bench_results.json";
+    int check = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--check") == 0)
+        {
+            check = 1;
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            bench_filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+        {
+            bench_repetitions = atoi(argv[++i]);
+            if (bench_repetitions < 1 || bench_repetitions > BENCH_REPETITIONS)
+            {
+                fprintf(stderr, "--repetitions must be between 1 and %d\n", BENCH_REPETITIONS);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--check] [--json FILE] [--filter SUBSTRING] [--repetitions N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    srand(1234); // Same inputs every run so results are comparable
+    pthread_mutex_init(&game_mutex, NULL);
+
+    if (check)
+    {
+        int ok = checkBroadphase();
+        ok = checkDeterminism() && ok;
+        printf("%s\n", ok ? "All checks passed" : "CHECKS FAILED");
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < BENCH_INPUTS; i++)
+    {
+        LineCircleInput *in = &line_inputs[i];
+        in->x1 = randRange(0, WINDOW_WIDTH);
+        in->y1 = randRange(0, WINDOW_HEIGHT);
+        in->x2 = in->x1 + randRange(-60, 60);
+        in->y2 = in->y1 + randRange(-60, 60);
+        in->cx = randRange(0, WINDOW_WIDTH);
+        in->cy = randRange(0, WINDOW_HEIGHT);
+        in->radius = FRUIT_SIZE / 2;
+        point_inputs[i][0] = WINDOW_WIDTH / 2 + randRange(-FRUIT_SIZE, FRUIT_SIZE);
+        point_inputs[i][1] = WINDOW_HEIGHT / 2 + randRange(-FRUIT_SIZE, FRUIT_SIZE);
+    }
+
+    printf("%-32s %12s %12s %10s %8s %12s\n", "Benchmark", "Mean ns", "Median ns", "Stddev", "CV", "Iterations");
+
+    runBenchmark("lineCircleIntersect", benchLineCircle, NULL, 1);
+
+    const char *type_names[] = {"apple", "banana", "orange", "bomb"};
+    char name[64];
+    for (int type = APPLE; type <= BOMB; type++)
+    {
+        GameObject obj;
+        randomObject(&obj, type);
+        obj.x = WINDOW_WIDTH / 2 - FRUIT_SIZE / 2;
+        obj.y = WINDOW_HEIGHT / 2 - FRUIT_SIZE / 2;
+        snprintf(name, sizeof(name), "checkCollision/%s", type_names[type]);
+        runBenchmark(name, benchCheckCollision, &obj, 1);
+    }
+
+    int densities[] = {25, 100, MAX_FRUITS};
+    for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++)
+    {
+        memset(slice_initial, 0, sizeof(slice_initial));
+        for (int i = 0; i < densities[d]; i++)
+        {
+            randomObject(&slice_initial[i], rand() % 4);
+        }
+        snprintf(name, sizeof(name), "slicePass/%d", densities[d]);
+        benchQuiet(1);
+        runBenchmark(name, benchSlicePass, NULL, 1);
+        benchQuiet(0);
+    }
+
+    // The game's array holds MAX_FRUITS; larger counts run the same loop over a bigger array
+    int counts[] = {200, 10000, 100000};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        PhysicsBench pb;
+        pb.count = counts[c];
+        pb.objects = malloc(pb.count * sizeof(GameObject));
+        pb.initial = malloc((pb.count > MAX_FRUITS ? pb.count : MAX_FRUITS) * sizeof(GameObject));
+        if (pb.objects == NULL || pb.initial == NULL)
+        {
+            fprintf(stderr, "Out of memory for %d objects\n", pb.count);
+            return EXIT_FAILURE;
+        }
+        memset(pb.initial, 0, (pb.count > MAX_FRUITS ? pb.count : MAX_FRUITS) * sizeof(GameObject));
+        for (int i = 0; i < pb.count; i++)
+        {
+            randomObject(&pb.initial[i], rand() % 4);
+            if (i % 3 == 0)
+            {
+                // A third already sliced, so the piece update runs too
+                pb.initial[i].sliced = 1;
+                for (int j = 0; j < SLICE_PIECES; j++)
+                {
+                    pb.initial[i].pieces[j] = (SlicePiece){pb.initial[i].x, pb.initial[i].y,
+                                                           randRange(-4, 4), randRange(-4, 4), 0, 3, SLICE_DURATION};
+                }
+            }
+        }
+
+        snprintf(name, sizeof(name), "updateObjects/%d", pb.count);
+        runBenchmark(name, benchUpdateObjects, &pb, pb.count);
+        if (pb.count <= MAX_FRUITS)
+        {
+            snprintf(name, sizeof(name), "updateGame/%d", pb.count);
+            runBenchmark(name, benchUpdateGame, &pb, pb.count);
+        }
+
+        free(pb.objects);
+        free(pb.initial);
+    }
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL)
+    {
+        fprintf(stderr, "No offscreen renderer, skipping drawing benchmarks: %s\n", SDL_GetError());
+    }
+    else
+    {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        int radii[] = {4, 16, 32, 64};
+        for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++)
+        {
+            snprintf(name, sizeof(name), "filledCircleRGBA/%d", radii[r]);
+            runBenchmark(name, benchFilledCircle, (void *)(intptr_t)radii[r], 1);
+        }
+        for (int type = APPLE; type <= BOMB; type++)
+        {
+            snprintf(name, sizeof(name), "drawFruit/%s", type_names[type]);
+            runBenchmark(name, benchDrawFruit, (void *)(intptr_t)type, 1);
+        }
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+        renderer = NULL;
+    }
+
+    writeBenchJson(json_path);
+    return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // pthread_setname_np
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -8,11 +9,33 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <dirent.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
 #include <math.h>
 #include <stdbool.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ninja_metrics.h"
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define NINJA_HAVE_SDT 1
+#endif
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 // Game constants
 #define WINDOW_WIDTH 800
@@ -45,6 +68,182 @@ typedef struct
 // Slicing animation constants
 #define SLICE_PIECES 2
 #define SLICE_DURATION 30 // frames
+#define SLICE_SAMPLES 12    // Blade samples per slice pass, plus the end point
+#define BROADPHASE_MARGIN 2.0f // px, covers blade samples being rounded to whole pixels
+#define NEAR_MISS_PX 12.0f     // Blade within this of a line circle counts as a near miss
+
+// Adaptive quality governor constants
+#define QUALITY_WINDOW 60          // frames in the rolling frame-time window
+#define FRAME_BUDGET_MS 16.7f      // work budget per frame at 60 FPS
+#define QUALITY_DOWNGRADE 1.15f    // step down when the average exceeds budget by 15%
+#define QUALITY_UPGRADE 0.6f       // step back up when the average is below 60% of budget
+
+// Spawn governor constants
+#define SPAWN_WINDOW 60           // Frames between density decisions
+#define SPAWN_SMOOTHING 0.05f     // Weight of the newest frame in the averages
+#define SPAWN_SIM_SHARE 0.4f      // Share of FRAME_BUDGET_MS the simulation may use
+#define SPAWN_RECOVER 0.75f       // Raise density again when load is below 75% of budget
+#define SPAWN_RECOVER_STEP 5      // Percentage points added per quiet window
+#define SPAWN_MIN_DENSITY 20      // Never shed more than this leaves
+#define SPAWN_MIN_OBJECTS 12      // Live-object cap at minimum density
+
+// Render path calibration constants
+#define RENDER_PATH_FILE "render_path.cfg" // Cached calibration result per machine
+#define ATLAS_CELL (FRUIT_SIZE * 5 / 2)    // Sprite cell, large enough for sliced pieces
+#define ATLAS_ROTATIONS 16                 // Banana frames; its shape changes with rotation
+#define CIRCLE_SEGMENTS 24                 // Triangles per circle on the geometry path
+#define CALIBRATION_OBJECTS 24             // Objects in the synthetic calibration scene
+#define CALIBRATION_RUNS 5                 // Timed runs per render path (plus one warm-up)
+#define CALIBRATION_PATH_BUDGET_MS 200.0   // Stop timing a path once it has used this much
+#define CALIBRATION_PIXEL_TOLERANCE 48     // Per channel; rounding and edge differences don't count
+#define CALIBRATION_MAX_DIFF_PERCENT 10.0  // Paths drawing more of the scene differently aren't used
+
+// Frame capture constants
+#define CAPTURE_BUFFERS 6        // Reusable frame buffers shared with the writer thread
+#define CAPTURE_BUDGET_MS 1.0    // Target render thread cost per captured frame
+
+// Replay constants
+#define REPLAY_MAGIC "NFREPLY3"       // File signature (8 bytes, no terminator stored)
+#define REPLAY_KEYFRAME_INTERVAL 60   // Recorded frames between seekable index entries
+#define REPLAY_BUFFERS 32             // Frames the writer thread may fall behind by before frames are dropped
+#define REPLAY_PREROLL 16             // Frames rendered before a segment so the trail has history
+
+// Spectator stream constants
+#define SPECTATE_MAGIC 0x50534a4e // "NJSP"
+#define SPECTATE_KEYFRAME 1       // Message types
+#define SPECTATE_DELTA 2
+#define SPECTATE_OBJ_FULL 1       // Object record ops: slot spawned or reused, whole object follows
+#define SPECTATE_OBJ_GONE 2       // Slot despawned
+#define SPECTATE_OBJ_DELTA 3      // Changed words of an object the spectator already has
+#define SPECTATE_OBJECT_WORDS (sizeof(GameObject) / sizeof(uint32_t))
+#define SPECTATE_MAX_MESSAGE (sizeof(SpectateHeader) + MAX_FRUITS * (2 + sizeof(uint32_t) + sizeof(GameObject)))
+#define SPECTATE_BUFFERS 4        // Snapshots shared between updateGame() and the encoder
+#define SPECTATE_WAIT_MS 100      // Encoder checks for new spectators at least this often
+#define SPECTATE_STALL_MS 5000    // Disconnect a spectator that has taken nothing for this long
+
+// Juice splat constants
+#define MAX_PENDING_SPLATS 32   // Splats waiting to be drawn into the accumulation texture
+#define SPLAT_ALPHA 150         // Opacity of a fresh splat
+#define SPLAT_FADE_INTERVAL 30  // Frames between fade passes
+#define SPLAT_FADE_ALPHA 6      // Background opacity blended back in per fade pass
+#define SPLAT_FADE_PASSES 240   // Fade passes after the last splat (about two minutes)
+
+// Performance overlay constants
+#define PERF_HISTORY 120       // Frames shown in the frame-time graph
+#define PERF_BUCKETS 500       // Histogram buckets; the last one collects everything slower
+#define PERF_BUCKET_MS 0.1     // Histogram bucket width (0-50 ms range)
+
+// Draw accounting constants
+#define DRAW_SCOPE_DEPTH 8
+
+// USDT probes under the ninja_fruit provider. With sys/sdt.h each probe is a
+// single nop plus a note in the binary, so they cost nothing until bpftrace or
+// perf attaches; without it they compile away.
+#ifdef NINJA_HAVE_SDT
+#define NINJA_PROBE(name) DTRACE_PROBE(ninja_fruit, name)
+#define NINJA_PROBE1(name, a) DTRACE_PROBE1(ninja_fruit, name, a)
+#define NINJA_PROBE2(name, a, b) DTRACE_PROBE2(ninja_fruit, name, a, b)
+#else
+#define NINJA_PROBE(name) ((void)0)
+#define NINJA_PROBE1(name, a) ((void)0)
+#define NINJA_PROBE2(name, a, b) ((void)0)
+#endif
+
+// Per-thread accounting
+#define MAX_TRACKED_THREADS 16
+#define THREAD_SAMPLE_MS 1000.0
+
+// Shared-memory metrics
+#define METRICS_INTERVAL_MS 100.0 // How often the segment is refreshed
+
+_Static_assert(NINJA_METRICS_RESOURCES == MAX_RESOURCES, "ninja_metrics.h resource count must match MAX_RESOURCES");
+
+// Flight recorder constants
+#define FLIGHT_FRAMES 300            // About five seconds of frames kept in the ring
+#define FLIGHT_DEFAULT_BUDGET_MS 25.0 // --spike-budget without a value
+#define FLIGHT_COOLDOWN_MS 5000.0    // Minimum time between dumps
+#define FLIGHT_WARMUP_FRAMES 60      // Ignore start-up frames
+
+// Frame pacing constants
+#define SIM_STEP_MS (1000.0 / 60.0)   // Fixed simulation step; object speeds are per 60 Hz tick
+#define SIM_MAX_STEPS 4               // Catch-up limit after a stall
+#define PACER_SPIN_MS 1.5             // Sleep until this close to a deadline, then spin
+#define PACER_SAFETY_MS 2.0           // Slack left before vblank when starting a frame late
+#define PACER_SMOOTHING 0.1           // Weight of the newest sample in the running averages
+#define PACER_VSYNC_CHECK_FRAMES 120  // Frames before deciding whether vsync really throttles
+
+// Blade predictor constants
+#define BLADE_DEFAULT_AHEAD_MS 8.0f // Default prediction beyond the newest sample
+#define BLADE_ALPHA 0.7f            // Alpha-beta filter position gain
+#define BLADE_BETA 0.2f             // Alpha-beta filter velocity gain
+#define BLADE_RESET_MS 100.0f       // Gap between samples that starts a new stroke
+#define BLADE_MAX_LEAD_PX 48.0f     // Never draw the blade further ahead than this
+
+// Late-latch constants
+#define LATE_LATCH_EVENTS 64 // Motion events peeked from the queue just before present
+
+// Low-jitter mode constants
+#define LOW_JITTER_MAIN_NICE -10      // Needs CAP_SYS_NICE or a raised RLIMIT_NICE
+#define LOW_JITTER_BACKGROUND_NICE 10 // Spawner and deadlock monitor
+#define LOW_JITTER_STACK_KB 256       // Main thread stack faulted in up front
+
+#define CACHE_LINE 64 // Counters written by different threads live on separate lines
+
+// Single-thread mode constants, in simulation steps at SIM_STEP_MS
+#define SINGLE_THREAD_DEFAULT_SEED 1
+#define SINGLE_THREAD_SPAWN_STEPS 6     // 100 ms, the spawner thread's period
+#define SINGLE_THREAD_DEADLOCK_STEPS 6  // 100 ms, the deadlock monitor's period
+#define SINGLE_THREAD_POWERUP_STEPS 300 // 5 s, the power-up process's period
+
+// Control socket constants
+#define CONTROL_LINE_MAX 4096      // Longest command line
+#define CONTROL_MAX_TOKENS 8
+#define CONTROL_POLL_US 100000     // How often the server checks the game is still running
+#define CONTROL_PATH_STEP_US 4000  // Motion events in a path are this far apart (250 Hz mouse)
+
+// Latency test constants
+#define LATENCY_DEFAULT_SAMPLES 300
+#define LATENCY_INTERVAL_MS 100     // Minimum gap between injected blade events
+#define LATENCY_JITTER_MS 37        // Random extra gap, so injections land anywhere in the frame
+#define LATENCY_SWIPE_PX 40         // Blade movement per injected event (slices need more than 5)
+#define LATENCY_MOUSE_ID 0x4c415459 // Marks injected motion events ("LATY")
+#define LATENCY_PATCH_SIZE 32       // Flash patch in the bottom-right corner
+#define LATENCY_BUCKETS 50          // Report histogram, the last bucket collects everything slower
+#define LATENCY_BUCKET_MS 2.0
+
+// Trace constants (zones are only compiled in with -DNINJA_TRACE, see make TRACE=1)
+#define TRACE_MAX_THREADS 16
+#define TRACE_EVENTS_PER_THREAD (1 << 18) // 6 MB; the main loop's ~16 events a frame fill it in ~4.5 min at 60 Hz
+
+#ifdef NINJA_TRACE
+#define TRACE_BEGIN(name) traceEvent(name, 'B')
+#define TRACE_END(name) traceEvent(name, 'E')
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+// Visual quality levels, from full detail to the cheapest rendering
+typedef enum
+{
+    QUALITY_HIGH,    // Everything drawn
+    QUALITY_MEDIUM,  // Shorter, thinner trail and fewer smoke puffs
+    QUALITY_LOW,     // No trail sparkles, fewer explosion particles
+    QUALITY_MINIMAL, // Simplified fruit (no seeds, texture dots or leaf gradients)
+    QUALITY_LEVELS
+} QualityLevel;
+
+// Ways of drawing the game objects, chosen by startup calibration
+typedef enum
+{
+    RENDER_PROCEDURAL, // drawFruit() straight to the renderer
+    RENDER_ATLAS,      // Sprites pre-rendered once into a texture atlas
+    RENDER_GEOMETRY,   // drawFruit() with circles drawn as triangle fans
+    RENDER_SOFTWARE,   // drawFruit() into a CPU surface uploaded once per frame
+    RENDER_PATHS
+} RenderPath;
 
 // Game data structures
 typedef enum
@@ -94,15 +293,596 @@ typedef struct
     int deadlock_check_active;
 } DeadlockDetector;
 
+// Rolling frame-time window used to pick the quality level
+typedef struct
+{
+    float frame_ms[QUALITY_WINDOW]; // Work time of recent frames
+    int index;                      // Next slot to write
+    int filled;                     // Number of valid samples
+    int frames_since_change;        // Frames since the last level change
+    QualityLevel level;             // Current quality level
+} QualityGovernor;
+
+// Sheds spawns when the machine can't keep up. The main thread measures and
+// decides; the spawner reads density and max_objects atomically.
+typedef struct
+{
+    int enabled;          // Off with --no-spawn-governor and in single-thread mode
+    float work_ms;        // Smoothed frame work time
+    float sim_ms;         // Smoothed simulation time per frame
+    int frames_since_change;
+    int density;          // Percent of the normal spawn chance and formation size
+    int max_objects;      // Live-object cap
+    int min_density;      // Lowest density reached
+    long frames_throttled;
+    long frames;
+} SpawnGovernor;
+
+// Frame capture state shared between the render thread and the writer thread
+typedef struct
+{
+    Uint32 *buffers[CAPTURE_BUFFERS]; // ARGB8888 frames
+    int holds[CAPTURE_BUFFERS];       // Missed refreshes before each frame, filled with the frame before it
+    Uint8 *scratch;                   // Writer's encoding space, still holding the last frame it wrote
+    int free_list[CAPTURE_BUFFERS];   // Buffers available to the render thread
+    int free_count;
+    int queue[CAPTURE_BUFFERS];       // Filled buffers waiting for the writer, in order
+    int queue_head;
+    int queued;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    FILE *file;
+    int is_y4m;   // YUV4MPEG2 stream, otherwise concatenated PPM frames
+    int active;   // Capturing this session
+    int stopping; // Writer should drain the queue and exit
+    long frames_written;
+    long frames_repeated;    // Of those, repeats covering missed refreshes and dropped frames
+    long frames_dropped;     // Frames skipped because the writer fell behind
+    Uint64 last_capture;     // Counter when the last kept frame was captured, 0 before the first
+    long frames_captured;    // Frames the render thread handled (kept or dropped)
+    long frames_over_budget; // Frames where capture cost more than CAPTURE_BUDGET_MS
+    double capture_ms_total; // Render thread time spent in captureFrame()
+    double capture_ms_max;
+} FrameCapture;
+
+// Phases of the main loop timed by the performance overlay
+typedef enum
+{
+    PHASE_EVENTS,   // handleEvents()
+    PHASE_UPDATE,   // updateGame()
+    PHASE_POWERUPS, // checkPowerUps()
+    PHASE_RENDER,   // renderGame() plus overlays and capture
+    PHASE_PRESENT,  // SDL_RenderPresent()
+    PHASE_COUNT
+} FramePhase;
+
+_Static_assert(NINJA_METRICS_PHASES == PHASE_COUNT, "ninja_metrics.h phase count must match FramePhase");
+
+// Hardware counters sampled with --hw-counters
+typedef enum
+{
+    HW_CYCLES,
+    HW_INSTRUCTIONS,
+    HW_CACHE_MISSES,
+    HW_BRANCH_MISSES,
+    HW_COUNTERS
+} HwCounter;
+
+// One thread's perf event group
+typedef struct
+{
+    int leader;             // Group leader fd, -1 if no counter could be opened
+    int fds[HW_COUNTERS];   // -1 where the counter couldn't be opened
+    int slot[HW_COUNTERS];  // Position in the group read, or -1
+    int opened;
+} HwCounterGroup;
+
+// Counter values and thread CPU time at one instant
+typedef struct
+{
+    Uint64 values[HW_COUNTERS];
+    double cpu_ms;
+} HwSample;
+
+// Counts accumulated over many intervals
+typedef struct
+{
+    Uint64 values[HW_COUNTERS];
+    double cpu_ms;
+    long samples;
+} HwTotals;
+
+// An object's hit shapes, as the slice passes test them
+typedef struct
+{
+    float center_x, center_y;
+    float offset_x, offset_y;   // Banana curve offset
+    float line_radius;          // Line pass circle (also at the offset for bananas)
+    int has_banana_box;
+    float banana_left, banana_top, banana_w, banana_h;
+    float orange_radius;        // 0 unless an orange
+    float box_left, box_top, box_size;
+    float radius;
+    int has_lead;               // Fast objects get a bigger circle ahead of them
+    float lead_x, lead_y, lead_radius;
+    float broadphase_radius;    // Nothing above reaches farther from the center
+} HitShape;
+
+// Collision counters, per frame and for the whole run
+typedef struct
+{
+    long passes;        // Slice passes (significant blade movements)
+    long candidates;    // Objects that passed the broadphase
+    long culled;        // Live objects the broadphase skipped
+    long tests;         // Narrow-phase tests run
+    long tests_avoided; // Narrow-phase tests the broadphase saved
+    long hits;
+    long near_misses;   // Candidates the blade passed close to without hitting
+    long cull_errors;   // Culled objects that would have been hit (checked with the overlay on)
+} CollisionStats;
+
+// Collision overlay state
+typedef struct
+{
+    int visible;                 // Toggled with F5
+    int has_pass;
+    float x1, y1, x2, y2;        // Last blade segment
+    char candidate[MAX_FRUITS];  // Passed the broadphase in the last pass
+} CollisionDebug;
+
+// CPU time and scheduling counts of one thread (or the power-up process)
+typedef struct
+{
+    int tid;
+    char name[16];
+    int alive;              // Seen in the latest sample
+    double cpu_ms;          // User + system time
+    long voluntary;         // Context switches from blocking or sleeping
+    long involuntary;       // Context switches from preemption
+    long wakeups;           // Times scheduled onto a CPU, -1 without schedstat
+    double cpu_percent;     // Over the last sample interval
+    double wakeups_per_sec;
+} ThreadStats;
+
+// What is being drawn, for attributing renderer calls
+typedef enum
+{
+    SCOPE_OTHER,      // Outside any scope
+    SCOPE_BACKGROUND, // Background and juice splats
+    SCOPE_HUD,        // Score, timer and hearts
+    SCOPE_APPLE,      // Whole objects, in ObjectType order
+    SCOPE_BANANA,
+    SCOPE_ORANGE,
+    SCOPE_BOMB,
+    SCOPE_PIECES,     // Slice pieces and bomb explosions
+    SCOPE_TRAIL,      // Blade trail
+    SCOPE_MENUS,      // Game over and leaderboard screens
+    SCOPE_PERF,       // The performance and hitbox overlays themselves, not counted
+    DRAW_SCOPES
+} DrawScope;
+
+// Kinds of renderer call
+typedef enum
+{
+    CALL_CLEAR,
+    CALL_COPY,     // RenderCopy and RenderCopyEx
+    CALL_POINT,    // RenderDrawPoint(s)
+    CALL_LINE,     // RenderDrawLine(s)
+    CALL_RECT,     // RenderDrawRect and RenderFillRect(s)
+    CALL_GEOMETRY,
+    CALL_COLOR,    // SetRenderDrawColor, not a draw call
+    DRAW_CALL_TYPES
+} DrawCallType;
+
+// Renderer calls charged to one scope
+typedef struct
+{
+    int calls[DRAW_CALL_TYPES];
+    int primitives; // Points, lines, rects, triangles or copies drawn
+    int instances;  // Times the scope was entered
+} ScopeCounts;
+
+// Fixed-size histogram of millisecond timings
+typedef struct
+{
+    unsigned int counts[PERF_BUCKETS];
+    unsigned int total;
+} Histogram;
+
+// Frame timing and counters gathered for the performance overlay
+typedef struct
+{
+    double frame_start;                // Start of the current frame (ms)
+    double phase_mark;                 // End of the last timed phase (ms)
+    double phase_ms[PHASE_COUNT];      // Current frame's phase timings
+    double last_phase_ms[PHASE_COUNT]; // Previous frame's phase timings
+    double last_frame_ms;              // Previous frame's start-to-start time
+    double frame_history[PERF_HISTORY];
+    int history_index;
+    Histogram frame_hist;
+    Histogram phase_hist[PHASE_COUNT];
+    int draw_calls;          // Renderer calls so far this frame
+    int last_draw_calls;
+    double lock_wait_ms;     // Main thread time spent waiting for game_mutex this frame
+    double last_lock_wait_ms;
+    int active_objects;
+    int visible;             // Overlay toggled on with F3
+    ScopeCounts scope_counts[DRAW_SCOPES]; // This frame's calls by scope
+    ScopeCounts last_scope_counts[DRAW_SCOPES];
+    long total_calls[DRAW_SCOPES][DRAW_CALL_TYPES]; // Whole run, for the exit report
+    long total_primitives[DRAW_SCOPES];
+    long total_instances[DRAW_SCOPES];
+    long frames;
+    CollisionStats collisions;       // This frame's
+    CollisionStats last_collisions;
+    CollisionStats collision_totals;
+} PerfStats;
+
+// One frame's timings and game state in the flight recorder
+typedef struct
+{
+    long frame;
+    double time_ms; // Frame start on the high-resolution counter
+    double frame_ms;
+    double phase_ms[PHASE_COUNT];
+    double lock_wait_ms;
+    int draw_calls;
+    int active_objects;
+    int score;
+    int health;
+    GameState game_state;
+    QualityLevel quality;
+    RenderPath render_path;
+} FlightRecord;
+
+// Frame pacer: vsync when the renderer has it, otherwise a sleep-plus-spin deadline
+typedef struct
+{
+    int vsync_requested;       // --no-vsync clears
+    int vsync;                 // Presents are throttled to the display
+    int refresh_hz;            // 0 if the display doesn't say
+    double target_ms;          // Frame interval aimed for
+    double interval_ms;        // Running average of measured present intervals
+    double work_ms;            // Running average of frame work, excluding the vsync wait
+    double last_present_ms;    // When SDL_RenderPresent() last returned
+    double deadline_ms;        // Next frame start, without vsync
+    double last_sim_ms;
+    double sim_accumulator_ms; // Time not yet simulated
+    double sim_dropped_ms;     // Backlog discarded after stalls
+    long sim_steps;
+    long frames;
+    long late_frames;          // Present intervals over 1.5 x target
+    double interval_sum;
+    double interval_sum_sq;
+    double wait_ms_total;
+} FramePacer;
+
+// Alpha-beta filter over pointer samples: position and velocity (px/ms)
+typedef struct
+{
+    int valid;
+    float x, y;
+    float vx, vy;
+    Uint32 timestamp; // SDL event time of the last sample
+} BladeFilter;
+
+// Blade predictor (--blade-predict [MS])
+typedef struct
+{
+    int enabled;
+    float ahead_ms;   // How far past the newest sample to extrapolate
+    BladeFilter filter;
+    long samples;     // Real samples compared with the filter's expectation
+    double error_sum; // Distance between expectation and sample, px
+    float error_max;
+    long predictions; // Frames drawn with a predicted tip
+} BladePredictor;
+
+// Blade late latch (see lateLatchBlade)
+typedef struct
+{
+    int enabled;           // --no-late-latch turns it off
+    long frames_latched;   // Frames where the tip was extended
+    long events_latched;   // Motion events drawn ahead of handleEvents()
+    long provisional_hits; // Objects highlighted before being sliced
+} LateLatch;
+
+// Low-jitter mode settings and what was achieved
+typedef struct
+{
+    int enabled;        // --low-jitter
+    int main_cpu;       // --main-cpu N, -1 for the last CPU we may run on
+    int cpus;           // CPUs we may run on
+    int pinned;         // Main thread pinned; background threads kept off its CPU
+#ifdef __linux__
+    cpu_set_t background_cpus; // The process's allowed CPUs minus main_cpu
+#endif
+    int main_nice_ok;
+    int locked;         // 0 not locked, 1 current pages, 2 current and future
+    int lock_errno;
+    long prefaulted_kb;
+} LowJitter;
+
+// Spawn pattern state carried between spawner steps
+typedef struct
+{
+    int mode; // 0 = regular, 1 = cluster, 2 = line, 3 = arc
+    int timer;
+    int cooldown;
+    int last_spawn_time; // Seconds, when we last spawned something
+} SpawnerState;
+
+// Single-thread mode: background work runs as simulation steps on the main thread
+typedef struct
+{
+    int enabled;        // --single-thread [SEED]
+    unsigned int seed;  // Seeds rand() for the simulation
+    long steps;         // Simulation steps run, the mode's clock
+    SpawnerState spawner;
+} SingleThread;
+
+// Scripted input over a Unix socket (--control-socket PATH)
+typedef struct
+{
+    const char *path;
+    int listen_fd;
+    pthread_t thread;
+    int started;
+    int pointer_x, pointer_y; // Where the driver last put the pointer, for relative motion
+    long sessions;
+    long commands;
+    long events_pushed;
+    long events_dropped;
+} ControlSocket;
+
+// Where the injected blade event in flight has got to
+typedef enum
+{
+    LATENCY_IDLE,     // Injector may push the next event
+    LATENCY_INJECTED, // On the SDL event queue
+    LATENCY_HANDLED,  // Dequeued by handleEvents()
+    LATENCY_RENDERED  // Flash patch drawn, waiting for present
+} LatencyStage;
+
+// Input-to-photon latency test (--latency-test)
+// The stage hands the sample between the injector thread and the main thread;
+// whichever side moves it on owns the timestamps until then.
+typedef struct
+{
+    int enabled;
+    int samples_wanted;
+    int readback;           // Read the flash patch back before presenting
+    int stage;              // LatencyStage
+    double inject_ms;
+    double handled_ms;
+    double rendered_ms;
+    double readback_ms;     // 0 if the readback failed
+    double *handled;        // Per-sample latency from injection to each stage
+    double *rendered;
+    double *read_back;      // -1 where the readback failed
+    double *presented;
+    int count;
+    int readback_failures;
+    int injector_x;
+    int injector_dx;
+    pthread_t thread;
+    int started;
+} LatencyTest;
+
+// Ring buffer of recent frames, dumped to a file by its own thread when a frame is too slow
+typedef struct
+{
+    FlightRecord ring[FLIGHT_FRAMES];
+    int head;
+    int count;
+    long frames;
+    FlightRecord dump[FLIGHT_FRAMES]; // Snapshot handed to the writer
+    int dump_count;
+    int dump_pending;                 // Writer owns dump[] while set
+    double budget_ms;                 // 0 disables the recorder
+    double last_dump_ms;
+    long spikes;
+    long dumps;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int active;
+    int stopping;
+} FlightRecorder;
+
+// One begin/end/instant event in a thread's trace buffer
+typedef struct
+{
+    const char *name; // Static string
+    double ts_us;     // Microseconds on the high-resolution counter
+    char phase;       // 'B', 'E' or 'i' as in the Chrome trace-event format
+} TraceEvent;
+
+// Per-thread trace buffer, written only by its owning thread
+typedef struct
+{
+    TraceEvent *events;
+    int count;
+    int ready; // Set once events is allocated
+    int tid;
+    long dropped;
+    const char *thread_name;
+} TraceBuffer;
+
+// Juice splat waiting to be drawn
+typedef struct
+{
+    float x;
+    float y;
+    ObjectType type;
+} Splat;
+
+// Replay files hold only fixed-width fields, in native byte order; GameObject
+// is stored as it is, so it must stay made of 32-bit fields
+_Static_assert(sizeof(GameObject) == (9 + 7 * SLICE_PIECES) * 4, "replays store GameObject as 32-bit fields");
+
+// Replay file header, rewritten with the final counts when recording stops
+typedef struct
+{
+    char magic[8];
+    uint32_t background_seed; // Seed the starfield was drawn with
+    uint32_t frame_count;     // Frames actually written
+    uint32_t step_count;      // Simulation steps covered, counting dropped ones
+    uint32_t index_count;     // Entries in the keyframe index
+    uint32_t fps;             // Simulation steps per second; one frame is recorded per step
+    uint32_t reserved;        // Zero, keeps index_offset 8-byte aligned
+    uint64_t index_offset;    // File offset of the keyframe index, an array of uint64_t
+} ReplayHeader;
+
+// Per-frame replay record, preceded by its uint32_t step number and
+// followed by object_count ReplayObjects. A gap in the step numbers is steps
+// dropped while recording, which are rendered as repeats of the frame before.
+typedef struct
+{
+    int32_t score;
+    int32_t health;
+    int32_t game_time;
+    int32_t game_state;
+    int32_t mouse_x, mouse_y;
+    int32_t prev_mouse_x, prev_mouse_y;
+    int32_t mouse_down;
+    int32_t object_count;
+} ReplayFrame;
+
+typedef struct
+{
+    int32_t slot; // Index into gameObjects
+    GameObject object;
+} ReplayObject;
+
+// The state shown by one frame or simulation step, copied off the game thread
+// for the replay writer or the spectator encoder to work on
+typedef struct
+{
+    unsigned int tick;
+    ReplayFrame frame;
+    GameObject objects[MAX_FRUITS];
+} StateSnapshot;
+
+// Replay recording state
+// The render thread only copies each frame into a free snapshot; the writer
+// thread owns the file, the header counts and the index.
+typedef struct
+{
+    FILE *file;
+    ReplayHeader header;
+    uint64_t *index; // File offset of every REPLAY_KEYFRAME_INTERVAL'th frame
+    uint32_t index_capacity;
+    uint64_t offset; // Bytes written so far
+    int active;
+    int failed;      // Write error; later frames are discarded
+    StateSnapshot snapshots[REPLAY_BUFFERS];
+    int free_list[REPLAY_BUFFERS];
+    int free_count;
+    int queue[REPLAY_BUFFERS]; // Filled snapshots, oldest first
+    int queue_head;
+    int queued;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int stopping;
+    uint32_t steps;      // Steps seen by recordReplayStep(), recorded or dropped
+    long frames_dropped; // No free snapshot: the writer was too far behind
+} ReplayRecorder;
+
+// Spectator stream message header, in native byte order since the socket is local
+// Followed by `records` object records: a slot byte, an op byte, then for
+// SPECTATE_OBJ_FULL the whole GameObject, or for SPECTATE_OBJ_DELTA a mask of
+// the object's 32-bit words that changed followed by just those words.
+typedef struct
+{
+    uint32_t magic;           // SPECTATE_MAGIC
+    uint32_t type;            // SPECTATE_KEYFRAME or SPECTATE_DELTA
+    uint32_t tick;            // Simulation step this message brings the spectator to
+    uint32_t length;          // Bytes of object records after the header
+    uint32_t records;
+    uint32_t background_seed; // Starfield to draw
+    ReplayFrame frame;        // Score, health, timer, state and blade, always in full
+} SpectateHeader;
+
+// One connected spectator, owned by the encoder thread
+typedef struct
+{
+    int fd;
+    int has_baseline;                // Sent a keyframe; later messages are deltas from baseline
+    GameObject baseline[MAX_FRUITS]; // Objects as the spectator will have them once out is sent
+    uint8_t out[SPECTATE_MAX_MESSAGE];
+    int out_length;
+    int out_sent;
+    double stalled_since_ms; // When it first had to skip a step in the current stall, 0 if none
+    long messages;
+    long skipped;
+} SpectatorClient;
+
+// Spectator stream: updateGame() queues snapshots, the encoder thread sends
+// each spectator a delta from what it already has
+typedef struct
+{
+    const char *path; // --spectator-socket PATH
+    int listen_fd;
+    int active;
+    int watching; // Connected spectators, read by updateGame() to skip snapshots when nobody watches
+    StateSnapshot snapshots[SPECTATE_BUFFERS];
+    int free_list[SPECTATE_BUFFERS]; // Snapshots available to updateGame()
+    int free_count;
+    int queue[SPECTATE_BUFFERS]; // Filled snapshots waiting for the encoder, in order
+    int queue_head;
+    int queued;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int stopping;
+    SpectatorClient **clients;
+    int client_count;
+    int client_capacity;
+    unsigned int ticks;   // Simulation steps published, main thread only
+    long ticks_dropped;   // No free snapshot because the encoder fell behind, main thread only
+    long ticks_encoded;   // Encoder only from here down
+    long ticks_skipped;   // Per spectator, steps not sent because it hadn't taken the last message
+    long keyframes;
+    long keyframe_bytes;
+    long deltas;
+    long delta_bytes;
+    long spectators_served;
+    long spectators_dropped;
+} SpectatorStream;
+
+// game_mutex counters, updated atomically by every thread that takes the lock
+typedef struct
+{
+    _Alignas(CACHE_LINE) long acquisitions;
+    long contentions;
+    long wait_ns_total;
+} LockCounters;
+
+// Deadlock monitor counters, written by the monitor thread and read by the metrics publisher
+typedef struct
+{
+    _Alignas(CACHE_LINE) long checks;
+    long detected;
+} DeadlockCounters;
+
 // Global variables
+// gameObjects is shared with the spawner and only touched under game_mutex. score,
+// health, the timers, game_state and the mouse globals belong to the main thread;
+// other threads must not read them. running is the one flag every thread polls, so
+// it is only accessed through isRunning() and stopRunning().
 GameObject gameObjects[MAX_FRUITS];
 pthread_mutex_t game_mutex;
+pthread_t main_thread;
 int score = 0;
 int health = 3;        // Player health (hearts)
 int game_time = 0;     // Game timer in seconds
 Uint32 start_time = 0; // Start time in milliseconds
-int running = 1;
+int running = 1;       // Cleared once to stop every thread
 int spawn_pipe[2]; // Pipe for communicating with spawn process
+pid_t powerup_pid = 0; // Forked power-up process
 GameState game_state = STATE_PLAYING;
 ScoreRecord leaderboard[MAX_SCORES];
 int num_scores = 0;
@@ -110,13 +890,137 @@ int num_scores = 0;
 // Deadlock detection globals
 DeadlockDetector deadlock_detector;
 pthread_t deadlock_thread;
+int deadlock_thread_started = 0; // Started by main() once low-jitter settings are in place
 int resources_held[MAX_RESOURCES] = {0};
 int resource_request_probability = 15; // 1 in 15 chance of resource request
 
+// Adaptive quality governor
+QualityGovernor quality_governor;
+
+// Spawn load shedding (--no-spawn-governor)
+SpawnGovernor spawn_governor = {.enabled = 1, .density = 100, .max_objects = MAX_FRUITS - 3, .min_density = 100};
+
 // SDL related variables
 SDL_Window *window = NULL;
 SDL_Renderer *renderer = NULL;
 SDL_Texture *background_texture = NULL;
+unsigned int background_seed = 0; // Seed used to draw the starfield
+
+// Juice splats accumulate in a copy of the background that is drawn instead of it
+SDL_Texture *splat_texture = NULL;
+Splat pending_splats[MAX_PENDING_SPLATS];
+int num_pending_splats = 0;
+int splat_fade_passes = 0; // Fade passes left before the splats are gone
+
+// Render paths
+RenderPath render_path = RENDER_PROCEDURAL;
+const char *render_path_names[RENDER_PATHS] = {"procedural", "atlas", "geometry", "software"};
+SDL_Texture *fruit_atlas = NULL;          // Fruit sprites, whole and sliced; bombs are always procedural
+int atlas_detailed = -1;                  // Detail level the atlas was drawn at, -1 before it is
+SDL_Surface *software_surface = NULL;     // CPU-side target for the software path
+SDL_Renderer *software_renderer = NULL;   // Software renderer drawing into software_surface
+SDL_Texture *software_layer = NULL;       // Streaming texture the surface is uploaded into
+int force_recalibration = 0;              // --recalibrate: ignore the cached choice
+int forced_render_path = -1;              // --render-path NAME: skip calibration entirely
+
+// Gameplay recording
+FrameCapture frame_capture;
+const char *capture_path = NULL; // --record FILE
+
+// Replays
+ReplayRecorder replay_recorder;
+const char *replay_record_path = NULL; // --record-replay FILE
+const char *replay_render_path = NULL; // --render-replay FILE
+const char *replay_output = NULL;      // --out DIR or FILE.y4m
+int replay_jobs = 0;                   // --jobs N (0 = one per CPU)
+
+// Spectator stream
+SpectatorStream spectator_stream = {.listen_fd = -1};
+const char *spectate_path = NULL; // --spectate PATH: watch another game instead of playing
+
+// Performance overlay
+PerfStats perf_stats;
+const char *phase_names[PHASE_COUNT] = {"EVENTS", "UPDATE", "POWERUPS", "RENDER", "PRESENT"};
+const char *scope_names[DRAW_SCOPES] = {"OTHER", "BKGND", "HUD", "APPLE", "BANANA", "ORANGE",
+                                        "BOMB", "PIECES", "TRAIL", "MENUS", "PERF"};
+const char *call_type_names[DRAW_CALL_TYPES] = {"clear", "copy", "point", "line", "rect", "geom", "color"};
+DrawScope draw_scope_stack[DRAW_SCOPE_DEPTH] = {SCOPE_OTHER};
+int draw_scope_depth = 0;
+
+// Hardware counter profiling (--hw-counters)
+int hw_profiling = 0;
+const char *hw_counter_names[HW_COUNTERS] = {"cycles", "instructions", "cache-miss", "branch-miss"};
+HwCounterGroup hw_main_group = {.leader = -1, .fds = {-1, -1, -1, -1}, .slot = {-1, -1, -1, -1}};
+HwCounterGroup hw_spawner_group = {.leader = -1, .fds = {-1, -1, -1, -1}, .slot = {-1, -1, -1, -1}};
+HwSample hw_mark;                     // Main thread sample at the last phase boundary
+HwTotals hw_phase_totals[PHASE_COUNT];
+HwTotals hw_spawner_totals;
+
+// Hitbox debug overlay
+CollisionDebug collision_debug;
+
+// Per-thread CPU accounting
+ThreadStats thread_stats[MAX_TRACKED_THREADS];
+int thread_stats_count = 0;
+double thread_stats_sampled_ms = 0.0;
+
+// Live metrics segment for ninja-top (--metrics-name NAME, --no-metrics)
+const char *metrics_name = NINJA_METRICS_DEFAULT_NAME;
+int metrics_enabled = 1;
+NinjaMetrics *metrics = NULL;
+double metrics_last_publish_ms = 0.0;
+double metrics_rate_mark_ms = 0.0; // Start of the slices/s window
+long metrics_rate_mark_slices = 0;
+long slices_total = 0;             // Fruit sliced since start, main thread only
+LockCounters lock_counters;
+DeadlockCounters deadlock_counters;
+
+// Frame-spike flight recorder, off unless --spike-budget [MS] is given
+FlightRecorder flight_recorder = {.budget_ms = 0.0};
+
+// Frame pacing (--no-vsync)
+FramePacer frame_pacer = {.vsync_requested = 1};
+
+// Blade predictor, off by default
+BladePredictor blade_predictor = {.ahead_ms = BLADE_DEFAULT_AHEAD_MS};
+
+// Blade late latch
+LateLatch late_latch = {.enabled = 1};
+
+// Low-jitter mode
+LowJitter low_jitter = {.main_cpu = -1};
+
+// Single-threaded deterministic mode
+SingleThread single_thread = {.seed = SINGLE_THREAD_DEFAULT_SEED};
+unsigned int visual_rand_state = 1; // Cosmetic randomness, kept off the simulation's rand()
+
+// Test-driver control socket
+ControlSocket control_socket = {.listen_fd = -1};
+
+// Input latency test (--latency-test [N], --latency-readback)
+LatencyTest latency_test = {.samples_wanted = LATENCY_DEFAULT_SAMPLES};
+
+// Chrome trace export
+const char *trace_path = NULL; // --trace FILE
+int trace_enabled = 0;
+TraceBuffer trace_buffers[TRACE_MAX_THREADS];
+int trace_thread_count = 0;
+_Thread_local TraceBuffer *trace_buffer = NULL;
+
+// Count renderer calls by draw scope (a macro doesn't expand inside its own body)
+#define SDL_RenderClear(r) (perfCountDraw(CALL_CLEAR, 1), SDL_RenderClear(r))
+#define SDL_RenderCopy(r, t, s, d) (perfCountDraw(CALL_COPY, 1), SDL_RenderCopy(r, t, s, d))
+#define SDL_RenderCopyEx(r, t, s, d, a, c, f) (perfCountDraw(CALL_COPY, 1), SDL_RenderCopyEx(r, t, s, d, a, c, f))
+#define SDL_RenderDrawPoint(r, x, y) (perfCountDraw(CALL_POINT, 1), SDL_RenderDrawPoint(r, x, y))
+#define SDL_RenderDrawPoints(r, p, n) (perfCountDraw(CALL_POINT, n), SDL_RenderDrawPoints(r, p, n))
+#define SDL_RenderDrawLine(r, x1, y1, x2, y2) (perfCountDraw(CALL_LINE, 1), SDL_RenderDrawLine(r, x1, y1, x2, y2))
+#define SDL_RenderDrawLines(r, p, n) (perfCountDraw(CALL_LINE, (n) - 1), SDL_RenderDrawLines(r, p, n))
+#define SDL_RenderDrawRect(r, rect) (perfCountDraw(CALL_RECT, 1), SDL_RenderDrawRect(r, rect))
+#define SDL_RenderFillRect(r, rect) (perfCountDraw(CALL_RECT, 1), SDL_RenderFillRect(r, rect))
+#define SDL_RenderFillRects(r, rects, n) (perfCountDraw(CALL_RECT, n), SDL_RenderFillRects(r, rects, n))
+#define SDL_RenderGeometry(r, t, v, nv, i, ni) \
+    (perfCountDraw(CALL_GEOMETRY, ((i) != NULL ? (ni) : (nv)) / 3), SDL_RenderGeometry(r, t, v, nv, i, ni))
+#define SDL_SetRenderDrawColor(r, red, g, b, a) (perfCountDraw(CALL_COLOR, 0), SDL_SetRenderDrawColor(r, red, g, b, a))
 
 // Sound effects
 Mix_Chunk *sliceSound = NULL;
@@ -134,6 +1038,7 @@ void *spawnObjects(void *arg);
 void handleEvents();
 void updateGame();
 void renderGame();
+int updateObjects(GameObject *objects, int count);
 void cleanupGame();
 void saveScore();
 void signalHandler(int sig);
@@ -141,6 +1046,19 @@ void processSpawner();
 void drawFruit(ObjectType type, float x, float y, float rotation, int sliced);
 void filledCircleRGBA(SDL_Renderer *renderer, int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
 int checkCollision(float slice_x, float slice_y, GameObject *obj);
+void computeHitShape(const GameObject *obj, HitShape *shape);
+int hitShapeContains(const HitShape *shape, float slice_x, float slice_y);
+int hitShapeLineHit(const HitShape *shape, float x1, float y1, float x2, float y2);
+float segmentDistanceSq(float x1, float y1, float x2, float y2, float px, float py);
+void slicePass(float x1, float y1, float x2, float y2);
+void drawCircleOutline(float x, float y, float radius);
+void toggleCollisionDebug();
+void drawCollisionDebug();
+void printCollisionStats();
+float bladeFilterUpdate(BladeFilter *f, float x, float y, Uint32 timestamp);
+int bladeFilterPredict(const BladeFilter *f, Uint32 timestamp, float ahead_ms, float *x, float *y);
+void bladePredictorSample(int x, int y, Uint32 timestamp);
+void lateLatchBlade();
 int lineCircleIntersect(float line_x1, float line_y1, float line_x2, float line_y2, float circle_x, float circle_y, float radius);
 void spawnFruit(int index);
 void spawnFruitAt(int index, float x, float y, float vx, float vy);
@@ -150,6 +1068,117 @@ void saveScores();
 void addScore(int new_score);
 void drawDigitalChar(SDL_Renderer *renderer, char c, int x, int y, int w, int h);
 void drawDigitalText(SDL_Renderer *renderer, const char *text, int x, int y, int charWidth, int charHeight, int spacing);
+void updateQualityGovernor(float frame_ms);
+void updateSpawnGovernor(float work_ms, float sim_ms);
+int spawnChance(int one_in, int density);
+int formationSize(int count, int density, int room);
+void printSpawnGovernor();
+void parseArgs(int argc, char *argv[]);
+void initRenderPaths();
+void bakeFruitAtlas();
+void cleanupRenderPaths();
+void calibrateRenderPath();
+void drawGameObjects(GameObject *objects, int count);
+void filledCircleGeometry(SDL_Renderer *renderer, int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+int startFrameCapture(const char *path);
+void freeFrameCaptureBuffers();
+void captureFrame();
+void stopFrameCapture();
+void createBackground();
+void initSplats();
+void queueSplat(float x, float y, ObjectType type);
+void updateSplats();
+void applySlice(int i);
+double perfNowMs();
+void lockGameMutex();
+void unlockGameMutex();
+int isRunning();
+void stopRunning();
+void perfCountDraw(DrawCallType type, int primitives);
+void drawScopePush(DrawScope scope);
+void drawScopePop();
+void printDrawStats();
+void hwCountersOpen(HwCounterGroup *group);
+void hwCountersRead(HwCounterGroup *group, HwSample *sample);
+void hwCountersAccumulate(HwTotals *totals, const HwSample *start, const HwSample *end);
+void hwCountersClose(HwCounterGroup *group);
+void printHwRow(const char *name, const HwTotals *totals, const HwCounterGroup *group);
+void printHwCounters();
+void nameThread(const char *name);
+int readProcFile(const char *path, char *buffer, size_t size);
+void sampleTask(const char *dir, int tid, double elapsed_ms);
+void sampleThreadStats(int force);
+void printThreadStats();
+void openMetrics();
+void publishMetrics();
+void closeMetrics();
+int compareDoubles(const void *a, const void *b);
+void perfBeginFrame();
+void perfEndPhase(FramePhase phase);
+double perfWorkMs();
+void togglePerfOverlay();
+void drawPerfOverlay();
+int startFlightRecorder();
+void flightRecordFrame(double frame_ms);
+void *flightRecorderWriter(void *arg);
+void stopFlightRecorder();
+void initFramePacer();
+void pacerSleepUntil(double deadline_ms);
+int framePacerSimSteps();
+double framePacerWorkMs();
+void framePacerPresented();
+void framePacerWait();
+void printFramePacing();
+int startLatencyTest();
+void *latencyInjector(void *arg);
+void latencyEventHandled();
+void drawLatencyPatch();
+void latencyFramePresented();
+void printLatencyRow(const char *name, const double *samples, int count);
+void stopLatencyTest();
+long prefault(void *memory, size_t size);
+void applyLowJitter();
+void lowJitterThread(int lower_priority);
+void singleThreadStep();
+Uint32 simNowMs();
+int visualRand();
+void spawnTick(SpawnerState *sp, int current_time);
+void deadlockTick();
+int rollPowerUp();
+void activatePowerUp(int power_type);
+int startControlSocket();
+long controlNowUs();
+int controlSleepUntil(long t_us);
+void controlPush(SDL_Event *e);
+void controlPushMotion(int x, int y, int xrel, int yrel);
+void controlReply(int fd, const char *format, ...);
+void controlReplyStats(int fd);
+int controlCommand(int fd, char *line, long session_start_us);
+void *controlSocketServer(void *arg);
+void stopControlSocket();
+#ifdef NINJA_TRACE
+void traceEvent(const char *name, char phase);
+void traceThreadName(const char *name);
+void writeTrace(const char *path);
+#endif
+int startReplayRecording(const char *path);
+void recordReplayStep();
+int writeReplayFrame(ReplayRecorder *rr, StateSnapshot *snapshot);
+void *replayWriter(void *arg);
+void stopReplayRecording();
+int renderReplay(const char *replay_path, const char *out, int jobs);
+ReplayFrame currentReplayFrame();
+void applyReplayFrame(const ReplayFrame *frame);
+int startSpectatorStream();
+void publishSpectatorTick();
+int encodeSpectatorMessage(SpectatorClient *client, const StateSnapshot *snapshot);
+void *spectatorEncoder(void *arg);
+void stopSpectatorStream();
+int flushSpectator(SpectatorClient *client);
+void dropSpectator(int index, const char *reason);
+void acceptSpectators();
+int applySpectatorMessage(const uint8_t *message, int length);
+int runSpectator(const char *path);
 
 // Initialize deadlock detector
 void initDeadlockDetector()
@@ -338,52 +1367,68 @@ void recoverFromDeadlock()
     pthread_mutex_unlock(&deadlock_detector.deadlock_mutex);
 }
 
-// Deadlock thread function
-void *deadlockMonitor(void *arg)
+// One monitor step: simulated processes randomly request and release
+// resources, and every so often the detector looks for a deadlock
+void deadlockTick()
 {
-    (void)arg; // Unused parameter
-
-    while (running)
+    // Simulate resource requests at random intervals
+    if (rand() % resource_request_probability == 0)
     {
-        // Simulate resource requests at random intervals
-        if (rand() % resource_request_probability == 0)
-        {
-            int process_id = rand() % MAX_PROCESSES;
-            int resource_id = rand() % MAX_RESOURCES;
-            int amount = 1 + rand() % 2; // Request 1-2 resources
+        int process_id = rand() % MAX_PROCESSES;
+        int resource_id = rand() % MAX_RESOURCES;
+        int amount = 1 + rand() % 2; // Request 1-2 resources
 
-            int result = requestResource(process_id, resource_id, amount);
-            if (result == 1)
-            {
-                printf("Process %d acquired %d of resource %d\n",
-                       process_id, amount, resource_id);
-            }
+        int result = requestResource(process_id, resource_id, amount);
+        if (result == 1)
+        {
+            printf("Process %d acquired %d of resource %d\n",
+                   process_id, amount, resource_id);
         }
+    }
 
-        // Simulate resource releases at random intervals
-        if (rand() % (resource_request_probability * 2) == 0)
-        {
-            int process_id = rand() % MAX_PROCESSES;
-            int resource_id = rand() % MAX_RESOURCES;
+    // Simulate resource releases at random intervals
+    if (rand() % (resource_request_probability * 2) == 0)
+    {
+        int process_id = rand() % MAX_PROCESSES;
+        int resource_id = rand() % MAX_RESOURCES;
 
-            if (deadlock_detector.allocation[process_id][resource_id] > 0)
-            {
-                int amount = 1;
-                releaseResource(process_id, resource_id, amount);
-                printf("Process %d released %d of resource %d\n",
-                       process_id, amount, resource_id);
-            }
+        if (deadlock_detector.allocation[process_id][resource_id] > 0)
+        {
+            int amount = 1;
+            releaseResource(process_id, resource_id, amount);
+            printf("Process %d released %d of resource %d\n",
+                   process_id, amount, resource_id);
         }
+    }
 
-        // Run deadlock detection periodically
-        if (rand() % (resource_request_probability * 3) == 0)
+    // Run deadlock detection periodically
+    if (rand() % (resource_request_probability * 3) == 0)
+    {
+        int deadlock = detectDeadlock();
+        __atomic_fetch_add(&deadlock_counters.checks, 1, __ATOMIC_RELAXED);
+        if (deadlock == 1)
         {
-            int deadlock = detectDeadlock();
-            if (deadlock == 1)
-            {
-                recoverFromDeadlock();
-            }
+            __atomic_fetch_add(&deadlock_counters.detected, 1, __ATOMIC_RELAXED);
+            NINJA_PROBE(deadlock_detected);
+            recoverFromDeadlock();
+            NINJA_PROBE(deadlock_recovered);
         }
+    }
+}
+
+// Deadlock thread function
+void *deadlockMonitor(void *arg)
+{
+    (void)arg; // Unused parameter
+    nameThread("ninja-deadlock");
+    lowJitterThread(1);
+    TRACE_THREAD_NAME("deadlockMonitor");
+
+    while (isRunning())
+    {
+        TRACE_BEGIN("deadlockTick");
+        deadlockTick();
+        TRACE_END("deadlockTick");
 
         // Sleep to prevent excessive CPU usage
         usleep(100000); // 100ms
@@ -392,2047 +1437,6855 @@ void *deadlockMonitor(void *arg)
     return NULL;
 }
 
-// Draw fruit function - renders different types of fruits/bombs
-void drawFruit(ObjectType type, float x, float y, float rotation, int sliced)
+// Feed one frame's work time to the quality governor and adjust the level
+// Steps down one level when the rolling average blows the budget, and back
+// up when there is plenty of headroom. A full window must pass between
+// changes so the level doesn't oscillate.
+void updateQualityGovernor(float frame_ms)
 {
-    const int halfSize = FRUIT_SIZE / 2;
+    QualityGovernor *qg = &quality_governor;
 
-    // Different colors and shapes for different fruits
-    switch (type)
+    qg->frame_ms[qg->index] = frame_ms;
+    qg->index = (qg->index + 1) % QUALITY_WINDOW;
+    if (qg->filled < QUALITY_WINDOW)
     {
-    case APPLE:
-        if (!sliced)
-        {
-            // Red apple with gradient
-            filledCircleRGBA(renderer, x, y, halfSize - 5, 220, 0, 0, 255);
-            filledCircleRGBA(renderer, x, y, halfSize - 8, 255, 30, 30, 255);
-            // Highlight
-            filledCircleRGBA(renderer, x - halfSize / 3, y - halfSize / 3, halfSize / 4, 255, 100, 100, 200);
-
-            // Stem
-            SDL_SetRenderDrawColor(renderer, 139, 69, 19, 255);
-            SDL_Rect stem = {x - 3, y - halfSize + 5, 6, 10};
-            SDL_RenderFillRect(renderer, &stem);
+        qg->filled++;
+    }
+    qg->frames_since_change++;
 
-            // Leaf
-            SDL_SetRenderDrawColor(renderer, 0, 150, 0, 255);
-            SDL_Point leaf[4] = {
-                {x + 6, y - halfSize + 8},
-                {x + 18, y - halfSize + 2},
-                {x + 15, y - halfSize + 6},
-                {x + 6, y - halfSize + 12}};
-            int numPoints = 4;
-            SDL_RenderDrawLines(renderer, leaf, numPoints);
+    if (qg->filled < QUALITY_WINDOW || qg->frames_since_change < QUALITY_WINDOW)
+    {
+        return;
+    }
 
-            // Fill leaf with gradient
-            for (int i = 0; i < 5; i++)
-            {
-                SDL_SetRenderDrawColor(renderer, 0, 150 - i * 10, 0, 255);
-                SDL_Point leafFill[] = {
-                    {x + 6, y - halfSize + 8 + i},
-                    {x + 15 - i, y - halfSize + 5},
-                    {x + 10, y - halfSize + 10}};
-                SDL_RenderDrawLines(renderer, leafFill, 3);
-            }
-        }
-        else
-        {
-            // Sliced apple - two halves with more detail
-            // Left half
-            filledCircleRGBA(renderer, x - 15, y, halfSize - 10, 220, 0, 0, 255);
-            filledCircleRGBA(renderer, x - 15, y, halfSize - 13, 240, 20, 20, 255);
+    float total = 0.0f;
+    for (int i = 0; i < QUALITY_WINDOW; i++)
+    {
+        total += qg->frame_ms[i];
+    }
+    float average = total / QUALITY_WINDOW;
 
-            // Right half
-            filledCircleRGBA(renderer, x + 15, y, halfSize - 10, 220, 0, 0, 255);
-            filledCircleRGBA(renderer, x + 15, y, halfSize - 13, 240, 20, 20, 255);
+    QualityLevel new_level = qg->level;
+    if (average > FRAME_BUDGET_MS * QUALITY_DOWNGRADE && qg->level < QUALITY_LEVELS - 1)
+    {
+        new_level = qg->level + 1;
+    }
+    else if (average < FRAME_BUDGET_MS * QUALITY_UPGRADE && qg->level > QUALITY_HIGH)
+    {
+        new_level = qg->level - 1;
+    }
 
-            // White inside with seeds and flesh details
-            filledCircleRGBA(renderer, x - 15, y, halfSize - 15, 255, 240, 240, 255);
-            filledCircleRGBA(renderer, x + 15, y, halfSize - 15, 255, 240, 240, 255);
+    if (new_level != qg->level)
+    {
+        printf("Quality level changed to: %d (avg frame %.2f ms)\n", new_level, average);
+        qg->level = new_level;
+        qg->frames_since_change = 0;
+    }
+}
 
-            // Seeds
-            SDL_SetRenderDrawColor(renderer, 80, 40, 0, 255);
-            for (int i = 0; i < 5; i++)
-            {
-                float angle = M_PI * i / 5.0;
-                SDL_Rect seed1 = {
-                    x - 15 + cos(angle) * (halfSize - 25) - 1,
-                    y + sin(angle) * (halfSize - 25) - 2,
-                    3, 4};
-                SDL_Rect seed2 = {
-                    x + 15 + cos(angle) * (halfSize - 25) - 1,
-                    y + sin(angle) * (halfSize - 25) - 2,
-                    3, 4};
-                SDL_RenderFillRect(renderer, &seed1);
-                SDL_RenderFillRect(renderer, &seed2);
-            }
+// Feed one frame's work time and simulation time to the spawn governor
+// Visual quality goes first: frame time only counts against spawning once the
+// quality governor is at its lowest level, while simulation time, which only
+// fewer objects can reduce, always does. Once per window an overload cuts the
+// density in proportion (20% over budget keeps 1/1.2 of it) and the live-object
+// cap follows; a quiet window gives a few points back.
+void updateSpawnGovernor(float work_ms, float sim_ms)
+{
+    SpawnGovernor *sg = &spawn_governor;
+    if (!sg->enabled)
+    {
+        return;
+    }
 
-            // Flesh details
-            SDL_SetRenderDrawColor(renderer, 230, 210, 210, 255);
-            for (int i = 0; i < 8; i++)
-            {
-                float angle = 2 * M_PI * i / 8.0;
-                SDL_RenderDrawLine(renderer,
-                                   x - 15, y,
-                                   x - 15 + cos(angle) * (halfSize - 17),
-                                   y + sin(angle) * (halfSize - 17));
-                SDL_RenderDrawLine(renderer,
-                                   x + 15, y,
-                                   x + 15 + cos(angle) * (halfSize - 17),
-                                   y + sin(angle) * (halfSize - 17));
-            }
-        }
-        break;
+    if (sg->frames == 0)
+    {
+        sg->work_ms = work_ms;
+        sg->sim_ms = sim_ms;
+    }
+    sg->work_ms += (work_ms - sg->work_ms) * SPAWN_SMOOTHING;
+    sg->sim_ms += (sim_ms - sg->sim_ms) * SPAWN_SMOOTHING;
+    sg->frames++;
+    if (sg->density < 100)
+    {
+        sg->frames_throttled++;
+    }
+    if (++sg->frames_since_change < SPAWN_WINDOW)
+    {
+        return;
+    }
+    sg->frames_since_change = 0;
 
-    case BANANA:
-        if (!sliced)
-        {
-            // Yellow banana with gradient and curvature
-            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    float load = sg->sim_ms / (FRAME_BUDGET_MS * SPAWN_SIM_SHARE);
+    if (quality_governor.level == QUALITY_LEVELS - 1)
+    {
+        load = fmaxf(load, sg->work_ms / FRAME_BUDGET_MS);
+    }
 
-            // Draw a curved banana shape with gradient
-            for (int i = -20; i <= 20; i++)
-            {
-                float angle = (float)i / 20.0f * 3.14f;
-                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
+    int density = sg->density;
+    if (load > 1.0f)
+    {
+        density = (int)(density / load);
+    }
+    else if (load < SPAWN_RECOVER)
+    {
+        density += SPAWN_RECOVER_STEP;
+    }
+    density = density < SPAWN_MIN_DENSITY ? SPAWN_MIN_DENSITY : density > 100 ? 100 : density;
+    if (density == sg->density)
+    {
+        return;
+    }
+
+    int max_objects = SPAWN_MIN_OBJECTS + (MAX_FRUITS - 3 - SPAWN_MIN_OBJECTS) * density / 100;
+    printf("Spawn governor: %s from %d%% to %d%% density, at most %d objects (frame %.2f ms, simulation %.2f ms, %.1f s in)\n",
+           density < sg->density ? "throttled" : "recovered", sg->density, density, max_objects,
+           sg->work_ms, sg->sim_ms, SDL_GetTicks() / 1000.0);
+    if (density < sg->min_density)
+    {
+        sg->min_density = density;
+    }
+    __atomic_store_n(&sg->density, density, __ATOMIC_RELAXED);
+    __atomic_store_n(&sg->max_objects, max_objects, __ATOMIC_RELAXED);
+}
+
+// Roll a 1 in one_in spawn chance, scaled down to density percent
+int spawnChance(int one_in, int density)
+{
+    return rand() % (one_in * 100) < density;
+}
+
+// Shrink a formation to density percent, keeping at least two objects,
+// then to the room left under the live-object cap
+int formationSize(int count, int density, int room)
+{
+    int scaled = (count * density + 50) / 100;
+    if (scaled < 2)
+    {
+        scaled = 2;
+    }
+    return scaled < room ? scaled : room;
+}
+
+// Print how much the spawn governor had to shed
+void printSpawnGovernor()
+{
+    SpawnGovernor *sg = &spawn_governor;
+    if (sg->frames == 0)
+    {
+        return;
+    }
+
+    printf("Spawn governor: throttled for %ld of %ld frames (%.1f%%), lowest density %d%%, ending at %d%%\n",
+           sg->frames_throttled, sg->frames, 100.0 * sg->frames_throttled / sg->frames, sg->min_density, sg->density);
+}
+
+// Current time from the high-resolution counter, in milliseconds
+double perfNowMs()
+{
+    return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Add a sample to a fixed-size histogram
+void histogramAdd(Histogram *hist, double ms)
+{
+    int bucket = (int)(ms / PERF_BUCKET_MS);
+    if (bucket >= PERF_BUCKETS)
+    {
+        bucket = PERF_BUCKETS - 1;
+    }
+    if (bucket < 0)
+    {
+        bucket = 0;
+    }
+    hist->counts[bucket]++;
+    hist->total++;
+}
+
+// Value below which the given fraction of samples fall, in milliseconds
+double histogramPercentile(const Histogram *hist, double fraction)
+{
+    if (hist->total == 0)
+    {
+        return 0.0;
+    }
+
+    unsigned int target = (unsigned int)(hist->total * fraction);
+    unsigned int seen = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen > target)
+        {
+            return (i + 0.5) * PERF_BUCKET_MS;
+        }
+    }
+    return PERF_BUCKETS * PERF_BUCKET_MS;
+}
+
+// Lock game_mutex, timing how long the main thread had to wait for it
+void lockGameMutex()
+{
+    // Nothing else touches the game state in single-thread mode
+    if (single_thread.enabled)
+    {
+        return;
+    }
+
+    __atomic_fetch_add(&lock_counters.acquisitions, 1, __ATOMIC_RELAXED);
+    if (pthread_mutex_trylock(&game_mutex) == 0)
+    {
+        NINJA_PROBE1(lock_acquire, 0L);
+        return;
+    }
+
+    double start = perfNowMs();
+    TRACE_BEGIN("wait game_mutex");
+    pthread_mutex_lock(&game_mutex);
+    TRACE_END("wait game_mutex");
+    double wait_ms = perfNowMs() - start;
+    long wait_ns = (long)(wait_ms * 1000000.0);
+    __atomic_fetch_add(&lock_counters.contentions, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&lock_counters.wait_ns_total, wait_ns, __ATOMIC_RELAXED);
+    NINJA_PROBE1(lock_acquire, wait_ns);
+    if (pthread_equal(pthread_self(), main_thread))
+    {
+        perf_stats.lock_wait_ms += wait_ms;
+    }
+}
+
+// Unlock game_mutex
+void unlockGameMutex()
+{
+    if (single_thread.enabled)
+    {
+        return;
+    }
+
+    NINJA_PROBE(lock_release);
+    pthread_mutex_unlock(&game_mutex);
+}
+
+// Whether the game is still running, safe from any thread
+int isRunning()
+{
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+// Ask every thread to stop; what was written before is visible to them once they see it
+void stopRunning()
+{
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+}
+
+#ifdef NINJA_TRACE
+// Record a trace event in the calling thread's buffer
+// Each thread appends only to its own buffer, registered on first use with
+// an atomic increment, so recording never takes a lock. Events past the
+// buffer's capacity are dropped.
+void traceEvent(const char *name, char phase)
+{
+    if (!trace_enabled)
+    {
+        return;
+    }
+
+    if (trace_buffer == NULL)
+    {
+        int slot = __atomic_fetch_add(&trace_thread_count, 1, __ATOMIC_RELAXED);
+        if (slot >= TRACE_MAX_THREADS)
+        {
+            return;
+        }
+        TraceBuffer *buffer = &trace_buffers[slot];
+        buffer->events = malloc(TRACE_EVENTS_PER_THREAD * sizeof(TraceEvent));
+        if (buffer->events == NULL)
+        {
+            return;
+        }
+        buffer->tid = slot + 1;
+        if (buffer->thread_name == NULL)
+        {
+            buffer->thread_name = "thread"; // Until traceThreadName() says otherwise
+        }
+        __atomic_store_n(&buffer->ready, 1, __ATOMIC_RELEASE);
+        trace_buffer = buffer;
+    }
+
+    int count = trace_buffer->count;
+    if (count >= TRACE_EVENTS_PER_THREAD)
+    {
+        trace_buffer->dropped++;
+        return;
+    }
+    trace_buffer->events[count] = (TraceEvent){name, perfNowMs() * 1000.0, phase};
+    __atomic_store_n(&trace_buffer->count, count + 1, __ATOMIC_RELEASE);
+}
+
+// Name the calling thread in the trace
+void traceThreadName(const char *name)
+{
+    traceEvent("thread_start", 'i');
+    if (trace_buffer != NULL)
+    {
+        trace_buffer->thread_name = name;
+    }
+}
+
+// Write all recorded events as Chrome trace-event JSON
+// Call once the other threads have stopped recording.
+void writeTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        perror("Failed to open trace file");
+        return;
+    }
+
+    int threads = __atomic_load_n(&trace_thread_count, __ATOMIC_ACQUIRE);
+    if (threads > TRACE_MAX_THREADS)
+    {
+        threads = TRACE_MAX_THREADS;
+    }
+
+    long written = 0, dropped = 0;
+    int first = 1;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int t = 0; t < threads; t++)
+    {
+        TraceBuffer *buffer = &trace_buffers[t];
+        if (!__atomic_load_n(&buffer->ready, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->thread_name);
+        first = 0;
+
+        int count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < count; i++)
+        {
+            TraceEvent *event = &buffer->events[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+                    event->name, event->phase, event->ts_us, buffer->tid,
+                    event->phase == 'i' ? ",\"s\":\"t\"" : "");
+        }
+        written += count;
+        dropped += buffer->dropped;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Trace written to %s: %ld events from %d threads (%ld dropped)\n", path, written, threads, dropped);
+}
+#endif
+
+// Charge a renderer call and its primitives to the current draw scope
+void perfCountDraw(DrawCallType type, int primitives)
+{
+    DrawScope scope = draw_scope_stack[draw_scope_depth];
+    if (scope == SCOPE_PERF)
+    {
+        return;
+    }
+
+    ScopeCounts *counts = &perf_stats.scope_counts[scope];
+    counts->calls[type]++;
+    counts->primitives += primitives;
+    if (type != CALL_COLOR)
+    {
+        perf_stats.draw_calls++;
+    }
+}
+
+// Enter a draw scope; calls are charged to the innermost one
+void drawScopePush(DrawScope scope)
+{
+    if (draw_scope_depth < DRAW_SCOPE_DEPTH - 1)
+    {
+        draw_scope_stack[++draw_scope_depth] = scope;
+    }
+    perf_stats.scope_counts[scope].instances++;
+}
+
+// Leave the current draw scope
+void drawScopePop()
+{
+    if (draw_scope_depth > 0)
+    {
+        draw_scope_depth--;
+    }
+}
+
+// Print average renderer calls per frame for each draw scope
+void printDrawStats()
+{
+    PerfStats *ps = &perf_stats;
+    if (ps->frames == 0)
+    {
+        return;
+    }
+
+    printf("Draw calls per frame by scope (average over %ld frames):\n", ps->frames);
+    printf("  %-7s %6s", "scope", "inst");
+    for (int t = 0; t < DRAW_CALL_TYPES; t++)
+    {
+        printf(" %8s", call_type_names[t]);
+    }
+    printf(" %9s %9s\n", "prims", "per inst");
+
+    for (int s = 0; s < DRAW_SCOPES; s++)
+    {
+        long calls = 0;
+        for (int t = 0; t < DRAW_CALL_TYPES; t++)
+        {
+            if (t != CALL_COLOR)
+            {
+                calls += ps->total_calls[s][t];
+            }
+        }
+        if (calls == 0 && ps->total_calls[s][CALL_COLOR] == 0)
+        {
+            continue;
+        }
+
+        printf("  %-7s %6.2f", scope_names[s], (double)ps->total_instances[s] / ps->frames);
+        for (int t = 0; t < DRAW_CALL_TYPES; t++)
+        {
+            printf(" %8.1f", (double)ps->total_calls[s][t] / ps->frames);
+        }
+        printf(" %9.1f %9.1f\n", (double)ps->total_primitives[s] / ps->frames,
+               ps->total_instances[s] > 0 ? (double)calls / ps->total_instances[s] : 0.0);
+    }
+}
+
+// Mark the start of a frame and account the previous one
+void perfBeginFrame()
+{
+    PerfStats *ps = &perf_stats;
+    double now = perfNowMs();
+
+    if (ps->frame_start > 0)
+    {
+        double frame_ms = now - ps->frame_start;
+        ps->frame_history[ps->history_index] = frame_ms;
+        ps->history_index = (ps->history_index + 1) % PERF_HISTORY;
+        histogramAdd(&ps->frame_hist, frame_ms);
+
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            histogramAdd(&ps->phase_hist[p], ps->phase_ms[p]);
+            ps->last_phase_ms[p] = ps->phase_ms[p];
+        }
+        flightRecordFrame(frame_ms);
+        ps->last_frame_ms = frame_ms;
+        ps->last_draw_calls = ps->draw_calls;
+        ps->last_lock_wait_ms = ps->lock_wait_ms;
+
+        for (int s = 0; s < DRAW_SCOPES; s++)
+        {
+            for (int t = 0; t < DRAW_CALL_TYPES; t++)
+            {
+                ps->total_calls[s][t] += ps->scope_counts[s].calls[t];
+            }
+            ps->total_primitives[s] += ps->scope_counts[s].primitives;
+            ps->total_instances[s] += ps->scope_counts[s].instances;
+        }
+        memcpy(ps->last_scope_counts, ps->scope_counts, sizeof(ps->scope_counts));
+        ps->frames++;
+
+        CollisionStats *c = &ps->collisions, *t = &ps->collision_totals;
+        t->passes += c->passes;
+        t->candidates += c->candidates;
+        t->culled += c->culled;
+        t->tests += c->tests;
+        t->tests_avoided += c->tests_avoided;
+        t->hits += c->hits;
+        t->near_misses += c->near_misses;
+        t->cull_errors += c->cull_errors;
+        ps->last_collisions = *c;
+    }
+
+    memset(ps->phase_ms, 0, sizeof(ps->phase_ms));
+    memset(ps->scope_counts, 0, sizeof(ps->scope_counts));
+    memset(&ps->collisions, 0, sizeof(ps->collisions));
+    ps->draw_calls = 0;
+    ps->lock_wait_ms = 0.0;
+    ps->frame_start = now;
+    ps->phase_mark = now;
+
+    if (hw_profiling)
+    {
+        hwCountersRead(&hw_main_group, &hw_mark);
+    }
+}
+
+// Charge the time since the previous mark to a frame phase
+void perfEndPhase(FramePhase phase)
+{
+    double now = perfNowMs();
+    perf_stats.phase_ms[phase] += now - perf_stats.phase_mark;
+    perf_stats.phase_mark = now;
+
+    if (hw_profiling)
+    {
+        HwSample sample;
+        hwCountersRead(&hw_main_group, &sample);
+        hwCountersAccumulate(&hw_phase_totals[phase], &hw_mark, &sample);
+        hw_mark = sample;
+    }
+}
+
+// Open the cycle, instruction, cache-miss and branch-miss counters for the calling thread
+// The counters form one group so they are read together. Counters the CPU or
+// kernel won't provide are left closed; if none open, only the thread CPU
+// clock is sampled.
+void hwCountersOpen(HwCounterGroup *group)
+{
+    int leader = -1;
+
+    group->opened = 0;
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        group->fds[c] = -1;
+        group->slot[c] = -1;
+    }
+
+#ifdef __linux__
+    static const Uint64 configs[HW_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                 PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.disabled = leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0)
+        {
+            if (leader == -1 && c == 0)
+            {
+                printf("Hardware counters unavailable (%s); sampling thread CPU time only\n", strerror(errno));
+            }
+            continue;
+        }
+
+        if (leader == -1)
+        {
+            leader = fd;
+        }
+        group->fds[c] = fd;
+        group->slot[c] = group->opened++;
+    }
+
+    if (leader != -1)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    printf("Hardware counters need Linux perf events; sampling thread CPU time only\n");
+#endif
+    group->leader = leader;
+}
+
+// Read the calling thread's counters and CPU clock
+void hwCountersRead(HwCounterGroup *group, HwSample *sample)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    sample->cpu_ms = ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+
+    memset(sample->values, 0, sizeof(sample->values));
+    if (group->leader == -1)
+    {
+        return;
+    }
+
+    // Group read layout: number of counters, then each value in open order
+    Uint64 buffer[1 + HW_COUNTERS];
+    if (read(group->leader, buffer, sizeof(buffer)) < (ssize_t)sizeof(Uint64))
+    {
+        return;
+    }
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        if (group->slot[c] >= 0 && (Uint64)group->slot[c] < buffer[0])
+        {
+            sample->values[c] = buffer[1 + group->slot[c]];
+        }
+    }
+}
+
+// Add the counts between two samples to a total
+void hwCountersAccumulate(HwTotals *totals, const HwSample *start, const HwSample *end)
+{
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        totals->values[c] += end->values[c] - start->values[c];
+    }
+    totals->cpu_ms += end->cpu_ms - start->cpu_ms;
+    totals->samples++;
+}
+
+// Close the calling thread's counters
+void hwCountersClose(HwCounterGroup *group)
+{
+    if (group->opened == 0)
+    {
+        return; // Nothing was opened, and fd 0 may well be someone else's file
+    }
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        if (group->fds[c] >= 0)
+        {
+            close(group->fds[c]);
+            group->fds[c] = -1;
+        }
+    }
+    group->leader = -1; // slot[] and opened stay for the report
+}
+
+// Print one row of the counter report, averaged over the total's samples
+void printHwRow(const char *name, const HwTotals *totals, const HwCounterGroup *group)
+{
+    if (totals->samples == 0)
+    {
+        return;
+    }
+
+    double n = totals->samples;
+    printf("  %-9s %8.3f", name, totals->cpu_ms / n);
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        if (group->slot[c] >= 0)
+            printf(" %12.0f", totals->values[c] / n);
+        else
+            printf(" %12s", "n/a");
+    }
+
+    if (group->slot[HW_CYCLES] >= 0 && group->slot[HW_INSTRUCTIONS] >= 0 && totals->values[HW_CYCLES] > 0)
+        printf(" %5.2f\n", (double)totals->values[HW_INSTRUCTIONS] / totals->values[HW_CYCLES]);
+    else
+        printf(" %5s\n", "n/a");
+}
+
+// Print per-phase counters per frame, and the spawner's per tick
+void printHwCounters()
+{
+    printf("Hardware counters per frame (%ld frames):\n", hw_phase_totals[PHASE_EVENTS].samples);
+    printf("  %-9s %8s", "phase", "cpu ms");
+    for (int c = 0; c < HW_COUNTERS; c++)
+    {
+        printf(" %12s", hw_counter_names[c]);
+    }
+    printf(" %5s\n", "IPC");
+
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        printHwRow(phase_names[p], &hw_phase_totals[p], &hw_main_group);
+    }
+
+    printf("Spawner thread per tick (%ld ticks):\n", hw_spawner_totals.samples);
+    printHwRow("SPAWN", &hw_spawner_totals, &hw_spawner_group);
+}
+
+// Name the calling thread, as shown by top -H, ps -L and /proc/self/task/*/comm
+// Names are truncated to 15 characters by the kernel.
+void nameThread(const char *name)
+{
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), name);
+#elif defined(__APPLE__)
+    pthread_setname_np(name);
+#else
+    (void)name;
+#endif
+}
+
+// Read a small /proc file into buffer; returns 0 if it can't be read
+int readProcFile(const char *path, char *buffer, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    ssize_t n = read(fd, buffer, size - 1);
+    close(fd);
+    if (n <= 0)
+    {
+        return 0;
+    }
+    buffer[n] = '\0';
+    return 1;
+}
+
+// Sample one task's CPU time, context switches and wakeups from /proc
+// dir is the task's /proc directory. Rates are computed against the
+// previous sample of the same tid.
+void sampleTask(const char *dir, int tid, double elapsed_ms)
+{
+    char path[96], buffer[4096]; // status is about 1.5 KB
+    ThreadStats fresh = {.tid = tid, .alive = 1, .wakeups = -1};
+
+    // stat: "tid (comm) state ... utime stime ..." - comm may contain spaces
+    snprintf(path, sizeof(path), "%s/stat", dir);
+    if (!readProcFile(path, buffer, sizeof(buffer)))
+    {
+        return;
+    }
+    char *open_paren = strchr(buffer, '(');
+    char *close_paren = strrchr(buffer, ')');
+    if (open_paren == NULL || close_paren == NULL)
+    {
+        return;
+    }
+    int name_len = close_paren - open_paren - 1;
+    if (name_len > (int)sizeof(fresh.name) - 1)
+    {
+        name_len = sizeof(fresh.name) - 1;
+    }
+    memcpy(fresh.name, open_paren + 1, name_len);
+
+    unsigned long utime = 0, stime = 0;
+    sscanf(close_paren + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime);
+    fresh.cpu_ms = (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+
+    snprintf(path, sizeof(path), "%s/status", dir);
+    if (readProcFile(path, buffer, sizeof(buffer)))
+    {
+        char *line = strstr(buffer, "voluntary_ctxt_switches:");
+        if (line != NULL)
+            fresh.voluntary = atol(line + strlen("voluntary_ctxt_switches:"));
+        line = strstr(buffer, "nonvoluntary_ctxt_switches:");
+        if (line != NULL)
+            fresh.involuntary = atol(line + strlen("nonvoluntary_ctxt_switches:"));
+    }
+
+    // schedstat: run time, wait time, number of times scheduled in
+    snprintf(path, sizeof(path), "%s/schedstat", dir);
+    if (readProcFile(path, buffer, sizeof(buffer)))
+    {
+        sscanf(buffer, "%*u %*u %ld", &fresh.wakeups);
+    }
+
+    ThreadStats *slot = NULL;
+    for (int i = 0; i < thread_stats_count; i++)
+    {
+        if (thread_stats[i].tid == tid)
+        {
+            slot = &thread_stats[i];
+            break;
+        }
+    }
+    if (slot == NULL)
+    {
+        if (thread_stats_count == MAX_TRACKED_THREADS)
+        {
+            return;
+        }
+        slot = &thread_stats[thread_stats_count++];
+    }
+    else if (elapsed_ms > 0.0)
+    {
+        fresh.cpu_percent = (fresh.cpu_ms - slot->cpu_ms) * 100.0 / elapsed_ms;
+        if (fresh.wakeups >= 0 && slot->wakeups >= 0)
+        {
+            fresh.wakeups_per_sec = (fresh.wakeups - slot->wakeups) * 1000.0 / elapsed_ms;
+        }
+    }
+    *slot = fresh;
+}
+
+// Sample every thread of the game and the power-up process, about once a second
+// Threads that have exited keep their last sample for the exit report.
+void sampleThreadStats(int force)
+{
+    double now = perfNowMs();
+    if (!force && now - thread_stats_sampled_ms < THREAD_SAMPLE_MS)
+    {
+        return;
+    }
+    double elapsed = thread_stats_sampled_ms > 0.0 ? now - thread_stats_sampled_ms : 0.0;
+    thread_stats_sampled_ms = now;
+
+    DIR *tasks = opendir("/proc/self/task");
+    if (tasks == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < thread_stats_count; i++)
+    {
+        thread_stats[i].alive = 0;
+    }
+
+    char dir[64];
+    struct dirent *entry;
+    while ((entry = readdir(tasks)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        int tid = atoi(entry->d_name);
+        snprintf(dir, sizeof(dir), "/proc/self/task/%d", tid);
+        sampleTask(dir, tid, elapsed);
+    }
+    closedir(tasks);
+
+    if (powerup_pid > 0)
+    {
+        snprintf(dir, sizeof(dir), "/proc/%d", (int)powerup_pid);
+        sampleTask(dir, powerup_pid, elapsed);
+    }
+}
+
+// Print each thread's totals, then the whole process's and its children's
+void printThreadStats()
+{
+    sampleThreadStats(1);
+
+    if (thread_stats_count > 0)
+    {
+        printf("Per-thread CPU (threads that have exited show their last sample):\n");
+        printf("  %7s %-15s %10s %9s %9s %9s\n", "tid", "name", "cpu ms", "vol cs", "invol cs", "wakeups");
+        for (int i = 0; i < thread_stats_count; i++)
+        {
+            ThreadStats *ts = &thread_stats[i];
+            printf("  %7d %-15s %10.1f %9ld %9ld %9ld%s\n", ts->tid, ts->name, ts->cpu_ms, ts->voluntary,
+                   ts->involuntary, ts->wakeups, ts->alive ? "" : "  (exited)");
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        printf("Process: user %.1f ms, system %.1f ms, %ld voluntary and %ld involuntary context switches\n",
+               usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0,
+               usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0, usage.ru_nvcsw, usage.ru_nivcsw);
+    }
+    if (getrusage(RUSAGE_CHILDREN, &usage) == 0)
+    {
+        printf("Power-up process: user %.1f ms, system %.1f ms, %ld voluntary and %ld involuntary context switches\n",
+               usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0,
+               usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0, usage.ru_nvcsw, usage.ru_nivcsw);
+    }
+}
+
+// Process id publishing to an existing metrics segment, or 0 if it is stale
+pid_t metricsSegmentOwner()
+{
+    int fd = shm_open(metrics_name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    struct stat st;
+    pid_t owner = 0;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(NinjaMetrics))
+    {
+        const NinjaMetrics *existing = mmap(NULL, sizeof(NinjaMetrics), PROT_READ, MAP_SHARED, fd, 0);
+        if (existing != MAP_FAILED)
+        {
+            owner = existing->pid;
+            munmap((void *)existing, sizeof(NinjaMetrics));
+        }
+    }
+    close(fd);
+
+    // The pid is written before the magic, so a game still starting up counts too
+    if (owner > 0 && (kill(owner, 0) == 0 || errno == EPERM))
+    {
+        return owner;
+    }
+    return 0;
+}
+
+// Create the shared-memory segment ninja-top reads
+// Never takes over a segment another running game is publishing to; one
+// left behind by a game that crashed is replaced.
+void openMetrics()
+{
+    if (!metrics_enabled)
+    {
+        return;
+    }
+
+    int fd = shm_open(metrics_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+        pid_t owner = metricsSegmentOwner();
+        if (owner != 0)
+        {
+            printf("Metrics segment %s is in use by process %d; not publishing (give this instance its own --metrics-name)\n",
+                   metrics_name, (int)owner);
+            return;
+        }
+        shm_unlink(metrics_name);
+        fd = shm_open(metrics_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+    {
+        perror("Failed to create metrics segment");
+        return;
+    }
+    if (ftruncate(fd, sizeof(NinjaMetrics)) < 0)
+    {
+        perror("Failed to size metrics segment");
+        close(fd);
+        return;
+    }
+
+    void *mapping = mmap(NULL, sizeof(NinjaMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Failed to map metrics segment");
+        return;
+    }
+
+    metrics = mapping;
+    memset(metrics, 0, sizeof(NinjaMetrics));
+    metrics->version = NINJA_METRICS_VERSION;
+    metrics->size = sizeof(NinjaMetrics);
+    metrics->pid = getpid();
+    __atomic_store_n(&metrics->magic, NINJA_METRICS_MAGIC, __ATOMIC_RELEASE); // Readers check this last
+
+    metrics_rate_mark_ms = perfNowMs();
+    printf("Publishing live metrics to shared memory %s (view with ninja-top)\n", metrics_name);
+}
+
+// Sort helper for frame-time percentiles
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Refresh the metrics segment, at most every METRICS_INTERVAL_MS
+// Runs on the main thread, the segment's only writer. Each update bumps seq
+// to odd, writes the payload and bumps it back to even, so readers retry
+// instead of seeing a half-written update.
+void publishMetrics()
+{
+    double now = perfNowMs();
+    if (metrics == NULL || now - metrics_last_publish_ms < METRICS_INTERVAL_MS)
+    {
+        return;
+    }
+    metrics_last_publish_ms = now;
+
+    // Percentiles over the overlay's recent frame history
+    double recent[PERF_HISTORY];
+    int n = 0;
+    double total = 0.0;
+    for (int i = 0; i < PERF_HISTORY; i++)
+    {
+        if (perf_stats.frame_history[i] > 0.0)
+        {
+            recent[n++] = perf_stats.frame_history[i];
+            total += perf_stats.frame_history[i];
+        }
+    }
+    qsort(recent, n, sizeof(double), compareDoubles);
+
+    int available[NINJA_METRICS_RESOURCES];
+    pthread_mutex_lock(&deadlock_detector.deadlock_mutex);
+    for (int r = 0; r < NINJA_METRICS_RESOURCES; r++)
+    {
+        available[r] = deadlock_detector.available[r];
+    }
+    pthread_mutex_unlock(&deadlock_detector.deadlock_mutex);
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    NinjaMetrics *m = metrics;
+    __atomic_store_n(&m->seq, m->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    m->updated_ms = (uint64_t)wall.tv_sec * 1000 + wall.tv_nsec / 1000000;
+    m->frames = perf_stats.frames;
+    m->fps = total > 0.0 ? n * 1000.0 / total : 0.0;
+    m->frame_ms_p50 = n > 0 ? recent[n * 50 / 100] : 0.0;
+    m->frame_ms_p95 = n > 0 ? recent[n * 95 / 100] : 0.0;
+    m->frame_ms_p99 = n > 0 ? recent[n * 99 / 100] : 0.0;
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        m->phase_ms[p] = perf_stats.last_phase_ms[p];
+    }
+    m->active_objects = perf_stats.active_objects;
+    m->score = score;
+    m->health = health;
+    m->game_state = game_state;
+    m->slices = slices_total;
+    if (now - metrics_rate_mark_ms >= 1000.0)
+    {
+        m->slices_per_sec = (slices_total - metrics_rate_mark_slices) * 1000.0 / (now - metrics_rate_mark_ms);
+        metrics_rate_mark_slices = slices_total;
+        metrics_rate_mark_ms = now;
+    }
+    m->lock_acquisitions = __atomic_load_n(&lock_counters.acquisitions, __ATOMIC_RELAXED);
+    m->lock_contended = __atomic_load_n(&lock_counters.contentions, __ATOMIC_RELAXED);
+    m->lock_wait_ms = __atomic_load_n(&lock_counters.wait_ns_total, __ATOMIC_RELAXED) / 1000000.0;
+    memcpy(m->resources_available, available, sizeof(available));
+    m->deadlock_checks = __atomic_load_n(&deadlock_counters.checks, __ATOMIC_RELAXED);
+    m->deadlocks_detected = __atomic_load_n(&deadlock_counters.detected, __ATOMIC_RELAXED);
+    m->audio_channels_playing = Mix_Playing(-1);
+    m->quality_level = quality_governor.level;
+    snprintf(m->render_path, sizeof(m->render_path), "%s", render_path_names[render_path]);
+
+    __atomic_store_n(&m->seq, m->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Unmap and remove the metrics segment
+void closeMetrics()
+{
+    if (metrics == NULL)
+    {
+        return;
+    }
+    munmap(metrics, sizeof(NinjaMetrics));
+    metrics = NULL;
+    shm_unlink(metrics_name);
+}
+
+// Time spent in all phases of the current frame (the frame's work, excluding pacing)
+double perfWorkMs()
+{
+    double total = 0.0;
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        total += perf_stats.phase_ms[p];
+    }
+    return total;
+}
+
+// Show or hide the overlay; showing it starts the percentiles afresh
+void togglePerfOverlay()
+{
+    perf_stats.visible = !perf_stats.visible;
+    if (perf_stats.visible)
+    {
+        memset(&perf_stats.frame_hist, 0, sizeof(perf_stats.frame_hist));
+        memset(perf_stats.phase_hist, 0, sizeof(perf_stats.phase_hist));
+    }
+}
+
+// Draw the performance overlay: frame-time graph, percentiles and phase timings
+// Shows the previous completed frame, since the current one is still running.
+void drawPerfOverlay()
+{
+    PerfStats *ps = &perf_stats;
+    drawScopePush(SCOPE_PERF); // Don't charge the overlay's own drawing to the frame
+
+    int active_scopes = 0;
+    for (int s = 0; s < SCOPE_PERF; s++)
+    {
+        if (ps->last_scope_counts[s].primitives > 0)
+        {
+            active_scopes++;
+        }
+    }
+
+    int live_threads = 0;
+    for (int i = 0; i < thread_stats_count; i++)
+    {
+        if (thread_stats[i].alive)
+        {
+            live_threads++;
+        }
+    }
+
+    const int charW = 6, charH = 10, spacing = 2, lineH = 14;
+    const int panelX = 10, panelW = PERF_HISTORY * 2 + 20;
+    const int graphH = 60;
+    const int lines = 5 + PHASE_COUNT + active_scopes + live_threads;
+    const int panelH = graphH + 20 + lines * lineH;
+    const int panelY = WINDOW_HEIGHT - panelH - 10;
+
+    // Translucent panel
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 170);
+    SDL_Rect panel = {panelX, panelY, panelW, panelH};
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    // Frame-time graph, 2 px per frame and 2 px per ms, oldest on the left
+    int graphX = panelX + 10;
+    int graphBottom = panelY + 10 + graphH;
+    for (int i = 0; i < PERF_HISTORY; i++)
+    {
+        double ms = ps->frame_history[(ps->history_index + i) % PERF_HISTORY];
+        int h = (int)(ms * 2);
+        if (h > graphH)
+            h = graphH;
+
+        if (ms > FRAME_BUDGET_MS * 1.5)
+            SDL_SetRenderDrawColor(renderer, 255, 60, 60, 255);
+        else if (ms > FRAME_BUDGET_MS + 1.0)
+            SDL_SetRenderDrawColor(renderer, 255, 200, 0, 255);
+        else
+            SDL_SetRenderDrawColor(renderer, 80, 220, 80, 255);
+
+        SDL_Rect bar = {graphX + i * 2, graphBottom - h, 2, h};
+        SDL_RenderFillRect(renderer, &bar);
+    }
+
+    // 16.7 ms budget line
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    int budgetY = graphBottom - (int)(FRAME_BUDGET_MS * 2);
+    SDL_RenderDrawLine(renderer, graphX, budgetY, graphX + PERF_HISTORY * 2, budgetY);
+
+    // Text lines
+    char line[64];
+    int textX = panelX + 10;
+    int textY = graphBottom + 10;
+
+    snprintf(line, sizeof(line), "FPS %.1f FRAME %.2f",
+             ps->last_frame_ms > 0 ? 1000.0 / ps->last_frame_ms : 0.0, ps->last_frame_ms);
+    drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+    textY += lineH;
+
+    snprintf(line, sizeof(line), "P50 %.1f P95 %.1f P99 %.1f",
+             histogramPercentile(&ps->frame_hist, 0.50),
+             histogramPercentile(&ps->frame_hist, 0.95),
+             histogramPercentile(&ps->frame_hist, 0.99));
+    drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+    textY += lineH;
+
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        snprintf(line, sizeof(line), "%-8s %.2f P99 %.2f", phase_names[p],
+                 ps->last_phase_ms[p], histogramPercentile(&ps->phase_hist[p], 0.99));
+        drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+        textY += lineH;
+    }
+
+    snprintf(line, sizeof(line), "OBJECTS %d DRAWS %d", ps->active_objects, ps->last_draw_calls);
+    drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+    textY += lineH;
+
+    snprintf(line, sizeof(line), "LOCK WAIT %.2f", ps->last_lock_wait_ms);
+    drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+    textY += lineH;
+
+    snprintf(line, sizeof(line), "QUALITY %d PATH %s", quality_governor.level, render_path_names[render_path]);
+    drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+    textY += lineH;
+
+    // Draw calls and points by scope, with how many times each was drawn
+    for (int s = 0; s < SCOPE_PERF; s++)
+    {
+        ScopeCounts *counts = &ps->last_scope_counts[s];
+        if (counts->primitives == 0)
+        {
+            continue;
+        }
+
+        int calls = 0;
+        for (int t = 0; t < CALL_COLOR; t++)
+        {
+            calls += counts->calls[t];
+        }
+        snprintf(line, sizeof(line), "%-6s X%-2d %5d PT %5d", scope_names[s], counts->instances, calls,
+                 counts->calls[CALL_POINT]);
+        drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+        textY += lineH;
+    }
+
+    // CPU share and wakeups per second of each thread over the last sample
+    for (int i = 0; i < thread_stats_count; i++)
+    {
+        ThreadStats *ts = &thread_stats[i];
+        if (!ts->alive)
+        {
+            continue;
+        }
+
+        const char *name = strncmp(ts->name, "ninja-", 6) == 0 ? ts->name + 6 : ts->name;
+        snprintf(line, sizeof(line), "%-9.9s CPU %4.1f WAKE %4.0f", name, ts->cpu_percent, ts->wakeups_per_sec);
+        for (char *c = line; *c; c++)
+        {
+            *c = toupper((unsigned char)*c);
+        }
+        drawDigitalText(renderer, line, textX, textY, charW, charH, spacing);
+        textY += lineH;
+    }
+
+    drawScopePop();
+}
+
+// Start the flight recorder's writer thread
+int startFlightRecorder()
+{
+    FlightRecorder *fr = &flight_recorder;
+
+    if (fr->budget_ms <= 0.0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_init(&fr->mutex, NULL);
+    pthread_cond_init(&fr->cond, NULL);
+    if (pthread_create(&fr->thread, NULL, flightRecorderWriter, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create flight recorder thread\n");
+        return 0;
+    }
+
+    fr->active = 1;
+    printf("Flight recorder: dumping the last %d frames when one exceeds %.1f ms\n", FLIGHT_FRAMES, fr->budget_ms);
+    return 1;
+}
+
+// Append the frame that just finished to the ring and snapshot it if it was a spike
+// Runs on the main thread. A spike only copies the ring into the dump buffer;
+// the file is written by the recorder thread. Spikes during the warm-up,
+// within the cooldown or while a dump is still being written are only counted.
+void flightRecordFrame(double frame_ms)
+{
+    FlightRecorder *fr = &flight_recorder;
+    PerfStats *ps = &perf_stats;
+
+    if (!fr->active)
+    {
+        return;
+    }
+
+    FlightRecord *record = &fr->ring[fr->head];
+    record->frame = fr->frames++;
+    record->time_ms = ps->frame_start;
+    record->frame_ms = frame_ms;
+    memcpy(record->phase_ms, ps->phase_ms, sizeof(record->phase_ms));
+    record->lock_wait_ms = ps->lock_wait_ms;
+    record->draw_calls = ps->draw_calls;
+    record->active_objects = ps->active_objects;
+    record->score = score;
+    record->health = health;
+    record->game_state = game_state;
+    record->quality = quality_governor.level;
+    record->render_path = render_path;
+    fr->head = (fr->head + 1) % FLIGHT_FRAMES;
+    if (fr->count < FLIGHT_FRAMES)
+    {
+        fr->count++;
+    }
+
+    if (frame_ms <= fr->budget_ms || fr->frames <= FLIGHT_WARMUP_FRAMES)
+    {
+        return;
+    }
+    fr->spikes++;
+    if (fr->last_dump_ms > 0 && record->time_ms - fr->last_dump_ms < FLIGHT_COOLDOWN_MS)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&fr->mutex);
+    if (!fr->dump_pending)
+    {
+        // Oldest first
+        int start = (fr->head - fr->count + FLIGHT_FRAMES) % FLIGHT_FRAMES;
+        for (int i = 0; i < fr->count; i++)
+        {
+            fr->dump[i] = fr->ring[(start + i) % FLIGHT_FRAMES];
+        }
+        fr->dump_count = fr->count;
+        fr->dump_pending = 1;
+        fr->last_dump_ms = record->time_ms;
+        pthread_cond_signal(&fr->cond);
+    }
+    pthread_mutex_unlock(&fr->mutex);
+}
+
+// Flight recorder thread: writes each captured window to a timestamped file
+void *flightRecorderWriter(void *arg)
+{
+    FlightRecorder *fr = &flight_recorder;
+    (void)arg;
+    nameThread("ninja-flight");
+    lowJitterThread(0);
+    TRACE_THREAD_NAME("flightRecorder");
+
+    pthread_mutex_lock(&fr->mutex);
+    while (1)
+    {
+        while (!fr->dump_pending && !fr->stopping)
+        {
+            pthread_cond_wait(&fr->cond, &fr->mutex);
+        }
+        if (!fr->dump_pending)
+        {
+            break;
+        }
+        pthread_mutex_unlock(&fr->mutex);
+
+        // The dump buffer is ours until dump_pending is cleared
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        char stamp[32], path[64];
+        strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now.tv_sec));
+        snprintf(path, sizeof(path), "spike_%s_%03ld.csv", stamp, now.tv_nsec / 1000000);
+
+        FILE *file = fopen(path, "w");
+        if (file != NULL)
+        {
+            FlightRecord *spike = &fr->dump[fr->dump_count - 1];
+            int slowest = 0;
+            for (int p = 1; p < PHASE_COUNT; p++)
+            {
+                if (spike->phase_ms[p] > spike->phase_ms[slowest])
+                {
+                    slowest = p;
+                }
+            }
+
+            fprintf(file, "# Frame %ld took %.2f ms (budget %.1f ms), slowest phase %s %.2f ms, lock wait %.2f ms\n",
+                    spike->frame, spike->frame_ms, fr->budget_ms, phase_names[slowest],
+                    spike->phase_ms[slowest], spike->lock_wait_ms);
+            fprintf(file, "frame,t_ms,frame_ms");
+            for (int p = 0; p < PHASE_COUNT; p++)
+            {
+                fprintf(file, ",%s_ms", phase_names[p]);
+            }
+            fprintf(file, ",lock_wait_ms,draw_calls,objects,score,health,state,quality,render_path\n");
+
+            for (int i = 0; i < fr->dump_count; i++)
+            {
+                FlightRecord *r = &fr->dump[i];
+                fprintf(file, "%ld,%.3f,%.3f", r->frame, r->time_ms - spike->time_ms, r->frame_ms);
+                for (int p = 0; p < PHASE_COUNT; p++)
+                {
+                    fprintf(file, ",%.3f", r->phase_ms[p]);
+                }
+                fprintf(file, ",%.3f,%d,%d,%d,%d,%s,%d,%s\n", r->lock_wait_ms, r->draw_calls, r->active_objects,
+                        r->score, r->health, r->game_state == STATE_PLAYING ? "playing" : "game_over",
+                        r->quality, render_path_names[r->render_path]);
+            }
+            fclose(file);
+            printf("Frame spike of %.1f ms: wrote last %d frames to %s\n", spike->frame_ms, fr->dump_count, path);
+        }
+        else
+        {
+            perror("Failed to open flight recorder dump");
+        }
+
+        pthread_mutex_lock(&fr->mutex);
+        fr->dump_pending = 0;
+        fr->dumps++;
+    }
+    pthread_mutex_unlock(&fr->mutex);
+
+    return NULL;
+}
+
+// Finish any dump in progress and stop the recorder thread
+void stopFlightRecorder()
+{
+    FlightRecorder *fr = &flight_recorder;
+    if (!fr->active)
+    {
+        return;
+    }
+    fr->active = 0;
+
+    pthread_mutex_lock(&fr->mutex);
+    fr->stopping = 1;
+    pthread_cond_signal(&fr->cond);
+    pthread_mutex_unlock(&fr->mutex);
+    pthread_join(fr->thread, NULL);
+
+    pthread_cond_destroy(&fr->cond);
+    pthread_mutex_destroy(&fr->mutex);
+
+    printf("Flight recorder: %ld frames over %.1f ms, %ld dumps written\n", fr->spikes, fr->budget_ms, fr->dumps);
+}
+
+// Set up frame pacing for the renderer initGame() created
+void initFramePacer()
+{
+    FramePacer *fp = &frame_pacer;
+
+    SDL_RendererInfo info;
+    fp->vsync = fp->vsync_requested && SDL_GetRendererInfo(renderer, &info) == 0 &&
+                (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(window);
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0)
+    {
+        fp->refresh_hz = mode.refresh_rate;
+    }
+
+    // Without vsync, still aim for the display's rate so frames line up with it as well as they can
+    fp->target_ms = fp->refresh_hz > 0 ? 1000.0 / fp->refresh_hz : SIM_STEP_MS;
+    fp->interval_ms = fp->target_ms;
+    fp->deadline_ms = perfNowMs();
+
+    printf("Frame pacing: %s, %.2f ms frames, simulation at %.0f Hz\n",
+           fp->vsync ? "vsync" : fp->vsync_requested ? "no vsync available, sleep and spin" : "vsync off, sleep and spin",
+           fp->target_ms, 1000.0 / SIM_STEP_MS);
+}
+
+// Sleep until shortly before deadline_ms, then spin the rest for sub-millisecond accuracy
+void pacerSleepUntil(double deadline_ms)
+{
+    double remaining = deadline_ms - perfNowMs();
+    if (remaining > PACER_SPIN_MS)
+    {
+        SDL_Delay((Uint32)(remaining - PACER_SPIN_MS));
+    }
+    while (perfNowMs() < deadline_ms)
+    {
+        // Spin
+    }
+}
+
+// How many fixed simulation steps to run this frame
+// Object speeds are per 60 Hz tick, so the simulation advances in whole
+// SIM_STEP_MS steps whatever the display rate: none on some frames of a
+// 120 Hz display, two after a late frame. After a long stall the backlog
+// beyond SIM_MAX_STEPS is dropped rather than fast-forwarded.
+int framePacerSimSteps()
+{
+    FramePacer *fp = &frame_pacer;
+    double now = perfNowMs();
+
+    if (fp->last_sim_ms == 0.0)
+    {
+        fp->last_sim_ms = now;
+        fp->sim_steps++;
+        return 1;
+    }
+
+    fp->sim_accumulator_ms += now - fp->last_sim_ms;
+    fp->last_sim_ms = now;
+
+    int steps = (int)(fp->sim_accumulator_ms / SIM_STEP_MS);
+    if (steps > SIM_MAX_STEPS)
+    {
+        fp->sim_dropped_ms += (steps - SIM_MAX_STEPS) * SIM_STEP_MS;
+        steps = SIM_MAX_STEPS;
+        fp->sim_accumulator_ms = fmod(fp->sim_accumulator_ms, SIM_STEP_MS);
+    }
+    else
+    {
+        fp->sim_accumulator_ms -= steps * SIM_STEP_MS;
+    }
+
+    fp->sim_steps += steps;
+    return steps;
+}
+
+// This frame's work, without the time SDL_RenderPresent() spent waiting for vblank
+double framePacerWorkMs()
+{
+    double work = perfWorkMs();
+    if (frame_pacer.vsync)
+    {
+        work -= perf_stats.phase_ms[PHASE_PRESENT];
+    }
+    return work;
+}
+
+// Measure the present that just returned
+// Falls back to deadline pacing if presents come back much faster than the
+// refresh rate, which means the driver is ignoring the vsync request.
+void framePacerPresented()
+{
+    FramePacer *fp = &frame_pacer;
+    double now = perfNowMs();
+
+    fp->work_ms += PACER_SMOOTHING * (framePacerWorkMs() - fp->work_ms);
+    if (fp->last_present_ms > 0.0)
+    {
+        double interval = now - fp->last_present_ms;
+        fp->interval_ms += PACER_SMOOTHING * (interval - fp->interval_ms);
+        fp->interval_sum += interval;
+        fp->interval_sum_sq += interval * interval;
+        fp->frames++;
+        if (interval > fp->target_ms * 1.5)
+        {
+            fp->late_frames++;
+        }
+
+        if (fp->vsync && fp->frames > PACER_VSYNC_CHECK_FRAMES && fp->interval_ms < fp->target_ms * 0.75)
+        {
+            printf("Frame pacing: presents return every %.2f ms, vsync isn't working; pacing by deadline\n",
+                   fp->interval_ms);
+            fp->vsync = 0;
+            fp->deadline_ms = now;
+        }
+    }
+    fp->last_present_ms = now;
+}
+
+// Wait before starting the next frame
+// With vsync, present has just returned at a vblank; the next frame's events
+// are sampled as late as possible so that its predicted work finishes
+// PACER_SAFETY_MS before the following vblank. Without vsync, frames start on
+// a fixed deadline, which resyncs if the loop falls more than a frame behind.
+void framePacerWait()
+{
+    FramePacer *fp = &frame_pacer;
+    double start = perfNowMs();
+
+    if (fp->vsync)
+    {
+        double wake = fp->last_present_ms + fp->target_ms - fp->work_ms - PACER_SAFETY_MS;
+        if (wake > start)
+        {
+            pacerSleepUntil(wake);
+        }
+    }
+    else
+    {
+        fp->deadline_ms += fp->target_ms;
+        if (fp->deadline_ms < start - fp->target_ms)
+        {
+            fp->deadline_ms = start;
+        }
+        pacerSleepUntil(fp->deadline_ms);
+    }
+
+    fp->wait_ms_total += perfNowMs() - start;
+}
+
+// Print how evenly frames were presented
+void printFramePacing()
+{
+    FramePacer *fp = &frame_pacer;
+    if (fp->frames == 0)
+    {
+        return;
+    }
+
+    double mean = fp->interval_sum / fp->frames;
+    double variance = fp->interval_sum_sq / fp->frames - mean * mean;
+    printf("Frame pacing: %s, %ld frames, present interval %.2f ms (stddev %.2f, target %.2f), %ld late (%.1f%%)\n",
+           fp->vsync ? "vsync" : "deadline", fp->frames, mean, variance > 0 ? sqrt(variance) : 0.0, fp->target_ms,
+           fp->late_frames, 100.0 * fp->late_frames / fp->frames);
+    printf("Frame pacing: %.2f simulation steps per frame, %.0f ms of simulation dropped after stalls, %.1f ms waited per frame\n",
+           (double)fp->sim_steps / fp->frames, fp->sim_dropped_ms, fp->wait_ms_total / fp->frames);
+}
+
+// Start the latency test: injected blade events, flash patch and report at the end
+int startLatencyTest()
+{
+    LatencyTest *lt = &latency_test;
+
+    if (!lt->enabled)
+    {
+        return 0;
+    }
+
+    lt->handled = calloc(lt->samples_wanted, sizeof(double));
+    lt->rendered = calloc(lt->samples_wanted, sizeof(double));
+    lt->read_back = calloc(lt->samples_wanted, sizeof(double));
+    lt->presented = calloc(lt->samples_wanted, sizeof(double));
+    if (lt->handled == NULL || lt->rendered == NULL || lt->read_back == NULL || lt->presented == NULL)
+    {
+        fprintf(stderr, "Failed to allocate latency samples\n");
+        lt->enabled = 0;
+        return 0;
+    }
+
+    lt->injector_x = WINDOW_WIDTH / 4;
+    lt->injector_dx = LATENCY_SWIPE_PX;
+    if (pthread_create(&lt->thread, NULL, latencyInjector, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create latency injector thread\n");
+        lt->enabled = 0;
+        return 0;
+    }
+    lt->started = 1;
+
+    printf("Latency test: injecting %d blade events, flash patch in the bottom-right corner%s\n",
+           lt->samples_wanted, lt->readback ? ", with readback" : "");
+    return 1;
+}
+
+// Push a synthetic blade movement every LATENCY_INTERVAL_MS plus jitter
+// Only one event is in flight at a time: the next is injected once the main
+// thread has presented the frame showing the previous one. The jitter spreads
+// injections across the frame so the distribution covers every phase.
+void *latencyInjector(void *arg)
+{
+    LatencyTest *lt = &latency_test;
+    (void)arg;
+    nameThread("ninja-latency");
+    lowJitterThread(0);
+    TRACE_THREAD_NAME("ninja-latency");
+    unsigned int jitter_seed = (unsigned int)time(NULL); // Own sequence, so the game's rand() is untouched
+
+    while (isRunning() && __atomic_load_n(&lt->count, __ATOMIC_ACQUIRE) < lt->samples_wanted)
+    {
+        SDL_Delay(LATENCY_INTERVAL_MS + rand_r(&jitter_seed) % LATENCY_JITTER_MS);
+        if (__atomic_load_n(&lt->stage, __ATOMIC_ACQUIRE) != LATENCY_IDLE)
+        {
+            continue;
+        }
+
+        // Swipe back and forth across the middle of the screen
+        if (lt->injector_x + lt->injector_dx < WINDOW_WIDTH / 4 ||
+            lt->injector_x + lt->injector_dx > WINDOW_WIDTH * 3 / 4)
+        {
+            lt->injector_dx = -lt->injector_dx;
+        }
+        lt->injector_x += lt->injector_dx;
+
+        SDL_Event e;
+        memset(&e, 0, sizeof(e));
+        e.type = SDL_MOUSEMOTION;
+        e.motion.windowID = SDL_GetWindowID(window);
+        e.motion.which = LATENCY_MOUSE_ID;
+        e.motion.x = lt->injector_x;
+        e.motion.y = WINDOW_HEIGHT / 2;
+        e.motion.xrel = lt->injector_dx;
+
+        lt->inject_ms = perfNowMs();
+        __atomic_store_n(&lt->stage, LATENCY_INJECTED, __ATOMIC_RELEASE);
+        if (SDL_PushEvent(&e) != 1)
+        {
+            __atomic_store_n(&lt->stage, LATENCY_IDLE, __ATOMIC_RELEASE);
+        }
+    }
+
+    return NULL;
+}
+
+// handleEvents() has dequeued an injected blade event, or the late latch has peeked it
+void latencyEventHandled()
+{
+    LatencyTest *lt = &latency_test;
+    if (__atomic_load_n(&lt->stage, __ATOMIC_ACQUIRE) == LATENCY_INJECTED)
+    {
+        lt->handled_ms = perfNowMs();
+        __atomic_store_n(&lt->stage, LATENCY_HANDLED, __ATOMIC_RELAXED);
+    }
+}
+
+// Draw the flash patch, last thing in renderGame()
+// The patch is white only in the first frame rendered after an injected event
+// was handled, so a photodiode or high-speed camera on the corner sees exactly
+// the frames being timed. With readback, one pixel of the patch is read back
+// before presenting, which waits for the renderer to finish the frame.
+void drawLatencyPatch()
+{
+    LatencyTest *lt = &latency_test;
+    if (!lt->enabled)
+    {
+        return;
+    }
+
+    int flash = __atomic_load_n(&lt->stage, __ATOMIC_ACQUIRE) == LATENCY_HANDLED;
+    SDL_Rect patch = {WINDOW_WIDTH - LATENCY_PATCH_SIZE, WINDOW_HEIGHT - LATENCY_PATCH_SIZE,
+                      LATENCY_PATCH_SIZE, LATENCY_PATCH_SIZE};
+    SDL_SetRenderDrawColor(renderer, flash ? 255 : 0, flash ? 255 : 0, flash ? 255 : 0, 255);
+    SDL_RenderFillRect(renderer, &patch);
+
+    if (!flash)
+    {
+        return;
+    }
+    lt->rendered_ms = perfNowMs();
+    lt->readback_ms = 0.0;
+
+    if (lt->readback)
+    {
+        Uint32 pixel = 0;
+        SDL_Rect probe = {patch.x + LATENCY_PATCH_SIZE / 2, patch.y + LATENCY_PATCH_SIZE / 2, 1, 1};
+        if (SDL_RenderReadPixels(renderer, &probe, SDL_PIXELFORMAT_ARGB8888, &pixel, sizeof(pixel)) == 0 &&
+            (pixel & 0xffffff) == 0xffffff)
+        {
+            lt->readback_ms = perfNowMs();
+        }
+        else
+        {
+            lt->readback_failures++;
+        }
+    }
+
+    __atomic_store_n(&lt->stage, LATENCY_RENDERED, __ATOMIC_RELAXED);
+}
+
+// SDL_RenderPresent() has returned; record the sample if this frame showed one
+void latencyFramePresented()
+{
+    LatencyTest *lt = &latency_test;
+    if (!lt->enabled || __atomic_load_n(&lt->stage, __ATOMIC_ACQUIRE) != LATENCY_RENDERED)
+    {
+        return;
+    }
+
+    int n = lt->count;
+    lt->handled[n] = lt->handled_ms - lt->inject_ms;
+    lt->rendered[n] = lt->rendered_ms - lt->inject_ms;
+    lt->read_back[n] = lt->readback_ms > 0.0 ? lt->readback_ms - lt->inject_ms : -1.0;
+    lt->presented[n] = perfNowMs() - lt->inject_ms;
+    __atomic_store_n(&lt->count, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&lt->stage, LATENCY_IDLE, __ATOMIC_RELEASE);
+
+    if (n + 1 == lt->samples_wanted)
+    {
+        printf("Latency test: all %d samples taken\n", lt->samples_wanted);
+        stopRunning();
+    }
+}
+
+// Print min, mean and percentiles of one stage's latencies, skipping missing (negative) samples
+void printLatencyRow(const char *name, const double *samples, int count)
+{
+    double *sorted = malloc((count > 0 ? count : 1) * sizeof(double));
+    int n = 0;
+    if (sorted == NULL)
+    {
+        return;
+    }
+    double sum = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        if (samples[i] >= 0.0)
+        {
+            sorted[n++] = samples[i];
+            sum += samples[i];
+        }
+    }
+    if (n == 0)
+    {
+        printf("  %-16s no samples\n", name);
+    }
+    else
+    {
+        qsort(sorted, n, sizeof(double), compareDoubles);
+        printf("  %-16s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", name, sorted[0], sum / n,
+               sorted[n / 2], sorted[(int)(n * 0.9)], sorted[(int)(n * 0.99)], sorted[n - 1]);
+    }
+    free(sorted);
+}
+
+// Stop the injector and print the latency distribution
+void stopLatencyTest()
+{
+    LatencyTest *lt = &latency_test;
+    if (!lt->started)
+    {
+        return;
+    }
+    pthread_join(lt->thread, NULL);
+    lt->started = 0;
+
+    printf("\nInput latency from injection, %d samples (ms):\n", lt->count);
+    printf("  %-16s %8s %8s %8s %8s %8s %8s\n", "", "min", "mean", "p50", "p90", "p99", "max");
+    printLatencyRow("event seen", lt->handled, lt->count);
+    printLatencyRow("renderGame", lt->rendered, lt->count);
+    if (lt->readback)
+    {
+        printLatencyRow("readback", lt->read_back, lt->count);
+        if (lt->readback_failures > 0)
+        {
+            printf("  %d readbacks did not find the flash patch\n", lt->readback_failures);
+        }
+    }
+    printLatencyRow("present", lt->presented, lt->count);
+
+    // Histogram of injection to present
+    if (lt->count > 0)
+    {
+        int buckets[LATENCY_BUCKETS] = {0};
+        int peak = 0;
+        for (int i = 0; i < lt->count; i++)
+        {
+            int b = (int)(lt->presented[i] / LATENCY_BUCKET_MS);
+            b = b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+            buckets[b]++;
+            peak = buckets[b] > peak ? buckets[b] : peak;
+        }
+
+        printf("\n  Injection to present:\n");
+        for (int b = 0; b < LATENCY_BUCKETS; b++)
+        {
+            if (buckets[b] == 0)
+            {
+                continue;
+            }
+            char bar[41];
+            int len = buckets[b] * 40 / peak;
+            memset(bar, '#', len);
+            bar[len] = '\0';
+            printf("  %3d-%-3d ms %5d %s%s\n", (int)(b * LATENCY_BUCKET_MS), (int)((b + 1) * LATENCY_BUCKET_MS),
+                   buckets[b], bar, b == LATENCY_BUCKETS - 1 ? " (and slower)" : "");
+        }
+    }
+
+    free(lt->handled);
+    free(lt->rendered);
+    free(lt->read_back);
+    free(lt->presented);
+}
+
+// Open the control socket and start the thread serving it
+int startControlSocket()
+{
+    ControlSocket *cs = &control_socket;
+    if (cs->path == NULL)
+    {
+        return 0;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(cs->path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Control socket path too long: %s\n", cs->path);
+        return 0;
+    }
+    strcpy(addr.sun_path, cs->path);
+
+    cs->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (cs->listen_fd < 0)
+    {
+        perror("Failed to create control socket");
+        return 0;
+    }
+    unlink(cs->path); // Left over from a previous run
+    if (bind(cs->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(cs->listen_fd, 1) < 0)
+    {
+        perror("Failed to listen on control socket");
+        close(cs->listen_fd);
+        cs->listen_fd = -1;
+        return 0;
+    }
+
+    if (pthread_create(&cs->thread, NULL, controlSocketServer, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create control socket thread\n");
+        close(cs->listen_fd);
+        cs->listen_fd = -1;
+        unlink(cs->path);
+        return 0;
+    }
+    cs->started = 1;
+
+    printf("Control socket: listening on %s\n", cs->path);
+    return 1;
+}
+
+// Microseconds on the monotonic clock
+long controlNowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// Sleep until t_us on the monotonic clock; returns 0 if the game stopped first
+int controlSleepUntil(long t_us)
+{
+    while (isRunning())
+    {
+        long remaining = t_us - controlNowUs();
+        if (remaining <= 0)
+        {
+            return 1;
+        }
+        struct timespec ts = {0, (remaining > CONTROL_POLL_US ? CONTROL_POLL_US : remaining) * 1000L};
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+// Push a synthetic event into the queue handleEvents() drains
+void controlPush(SDL_Event *e)
+{
+    ControlSocket *cs = &control_socket;
+    if (SDL_PushEvent(e) == 1)
+    {
+        cs->events_pushed++;
+    }
+    else
+    {
+        cs->events_dropped++;
+    }
+}
+
+void controlPushMotion(int x, int y, int xrel, int yrel)
+{
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = SDL_MOUSEMOTION;
+    e.motion.windowID = SDL_GetWindowID(window);
+    e.motion.x = x;
+    e.motion.y = y;
+    e.motion.xrel = xrel;
+    e.motion.yrel = yrel;
+    controlPush(&e);
+}
+
+// Reply to the driver; a driver that has gone away only ends its session
+void controlReply(int fd, const char *format, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0)
+    {
+        send(fd, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1, MSG_NOSIGNAL);
+    }
+}
+
+// Reply with the numbers the performance overlay shows, from the live metrics segment
+void controlReplyStats(int fd)
+{
+    if (metrics == NULL)
+    {
+        controlReply(fd, "error live metrics are off\n");
+        return;
+    }
+
+    NinjaMetrics snapshot;
+    int copied = 0;
+    for (int attempt = 0; attempt < 100 && !copied; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&metrics->seq, __ATOMIC_ACQUIRE);
+        if (start & 1)
+        {
+            continue;
+        }
+        memcpy(&snapshot, (const void *)metrics, sizeof(snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        copied = __atomic_load_n(&metrics->seq, __ATOMIC_RELAXED) == start;
+    }
+    if (!copied)
+    {
+        controlReply(fd, "error metrics busy\n");
+        return;
+    }
+
+    controlReply(fd,
+                 "stats frames %llu fps %.1f p50 %.2f p95 %.2f p99 %.2f events %.2f update %.2f powerups %.2f "
+                 "render %.2f present %.2f objects %d slices %llu score %d health %d lock_wait_ms %.1f\n",
+                 (unsigned long long)snapshot.frames, snapshot.fps, snapshot.frame_ms_p50, snapshot.frame_ms_p95,
+                 snapshot.frame_ms_p99, snapshot.phase_ms[0], snapshot.phase_ms[1], snapshot.phase_ms[2],
+                 snapshot.phase_ms[3], snapshot.phase_ms[4], snapshot.active_objects,
+                 (unsigned long long)snapshot.slices, snapshot.score, snapshot.health, snapshot.lock_wait_ms);
+}
+
+// Run one command line from the driver; returns 0 when the session should end
+// A line may start with a time in microseconds since the driver connected; the
+// command then waits for that moment, so a script replays with its own timing.
+int controlCommand(int fd, char *line, long session_start_us)
+{
+    ControlSocket *cs = &control_socket;
+    char *tokens[CONTROL_MAX_TOKENS];
+    int count = 0;
+    for (char *save = NULL, *token = strtok_r(line, " \t\r", &save); token != NULL && count < CONTROL_MAX_TOKENS;
+         token = strtok_r(NULL, " \t\r", &save))
+    {
+        tokens[count++] = token;
+    }
+    if (count == 0 || tokens[0][0] == '#')
+    {
+        return 1;
+    }
+
+    char **argv = tokens;
+    if (isdigit((unsigned char)argv[0][0]))
+    {
+        if (!controlSleepUntil(session_start_us + atol(argv[0])))
+        {
+            return 0;
+        }
+        argv++;
+        count--;
+        if (count == 0)
+        {
+            return 1;
+        }
+    }
+    cs->commands++;
+
+    const char *cmd = argv[0];
+    if (strcmp(cmd, "move") == 0 && count >= 3)
+    {
+        int x = atoi(argv[1]);
+        int y = atoi(argv[2]);
+        controlPushMotion(x, y, x - cs->pointer_x, y - cs->pointer_y);
+        cs->pointer_x = x;
+        cs->pointer_y = y;
+    }
+    else if (strcmp(cmd, "path") == 0 && count >= 6)
+    {
+        // Blade stroke from (x1, y1) to (x2, y2) over ms milliseconds, one motion event per step
+        int x1 = atoi(argv[1]), y1 = atoi(argv[2]), x2 = atoi(argv[3]), y2 = atoi(argv[4]);
+        long duration_us = atol(argv[5]) * 1000L;
+        int steps = (int)(duration_us / CONTROL_PATH_STEP_US);
+        steps = steps > 0 ? steps : 1;
+        long start_us = controlNowUs();
+        for (int s = 0; s <= steps; s++)
+        {
+            if (s > 0 && !controlSleepUntil(start_us + duration_us * s / steps))
+            {
+                return 0;
+            }
+            int x = x1 + (x2 - x1) * s / steps;
+            int y = y1 + (y2 - y1) * s / steps;
+            controlPushMotion(x, y, x - cs->pointer_x, y - cs->pointer_y);
+            cs->pointer_x = x;
+            cs->pointer_y = y;
+        }
+    }
+    else if ((strcmp(cmd, "down") == 0 || strcmp(cmd, "up") == 0) && count >= 3)
+    {
+        SDL_Event e;
+        memset(&e, 0, sizeof(e));
+        int down = cmd[0] == 'd';
+        e.type = down ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+        e.button.windowID = SDL_GetWindowID(window);
+        e.button.button = count >= 4 ? atoi(argv[3]) : SDL_BUTTON_LEFT;
+        e.button.state = down ? SDL_PRESSED : SDL_RELEASED;
+        e.button.clicks = 1;
+        e.button.x = cs->pointer_x = atoi(argv[1]);
+        e.button.y = cs->pointer_y = atoi(argv[2]);
+        controlPush(&e);
+    }
+    else if (strcmp(cmd, "click") == 0 && count >= 3)
+    {
+        char down[64], up[64];
+        snprintf(down, sizeof(down), "down %s %s", argv[1], argv[2]);
+        snprintf(up, sizeof(up), "up %s %s", argv[1], argv[2]);
+        cs->commands -= 2; // Counted once, as a click
+        return controlCommand(fd, down, session_start_us) && controlCommand(fd, up, session_start_us);
+    }
+    else if (strcmp(cmd, "key") == 0 && count >= 2)
+    {
+        SDL_Keycode key = SDL_GetKeyFromName(argv[1]);
+        if (key == SDLK_UNKNOWN)
+        {
+            controlReply(fd, "error unknown key %s\n", argv[1]);
+            return 1;
+        }
+        SDL_Event e;
+        memset(&e, 0, sizeof(e));
+        e.key.windowID = SDL_GetWindowID(window);
+        e.key.keysym.sym = key;
+        e.type = SDL_KEYDOWN;
+        e.key.state = SDL_PRESSED;
+        controlPush(&e);
+        e.type = SDL_KEYUP;
+        e.key.state = SDL_RELEASED;
+        controlPush(&e);
+    }
+    else if (strcmp(cmd, "stats") == 0)
+    {
+        controlReplyStats(fd);
+    }
+    else if (strcmp(cmd, "ping") == 0)
+    {
+        controlReply(fd, "pong %ld\n", controlNowUs() - session_start_us);
+    }
+    else if (strcmp(cmd, "bye") == 0)
+    {
+        return 0;
+    }
+    else
+    {
+        cs->commands--;
+        controlReply(fd, "error bad command %s\n", cmd);
+    }
+    return 1;
+}
+
+// Serve one driver at a time until the game stops
+void *controlSocketServer(void *arg)
+{
+    ControlSocket *cs = &control_socket;
+    (void)arg;
+    nameThread("ninja-control");
+    lowJitterThread(0);
+    TRACE_THREAD_NAME("ninja-control");
+
+    while (isRunning())
+    {
+        struct pollfd pfd = {cs->listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, CONTROL_POLL_US / 1000) <= 0)
+        {
+            continue;
+        }
+        int fd = accept4(cs->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        cs->sessions++;
+        long session_start_us = controlNowUs();
+        // The mouse globals belong to the main thread, so relative motion starts from the centre
+        cs->pointer_x = WINDOW_WIDTH / 2;
+        cs->pointer_y = WINDOW_HEIGHT / 2;
+
+        char buffer[CONTROL_LINE_MAX];
+        int used = 0;
+        int connected = 1;
+        while (isRunning() && connected)
+        {
+            pfd = (struct pollfd){fd, POLLIN, 0};
+            if (poll(&pfd, 1, CONTROL_POLL_US / 1000) <= 0)
+            {
+                continue;
+            }
+            ssize_t got = recv(fd, buffer + used, sizeof(buffer) - 1 - used, 0);
+            if (got <= 0)
+            {
+                break;
+            }
+            used += got;
+            buffer[used] = '\0';
+
+            // Run every complete line, keeping a partial one for the next read
+            char *line = buffer;
+            char *newline;
+            while (connected && (newline = strchr(line, '\n')) != NULL)
+            {
+                *newline = '\0';
+                connected = controlCommand(fd, line, session_start_us);
+                line = newline + 1;
+            }
+            used -= line - buffer;
+            memmove(buffer, line, used);
+            if (used == (int)sizeof(buffer) - 1)
+            {
+                controlReply(fd, "error line too long\n");
+                used = 0;
+            }
+        }
+        close(fd);
+    }
+
+    return NULL;
+}
+
+// Stop serving and remove the socket
+void stopControlSocket()
+{
+    ControlSocket *cs = &control_socket;
+    if (!cs->started)
+    {
+        return;
+    }
+    pthread_join(cs->thread, NULL);
+    cs->started = 0;
+    close(cs->listen_fd);
+    unlink(cs->path);
+
+    printf("Control socket: %ld sessions, %ld commands, %ld events injected, %ld dropped (queue full)\n",
+           cs->sessions, cs->commands, cs->events_pushed, cs->events_dropped);
+}
+
+// Touch every page of a buffer so it is faulted in before the game starts
+long prefault(void *memory, size_t size)
+{
+    volatile char *bytes = memory;
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < size; offset += page)
+    {
+        bytes[offset] = bytes[offset];
+    }
+    return size / 1024;
+}
+
+// Settle the main thread and memory for steady frame times (--low-jitter)
+// Called once after initGame() and before the game's own threads and the
+// power-up process start (only SDL's audio thread is already running), so
+// they inherit the main thread's settings until lowJitterThread() moves them.
+// Everything here falls back quietly when not permitted; the report says what
+// was actually achieved.
+void applyLowJitter()
+{
+    LowJitter *lj = &low_jitter;
+    if (!lj->enabled)
+    {
+        return;
+    }
+
+    char affinity[64] = "not supported";
+#ifdef __linux__
+    // Only the CPUs our cpuset or taskset allows, which need not be 0..N-1
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        CPU_ZERO(&allowed);
+    }
+    lj->cpus = CPU_COUNT(&allowed);
+    if (lj->main_cpu < 0 || lj->main_cpu >= CPU_SETSIZE || !CPU_ISSET(lj->main_cpu, &allowed))
+    {
+        if (lj->main_cpu >= 0)
+        {
+            printf("Low-jitter: CPU %d is not available to the game\n", lj->main_cpu);
+        }
+
+        // CPU 0 usually takes the most interrupts, so default to the last one
+        lj->main_cpu = -1;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                lj->main_cpu = cpu;
+            }
+        }
+    }
+
+    if (lj->cpus < 2)
+    {
+        snprintf(affinity, sizeof(affinity), "not pinned (one CPU)");
+    }
+    else
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(lj->main_cpu, &set);
+        lj->background_cpus = allowed;
+        CPU_CLR(lj->main_cpu, &lj->background_cpus);
+        lj->pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+        if (lj->pinned)
+        {
+            snprintf(affinity, sizeof(affinity), "on CPU %d", lj->main_cpu);
+        }
+        else
+        {
+            snprintf(affinity, sizeof(affinity), "not pinned (%s)", strerror(errno));
+        }
+    }
+
+    errno = 0;
+    lj->main_nice_ok = setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), LOW_JITTER_MAIN_NICE) == 0;
+    int nice_errno = errno;
+#else
+    lj->main_nice_ok = 0;
+    int nice_errno = ENOSYS;
+#endif
+
+    // Lock future allocations too only when the limit can't make them fail later
+    struct rlimit limit;
+    int lock_future = geteuid() == 0 ||
+                      (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY);
+    if (mlockall(lock_future ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT) == 0)
+    {
+        lj->locked = lock_future ? 2 : 1;
+    }
+    else
+    {
+        lj->lock_errno = errno;
+    }
+
+    // Object pools and per-frame bookkeeping, then the main thread's stack
+    lj->prefaulted_kb += prefault(gameObjects, sizeof(gameObjects));
+    lj->prefaulted_kb += prefault(&perf_stats, sizeof(perf_stats));
+    lj->prefaulted_kb += prefault(&flight_recorder, sizeof(flight_recorder));
+    lj->prefaulted_kb += prefault(pending_splats, sizeof(pending_splats));
+    lj->prefaulted_kb += prefault(thread_stats, sizeof(thread_stats));
+    volatile char stack[LOW_JITTER_STACK_KB * 1024];
+    lj->prefaulted_kb += prefault((void *)stack, sizeof(stack));
+
+    // Draw every object type, whole and sliced, through the chosen render path
+    // once so its textures and buffers are resident before the first real frame
+    GameObject warmup[2 * (BOMB + 1)];
+    memset(warmup, 0, sizeof(warmup));
+    for (int i = 0; i < 2 * (BOMB + 1); i++)
+    {
+        warmup[i].active = 1;
+        warmup[i].type = i % (BOMB + 1);
+        warmup[i].sliced = i > BOMB;
+        warmup[i].x = (i % (BOMB + 1)) * FRUIT_SIZE * 2;
+        warmup[i].y = WINDOW_HEIGHT / 2;
+        for (int j = 0; j < SLICE_PIECES; j++)
+        {
+            warmup[i].pieces[j].x = warmup[i].x;
+            warmup[i].pieces[j].y = warmup[i].y;
+            warmup[i].pieces[j].timeLeft = SLICE_DURATION;
+        }
+    }
+    SDL_RenderCopy(renderer, splat_texture != NULL ? splat_texture : background_texture, NULL, NULL);
+    drawGameObjects(warmup, 2 * (BOMB + 1));
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+
+    printf("Low-jitter: main thread %s, nice %s; background threads %s, spawner and deadlock monitor at nice %d\n",
+           affinity, lj->main_nice_ok ? "-10" : strerror(nice_errno),
+           lj->pinned ? "on the other CPUs" : "unpinned", LOW_JITTER_BACKGROUND_NICE);
+    printf("Low-jitter: memory %s, %ld KB prefaulted, render path warmed up\n",
+           lj->locked == 2   ? "locked (current and future)"
+           : lj->locked == 1 ? "locked (current pages only; RLIMIT_MEMLOCK is limited)"
+                             : strerror(lj->lock_errno),
+           lj->prefaulted_kb);
+}
+
+// Move the calling background thread off the main thread's CPU, optionally at lower priority
+void lowJitterThread(int lower_priority)
+{
+    LowJitter *lj = &low_jitter;
+    if (!lj->enabled)
+    {
+        return;
+    }
+
+#ifdef __linux__
+    if (lj->pinned)
+    {
+        sched_setaffinity(0, sizeof(lj->background_cpus), &lj->background_cpus);
+    }
+
+    // Raising niceness is always allowed, including after the main thread's was lowered
+    if (lower_priority)
+    {
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), LOW_JITTER_BACKGROUND_NICE);
+    }
+#else
+    (void)lower_priority;
+#endif
+}
+
+// Run this simulation step's share of the spawner, deadlock monitor and
+// power-up process, at the periods their threads and process sleep for.
+// Everything happens on the main thread in a fixed order, so a given seed
+// and input always plays out the same way.
+void singleThreadStep()
+{
+    SingleThread *st = &single_thread;
+    st->steps++;
+
+    if (st->steps % SINGLE_THREAD_SPAWN_STEPS == 0)
+    {
+        TRACE_BEGIN("spawnTick");
+        spawnTick(&st->spawner, simNowMs() / 1000);
+        TRACE_END("spawnTick");
+    }
+    if (st->steps % SINGLE_THREAD_DEADLOCK_STEPS == 0)
+    {
+        TRACE_BEGIN("deadlockTick");
+        deadlockTick();
+        TRACE_END("deadlockTick");
+    }
+    if (st->steps % SINGLE_THREAD_POWERUP_STEPS == 0)
+    {
+        int power_type = rollPowerUp();
+        if (power_type >= 0)
+        {
+            printf("Simulation step %ld spawned power-up: %d\n", st->steps, power_type);
+            activatePowerUp(power_type);
+        }
+    }
+}
+
+// Game clock in milliseconds: wall time, or simulation time in single-thread mode
+Uint32 simNowMs()
+{
+    if (single_thread.enabled)
+    {
+        return (Uint32)(single_thread.steps * SIM_STEP_MS);
+    }
+    return SDL_GetTicks();
+}
+
+// Random number for drawing only, so how often frames are drawn never shifts the simulation
+int visualRand()
+{
+    return rand_r(&visual_rand_state);
+}
+
+// Draw fruit function - renders different types of fruits/bombs
+void drawFruit(ObjectType type, float x, float y, float rotation, int sliced)
+{
+    const int halfSize = FRUIT_SIZE / 2;
+    const bool detailed = quality_governor.level < QUALITY_MINIMAL;
+
+    // Different colors and shapes for different fruits
+    switch (type)
+    {
+    case APPLE:
+        if (!sliced)
+        {
+            // Red apple with gradient
+            filledCircleRGBA(renderer, x, y, halfSize - 5, 220, 0, 0, 255);
+            filledCircleRGBA(renderer, x, y, halfSize - 8, 255, 30, 30, 255);
+            // Highlight
+            filledCircleRGBA(renderer, x - halfSize / 3, y - halfSize / 3, halfSize / 4, 255, 100, 100, 200);
+
+            // Stem
+            SDL_SetRenderDrawColor(renderer, 139, 69, 19, 255);
+            SDL_Rect stem = {x - 3, y - halfSize + 5, 6, 10};
+            SDL_RenderFillRect(renderer, &stem);
+
+            // Leaf
+            SDL_SetRenderDrawColor(renderer, 0, 150, 0, 255);
+            SDL_Point leaf[4] = {
+                {x + 6, y - halfSize + 8},
+                {x + 18, y - halfSize + 2},
+                {x + 15, y - halfSize + 6},
+                {x + 6, y - halfSize + 12}};
+            int numPoints = 4;
+            SDL_RenderDrawLines(renderer, leaf, numPoints);
+
+            // Fill leaf with gradient
+            for (int i = 0; detailed && i < 5; i++)
+            {
+                SDL_SetRenderDrawColor(renderer, 0, 150 - i * 10, 0, 255);
+                SDL_Point leafFill[] = {
+                    {x + 6, y - halfSize + 8 + i},
+                    {x + 15 - i, y - halfSize + 5},
+                    {x + 10, y - halfSize + 10}};
+                SDL_RenderDrawLines(renderer, leafFill, 3);
+            }
+        }
+        else
+        {
+            // Sliced apple - two halves with more detail
+            // Left half
+            filledCircleRGBA(renderer, x - 15, y, halfSize - 10, 220, 0, 0, 255);
+            filledCircleRGBA(renderer, x - 15, y, halfSize - 13, 240, 20, 20, 255);
+
+            // Right half
+            filledCircleRGBA(renderer, x + 15, y, halfSize - 10, 220, 0, 0, 255);
+            filledCircleRGBA(renderer, x + 15, y, halfSize - 13, 240, 20, 20, 255);
+
+            // White inside with seeds and flesh details
+            filledCircleRGBA(renderer, x - 15, y, halfSize - 15, 255, 240, 240, 255);
+            filledCircleRGBA(renderer, x + 15, y, halfSize - 15, 255, 240, 240, 255);
+
+            // Seeds
+            SDL_SetRenderDrawColor(renderer, 80, 40, 0, 255);
+            for (int i = 0; detailed && i < 5; i++)
+            {
+                float angle = M_PI * i / 5.0;
+                SDL_Rect seed1 = {
+                    x - 15 + cos(angle) * (halfSize - 25) - 1,
+                    y + sin(angle) * (halfSize - 25) - 2,
+                    3, 4};
+                SDL_Rect seed2 = {
+                    x + 15 + cos(angle) * (halfSize - 25) - 1,
+                    y + sin(angle) * (halfSize - 25) - 2,
+                    3, 4};
+                SDL_RenderFillRect(renderer, &seed1);
+                SDL_RenderFillRect(renderer, &seed2);
+            }
+
+            // Flesh details
+            SDL_SetRenderDrawColor(renderer, 230, 210, 210, 255);
+            for (int i = 0; detailed && i < 8; i++)
+            {
+                float angle = 2 * M_PI * i / 8.0;
+                SDL_RenderDrawLine(renderer,
+                                   x - 15, y,
+                                   x - 15 + cos(angle) * (halfSize - 17),
+                                   y + sin(angle) * (halfSize - 17));
+                SDL_RenderDrawLine(renderer,
+                                   x + 15, y,
+                                   x + 15 + cos(angle) * (halfSize - 17),
+                                   y + sin(angle) * (halfSize - 17));
+            }
+        }
+        break;
+
+    case BANANA:
+        if (!sliced)
+        {
+            // Yellow banana with gradient and curvature
+            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+
+            // Draw a curved banana shape with gradient
+            for (int i = -20; i <= 20; i++)
+            {
+                float angle = (float)i / 20.0f * 3.14f;
+                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
+
+                // Gradient from yellow to slightly darker yellow
+                int shade = 255 - abs(i) * 3;
+                filledCircleRGBA(renderer, cx, cy, 8, shade, shade, 0, 255);
+            }
+
+            // Add shadows and highlights
+            for (int i = -18; detailed && i <= -5; i++)
+            {
+                float angle = (float)i / 20.0f * 3.14f;
+                float cx = x + cos(angle + rotation) * halfSize * 0.75f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.25f;
+                filledCircleRGBA(renderer, cx, cy, 3, 255, 255, 150, 150);
+            }
+
+            // Banana ends (darker)
+            for (int i = -20; i <= -18; i++)
+            {
+                float angle = (float)i / 20.0f * 3.14f;
+                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
                 float cy = y + sin(angle + rotation) * halfSize * 0.3f;
+                filledCircleRGBA(renderer, cx, cy, 6, 200, 180, 0, 255);
+            }
+
+            for (int i = 18; i <= 20; i++)
+            {
+                float angle = (float)i / 20.0f * 3.14f;
+                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
+                filledCircleRGBA(renderer, cx, cy, 6, 200, 180, 0, 255);
+            }
+        }
+        else
+        {
+            // Sliced banana with more detailed inside - enhanced appearance
+            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+
+            // Separation gap between banana halves
+            float separationX = 16.0f; // Increased from 15 for more visible separation
+
+            // Left half - more curved for better visual slicing
+            for (int i = -10; i <= 0; i++)
+            {
+                float angle = (float)i / 10.0f * 3.14f;
+                float cx = x - separationX + cos(angle + rotation) * halfSize * 0.7f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
+                filledCircleRGBA(renderer, cx, cy, 6, 255, 255, 30, 255);
+            }
+
+            // Right half - more curved for better visual slicing
+            for (int i = 0; i <= 10; i++)
+            {
+                float angle = (float)i / 10.0f * 3.14f;
+                float cx = x + separationX + cos(angle + rotation) * halfSize * 0.7f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
+                filledCircleRGBA(renderer, cx, cy, 6, 255, 255, 30, 255);
+            }
+
+            // Inside (creamy white) - more visible and contrasting
+            for (int i = -8; i <= 0; i++)
+            {
+                float angle = (float)i / 8.0f * 3.14f;
+                float cx = x - separationX + cos(angle + rotation) * halfSize * 0.5f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.2f;
+                filledCircleRGBA(renderer, cx, cy, 5, 255, 250, 220, 255); // Bigger inside (was 4)
+            }
+
+            for (int i = 0; i <= 8; i++)
+            {
+                float angle = (float)i / 8.0f * 3.14f;
+                float cx = x + separationX + cos(angle + rotation) * halfSize * 0.5f;
+                float cy = y + sin(angle + rotation) * halfSize * 0.2f;
+                filledCircleRGBA(renderer, cx, cy, 5, 255, 250, 220, 255); // Bigger inside (was 4)
+            }
+
+            // Seeds - darker and more visible
+            SDL_SetRenderDrawColor(renderer, 20, 20, 0, 255); // Darker seeds (was 30, 30, 0)
+            for (int i = -2; detailed && i <= 2; i++)
+            {
+                SDL_Rect seed1 = {x - separationX + i * 5, y, 3, 3}; // Bigger seeds
+                SDL_Rect seed2 = {x + separationX + i * 5, y, 3, 3}; // Bigger seeds
+                SDL_RenderFillRect(renderer, &seed1);
+                SDL_RenderFillRect(renderer, &seed2);
+            }
+
+            // Draw slice "cut line" for more obvious slice effect
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 180);
+            for (int i = -2; i <= 2; i++)
+            {
+                SDL_RenderDrawLine(renderer,
+                                   x - halfSize + 10, y + i,
+                                   x + halfSize - 10, y + i);
+            }
+        }
+        break;
+
+    case ORANGE:
+        if (!sliced)
+        {
+            // Orange with texture and gradient - adjusted to match collision radius of FRUIT_SIZE * 0.55f
+            int orangeRadius = (int)(halfSize * 0.85f); // Approximately 55% of FRUIT_SIZE (halfSize is FRUIT_SIZE/2)
+
+            // Main orange body - more consistent size
+            filledCircleRGBA(renderer, x + halfSize / 2, y + halfSize / 2, orangeRadius, 255, 140, 0, 255);
+            filledCircleRGBA(renderer, x + halfSize / 2, y + halfSize / 2, orangeRadius - 3, 255, 165, 0, 255);
+
+            // Subtle highlight (much smaller than before)
+            filledCircleRGBA(renderer,
+                             x + halfSize / 2 - orangeRadius / 4,
+                             y + halfSize / 2 - orangeRadius / 4,
+                             orangeRadius / 8, 255, 230, 180, 150);
+
+            // Texture dots
+            SDL_SetRenderDrawColor(renderer, 200, 120, 0, 255);
+            for (int i = 0; detailed && i < 20; i++)
+            {
+                // float angle = 2.0f * 3.14f * i / 20.0f + rotation;
+                // float radius = orangeRadius - 5 - (rand() % 5);
+                float cx = x;
+                float cy = y;
+                filledCircleRGBA(renderer, cx, cy, 2, 220, 140, 0, 200);
+            }
+
+            // Stem/leaf detail at top
+            SDL_SetRenderDrawColor(renderer, 50, 100, 0, 255);
+            SDL_Rect stem = {x + halfSize / 2 - 4, y + halfSize / 2 - orangeRadius - 2, 8, 6};
+            SDL_RenderFillRect(renderer, &stem);
+
+            // Small leaf
+            SDL_SetRenderDrawColor(renderer, 0, 130, 0, 255);
+            SDL_Point leaf[3] = {
+                {x + halfSize / 2, y + halfSize / 2 - orangeRadius + 1},
+                {x + halfSize / 2 + 10, y + halfSize / 2 - orangeRadius - 4},
+                {x + halfSize / 2 + 5, y + halfSize / 2 - orangeRadius + 4}};
+            SDL_RenderDrawLines(renderer, leaf, 3);
+        }
+        else
+        {
+            // Sliced orange with detailed segments - enhanced separation
+            float separationX = 18.0f;                  // Increased from 15 for more visible separation
+            int orangeRadius = (int)(halfSize * 0.85f); // Match the unsliced radius
+
+            // Outer rind - brighter color
+            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 5, 255, 140, 0, 255);
+            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 5, 255, 140, 0, 255);
+
+            // White pith layer - more contrast
+            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 7, 255, 240, 220, 255); // Whiter
+            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 7, 255, 240, 220, 255); // Whiter
+
+            // Inside pulp - more vibrant
+            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 10, 255, 160, 80, 255); // More orange (was 180, 100)
+            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 10, 255, 160, 80, 255); // More orange
+
+            // Segment lines with thickness - more visible segments
+            SDL_SetRenderDrawColor(renderer, 255, 220, 180, 255); // Brighter lines
+            for (int i = 0; i < 8; i++)
+            {
+                float angle = 2.0f * M_PI * i / 8.0f;
+                int lineWidth = detailed ? 2 : 0;
+                for (int w = -lineWidth; w <= lineWidth; w++) // Wider lines (was -1 to 1)
+                {
+                    SDL_RenderDrawLine(renderer,
+                                       x + halfSize / 2 - separationX, y + halfSize / 2,
+                                       x + halfSize / 2 - separationX + cos(angle + w * 0.05) * (orangeRadius - 10),
+                                       y + halfSize / 2 + sin(angle + w * 0.05) * (orangeRadius - 10));
+
+                    SDL_RenderDrawLine(renderer,
+                                       x + halfSize / 2 + separationX, y + halfSize / 2,
+                                       x + halfSize / 2 + separationX + cos(angle + w * 0.05) * (orangeRadius - 10),
+                                       y + halfSize / 2 + sin(angle + w * 0.05) * (orangeRadius - 10));
+                }
+            }
+
+            // Seeds at center - more visible
+            SDL_SetRenderDrawColor(renderer, 255, 240, 200, 255);
+            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, 6, 255, 240, 200, 255);
+            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, 6, 255, 240, 200, 255);
+
+            // Individual seeds - more prominent
+            SDL_SetRenderDrawColor(renderer, 200, 160, 50, 255);
+            for (int i = 0; detailed && i < 5; i++)
+            {
+                float angle = 2.0f * M_PI * i / 5.0f;
+                SDL_Rect seed1 = {
+                    x + halfSize / 2 - separationX + cos(angle) * 3 - 1,
+                    y + halfSize / 2 + sin(angle) * 3 - 1,
+                    3, 4}; // Bigger (was 2, 3)
+                SDL_Rect seed2 = {
+                    x + halfSize / 2 + separationX + cos(angle) * 3 - 1,
+                    y + halfSize / 2 + sin(angle) * 3 - 1,
+                    3, 4}; // Bigger
+                SDL_RenderFillRect(renderer, &seed1);
+                SDL_RenderFillRect(renderer, &seed2);
+            }
+
+            // Draw slice "cut line" for more obvious slice effect
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 180);
+            for (int i = -2; i <= 2; i++)
+            {
+                SDL_RenderDrawLine(renderer,
+                                   x, y + halfSize / 2 + i,
+                                   x + FRUIT_SIZE, y + halfSize / 2 + i);
+            }
+        }
+        break;
+
+    case BOMB:
+        if (!sliced)
+        {
+            // Black bomb with metallic sheen
+            filledCircleRGBA(renderer, x, y, halfSize - 5, 20, 20, 20, 255);
+
+            // Metallic highlight
+            filledCircleRGBA(renderer, x - halfSize / 4, y - halfSize / 4, halfSize / 3, 40, 40, 40, 200);
+            filledCircleRGBA(renderer, x - halfSize / 3, y - halfSize / 3, halfSize / 6, 70, 70, 70, 200);
+
+            // Fuse
+            SDL_SetRenderDrawColor(renderer, 160, 120, 80, 255);
+            // Wavy fuse
+            for (int i = 0; i < 15; i += detailed ? 1 : 3)
+            {
+                float wave = sin(i * 0.5) * 3;
+                SDL_Rect fuseBit = {
+                    x - 2 + wave,
+                    y - halfSize - 5 + i,
+                    4,
+                    2};
+                SDL_RenderFillRect(renderer, &fuseBit);
+            }
+
+            // Spark (animated)
+            static float sparkPhase = 0.0f;
+            sparkPhase += 0.1f;
+
+            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+            filledCircleRGBA(renderer,
+                             x + sin(sparkPhase) * 3,
+                             y - halfSize - 10 + cos(sparkPhase) * 2,
+                             4 + sin(sparkPhase + 1.0f) * 2,
+                             255, 200 + sin(sparkPhase) * 55, 0, 255);
+
+            // Inner glow
+            filledCircleRGBA(renderer,
+                             x + sin(sparkPhase) * 2,
+                             y - halfSize - 10 + cos(sparkPhase) * 1,
+                             2,
+                             255, 255, 200, 255);
+        }
+        else
+        {
+            // Explosion effect with more detail and animation
+            static float explosionPhase = 0.0f;
+            explosionPhase += 0.05f;
+
+            // Central flash
+            filledCircleRGBA(renderer, x, y, halfSize, 255, 255, 200, 150);
+
+            // Fiery explosion particles - halved once the governor drops to low quality
+            int particles = quality_governor.level >= QUALITY_LOW ? 15 : 30;
+            for (int i = 0; i < particles; i++)
+            {
+                float angle = 2.0f * M_PI * i / particles + explosionPhase;
+                float speedVar = 0.6f + 0.4f * sin(i + explosionPhase);
+                float distance = (halfSize - 5) * (1.0f + ((float)visualRand() / RAND_MAX) * 0.8f) * speedVar;
+                float cx = x + cos(angle) * distance;
+                float cy = y + sin(angle) * distance;
+
+                // Fire colors
+                Uint8 r = 220 + visualRand() % 36;
+                Uint8 g = 100 + (i % 20) * 8;
+                Uint8 b = visualRand() % 40;
+
+                // Size varies based on distance
+                float size = 5 + (halfSize - distance / 5) / 5;
+
+                filledCircleRGBA(renderer, cx, cy, size, r, g, b, 255);
+
+                // Smaller bright center
+                filledCircleRGBA(renderer, cx, cy, size / 2, 255, 230, 200, 255);
+            }
+
+            // Smoke particles - fewer puffs at each lower quality level
+            static const int smokePuffs[QUALITY_LEVELS] = {15, 8, 4, 2};
+            int puffs = smokePuffs[quality_governor.level];
+            for (int i = 0; i < puffs; i++)
+            {
+                float angle = 2.0f * M_PI * i / puffs - explosionPhase;
+                float distance = (halfSize - 5) * (1.2f + ((float)visualRand() / RAND_MAX) * 1.0f);
+                float cx = x + cos(angle) * distance;
+                float cy = y + sin(angle) * distance;
+
+                // Gray smoke
+                Uint8 gray = 40 + visualRand() % 60;
+
+                filledCircleRGBA(renderer, cx, cy, 7 + visualRand() % 7, gray, gray, gray, 150);
+            }
+        }
+        break;
+    }
+}
+
+// Helper function for drawing filled circles since SDL doesn't provide one
+void filledCircleRGBA(SDL_Renderer *renderer, int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    if (render_path == RENDER_GEOMETRY)
+    {
+        filledCircleGeometry(renderer, x, y, radius, r, g, b, a);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+    for (int w = 0; w < radius * 2; w++)
+    {
+        for (int h = 0; h < radius * 2; h++)
+        {
+            int dx = radius - w;
+            int dy = radius - h;
+            if ((dx * dx + dy * dy) <= (radius * radius))
+            {
+                SDL_RenderDrawPoint(renderer, x + dx - radius, y + dy - radius);
+            }
+        }
+    }
+}
+
+// Filled circle as a single triangle fan, used by the geometry render path
+// Matches the footprint of filledCircleRGBA, which is centred up and to the
+// left of (x, y) by one radius.
+void filledCircleGeometry(SDL_Renderer *renderer, int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex vertices[CIRCLE_SEGMENTS + 1];
+    int indices[CIRCLE_SEGMENTS * 3];
+    SDL_Color color = {r, g, b, a};
+    float cx = x - radius;
+    float cy = y - radius;
+
+    vertices[0].position = (SDL_FPoint){cx, cy};
+    vertices[0].color = color;
+    for (int i = 0; i < CIRCLE_SEGMENTS; i++)
+    {
+        float angle = 2.0f * M_PI * i / CIRCLE_SEGMENTS;
+        vertices[i + 1].position = (SDL_FPoint){cx + cos(angle) * radius, cy + sin(angle) * radius};
+        vertices[i + 1].color = color;
+
+        indices[i * 3] = 0;
+        indices[i * 3 + 1] = i + 1;
+        indices[i * 3 + 2] = (i + 1) % CIRCLE_SEGMENTS + 1;
+    }
+
+    SDL_RenderGeometry(renderer, NULL, vertices, CIRCLE_SEGMENTS + 1, indices, CIRCLE_SEGMENTS * 3);
+#else
+    // Too old for SDL_RenderGeometry - calibration never picks this path
+    (void)renderer, (void)x, (void)y, (void)radius, (void)r, (void)g, (void)b, (void)a;
+#endif
+}
+
+// Atlas cell for a fruit: apples and oranges in the first row, then a row
+// each of whole and sliced banana frames, since drawFruit() bends the banana
+// along its rotation rather than turning it rigidly
+SDL_Rect fruitAtlasCell(ObjectType type, int sliced, int frame)
+{
+    if (type == BANANA)
+    {
+        return (SDL_Rect){frame * ATLAS_CELL, (1 + sliced) * ATLAS_CELL, ATLAS_CELL, ATLAS_CELL};
+    }
+    return (SDL_Rect){(type * 2 + sliced) * ATLAS_CELL, 0, ATLAS_CELL, ATLAS_CELL};
+}
+
+// Draw one fruit from the sprite atlas instead of procedurally
+void drawFruitSprite(ObjectType type, float x, float y, float rotation, int sliced)
+{
+    int frame = 0;
+    if (type == BANANA)
+    {
+        frame = (int)lroundf(rotation / (2.0f * M_PI) * ATLAS_ROTATIONS) % ATLAS_ROTATIONS;
+        frame = frame < 0 ? frame + ATLAS_ROTATIONS : frame;
+    }
+    SDL_Rect src = fruitAtlasCell(type, sliced, frame);
+    SDL_Rect dst = {x - ATLAS_CELL / 2, y - ATLAS_CELL / 2, ATLAS_CELL, ATLAS_CELL};
+    SDL_RenderCopy(renderer, fruit_atlas, &src, &dst);
+}
+
+// Draw objects (whole or as slice pieces) with drawFruit or the atlas
+// Bombs are always drawn procedurally: their fuse spark and explosion animate.
+void drawObjectsDirect(GameObject *objects, int count)
+{
+    bool atlas = render_path == RENDER_ATLAS;
+
+    // The quality governor's lowest level drops fruit detail; keep the sprites matching
+    if (atlas && atlas_detailed != (quality_governor.level < QUALITY_MINIMAL))
+    {
+        bakeFruitAtlas();
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        GameObject *obj = &objects[i];
+        if (!obj->active)
+        {
+            continue;
+        }
+        bool sprite = atlas && obj->type != BOMB;
+
+        if (!obj->sliced)
+        {
+            // Draw unsliced fruit/bomb
+            drawScopePush(SCOPE_APPLE + obj->type);
+            if (sprite)
+                drawFruitSprite(obj->type, obj->x, obj->y, obj->rotation, 0);
+            else
+                drawFruit(obj->type, obj->x, obj->y, obj->rotation, 0);
+            drawScopePop();
+        }
+        else
+        {
+            // Draw sliced pieces if they still have time left
+            for (int j = 0; j < SLICE_PIECES; j++)
+            {
+                if (obj->pieces[j].timeLeft > 0)
+                {
+                    drawScopePush(SCOPE_PIECES);
+                    if (sprite)
+                        drawFruitSprite(obj->type, obj->pieces[j].x, obj->pieces[j].y, obj->pieces[j].rotation, 1);
+                    else
+                        drawFruit(obj->type, obj->pieces[j].x, obj->pieces[j].y, obj->pieces[j].rotation, 1);
+                    drawScopePop();
+                }
+            }
+        }
+    }
+}
+
+// Draw all game objects using the current render path
+void drawGameObjects(GameObject *objects, int count)
+{
+    if (render_path != RENDER_SOFTWARE)
+    {
+        drawObjectsDirect(objects, count);
+        return;
+    }
+
+    // Software path: rasterise into the CPU surface, then upload it in one go
+    SDL_Renderer *screen = renderer;
+    SDL_SetRenderDrawColor(software_renderer, 0, 0, 0, 0);
+    SDL_RenderClear(software_renderer);
+
+    renderer = software_renderer;
+    drawObjectsDirect(objects, count);
+    renderer = screen;
+
+    SDL_UpdateTexture(software_layer, NULL, software_surface->pixels, software_surface->pitch);
+    SDL_RenderCopy(renderer, software_layer, NULL, NULL);
+}
+
+// Create the resources the non-procedural render paths need
+void initRenderPaths()
+{
+    // Sprite atlas: apples and oranges, whole and sliced, and banana frames
+    fruit_atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                    ATLAS_CELL * ATLAS_ROTATIONS, ATLAS_CELL * 3);
+    if (fruit_atlas == NULL)
+    {
+        printf("Fruit atlas could not be created! SDL Error: %s\n", SDL_GetError());
+    }
+    else
+    {
+        SDL_SetTextureBlendMode(fruit_atlas, SDL_BLENDMODE_BLEND);
+        bakeFruitAtlas();
+    }
+
+    // Software path: CPU surface plus a streaming texture to upload it into
+    software_surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (software_surface != NULL)
+    {
+        software_renderer = SDL_CreateSoftwareRenderer(software_surface);
+    }
+    software_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                       WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (software_renderer == NULL || software_layer == NULL)
+    {
+        printf("Software render path unavailable! SDL Error: %s\n", SDL_GetError());
+    }
+    else
+    {
+        SDL_SetTextureBlendMode(software_layer, SDL_BLENDMODE_BLEND);
+    }
+}
+
+// Draw every fruit sprite into the atlas at the current quality level
+void bakeFruitAtlas()
+{
+    SDL_Texture *target = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, fruit_atlas);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    for (int type = APPLE; type < BOMB; type++)
+    {
+        int frames = type == BANANA ? ATLAS_ROTATIONS : 1;
+        for (int sliced = 0; sliced <= 1; sliced++)
+        {
+            for (int frame = 0; frame < frames; frame++)
+            {
+                SDL_Rect cell = fruitAtlasCell(type, sliced, frame);
+                drawFruit(type, cell.x + ATLAS_CELL / 2, cell.y + ATLAS_CELL / 2,
+                          2.0f * M_PI * frame / ATLAS_ROTATIONS, sliced);
+            }
+        }
+    }
+
+    SDL_SetRenderTarget(renderer, target);
+    atlas_detailed = quality_governor.level < QUALITY_MINIMAL;
+}
+
+// Free the render path resources
+void cleanupRenderPaths()
+{
+    if (fruit_atlas != NULL)
+    {
+        SDL_DestroyTexture(fruit_atlas);
+        fruit_atlas = NULL;
+    }
+
+    if (software_layer != NULL)
+    {
+        SDL_DestroyTexture(software_layer);
+        software_layer = NULL;
+    }
+
+    if (software_renderer != NULL)
+    {
+        SDL_DestroyRenderer(software_renderer);
+        software_renderer = NULL;
+    }
+
+    if (software_surface != NULL)
+    {
+        SDL_FreeSurface(software_surface);
+        software_surface = NULL;
+    }
+}
+
+// Whether the resources for a render path were created successfully
+int renderPathAvailable(RenderPath path)
+{
+    switch (path)
+    {
+    case RENDER_ATLAS:
+        return fruit_atlas != NULL;
+    case RENDER_GEOMETRY:
+        return SDL_VERSION_ATLEAST(2, 0, 18);
+    case RENDER_SOFTWARE:
+        return software_renderer != NULL && software_layer != NULL;
+    default:
+        return 1;
+    }
+}
+
+// Time one render path drawing the calibration scene into an offscreen target
+// Returns the fastest of the timed runs in milliseconds. Reading back a pixel
+// after each run makes the GPU finish the work before the clock stops.
+double timeRenderPath(RenderPath path, GameObject *scene, int count, SDL_Texture *target)
+{
+    RenderPath saved_path = render_path;
+    SDL_Rect probe = {0, 0, 1, 1};
+    Uint32 pixel;
+    double best = -1.0;
+    double spent = 0.0;
+
+    render_path = path;
+    SDL_SetRenderTarget(renderer, target);
+
+    // Run 0 is a warm-up and isn't counted
+    for (int run = 0; run <= CALIBRATION_RUNS && spent < CALIBRATION_PATH_BUDGET_MS; run++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        drawGameObjects(scene, count);
+        SDL_RenderReadPixels(renderer, &probe, SDL_PIXELFORMAT_ARGB8888, &pixel, sizeof(pixel));
+
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        spent += ms;
+        if (run > 0 && (best < 0 || ms < best))
+        {
+            best = ms;
+        }
+    }
+
+    SDL_SetRenderTarget(renderer, NULL);
+    render_path = saved_path;
+
+    // A path too slow to get past its warm-up is charged for the warm-up
+    return best < 0 ? spent : best;
+}
+
+// Draw a scene with one render path into an offscreen target and read it back
+void renderScenePixels(RenderPath path, GameObject *scene, int count, SDL_Texture *target, Uint32 *pixels)
+{
+    RenderPath saved_path = render_path;
+    render_path = path;
+    SDL_SetRenderTarget(renderer, target);
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    drawGameObjects(scene, count);
+    if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, pixels, WINDOW_WIDTH * sizeof(Uint32)) != 0)
+    {
+        memset(pixels, 0, WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(Uint32));
+    }
+
+    SDL_SetRenderTarget(renderer, NULL);
+    render_path = saved_path;
+}
+
+// Percentage of the pixels either image draws on that differ visibly between them
+double pixelDifference(const Uint32 *reference, const Uint32 *pixels)
+{
+    long drawn = 0, differing = 0;
+    for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++)
+    {
+        Uint32 a = reference[i] & 0xffffff, b = pixels[i] & 0xffffff; // Ignore alpha
+        if (a == 0 && b == 0)
+        {
+            continue;
+        }
+        drawn++;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            if (abs((int)((a >> shift) & 0xff) - (int)((b >> shift) & 0xff)) > CALIBRATION_PIXEL_TOLERANCE)
+            {
+                differing++;
+                break;
+            }
+        }
+    }
+    return drawn > 0 ? 100.0 * differing / drawn : 0.0;
+}
+
+// Identify this machine and renderer for the calibration cache
+void getRenderPathKey(char *key, size_t len)
+{
+    char machine[64] = "";
+    FILE *file = fopen("/etc/machine-id", "r");
+    if (file != NULL)
+    {
+        if (fscanf(file, "%63s", machine) != 1)
+        {
+            machine[0] = '\0';
+        }
+        fclose(file);
+    }
+    if (machine[0] == '\0' && gethostname(machine, sizeof(machine)) != 0)
+    {
+        strcpy(machine, "unknown");
+    }
+    machine[sizeof(machine) - 1] = '\0';
+
+    SDL_RendererInfo info;
+    const char *renderer_name = "unknown";
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && info.name != NULL)
+    {
+        renderer_name = info.name;
+    }
+
+    snprintf(key, len, "%s/%s", machine, renderer_name);
+}
+
+// Look up a cached render path for this machine, or -1 if there is none
+int loadRenderPathChoice(const char *key)
+{
+    FILE *file = fopen(RENDER_PATH_FILE, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    char line_key[160];
+    char name[32];
+    int choice = -1;
+    while (fscanf(file, "%159s %31s", line_key, name) == 2)
+    {
+        if (strcmp(line_key, key) != 0)
+        {
+            continue;
+        }
+        for (int i = 0; i < RENDER_PATHS; i++)
+        {
+            if (strcmp(name, render_path_names[i]) == 0)
+            {
+                choice = i;
+            }
+        }
+    }
+
+    fclose(file);
+    return choice;
+}
+
+// Store the render path for this machine, keeping entries for other machines
+void saveRenderPathChoice(const char *key, RenderPath path)
+{
+    char lines[32][200];
+    int num_lines = 0;
+
+    FILE *file = fopen(RENDER_PATH_FILE, "r");
+    if (file != NULL)
+    {
+        char line_key[160];
+        char name[32];
+        while (num_lines < 31 && fscanf(file, "%159s %31s", line_key, name) == 2)
+        {
+            if (strcmp(line_key, key) != 0)
+            {
+                snprintf(lines[num_lines++], sizeof(lines[0]), "%s %s", line_key, name);
+            }
+        }
+        fclose(file);
+    }
+    snprintf(lines[num_lines++], sizeof(lines[0]), "%s %s", key, render_path_names[path]);
+
+    file = fopen(RENDER_PATH_FILE, "w");
+    if (file == NULL)
+    {
+        perror("Failed to open render path cache for writing");
+        return;
+    }
+    for (int i = 0; i < num_lines; i++)
+    {
+        fprintf(file, "%s\n", lines[i]);
+    }
+    fclose(file);
+}
+
+// Pick the render path for this run
+// Uses --render-path if given, otherwise the cached choice for this machine,
+// otherwise times every available path on a synthetic scene and keeps the
+// fastest of those whose output matches the procedural path's closely enough.
+// Calibration is bounded to well under a second.
+void calibrateRenderPath()
+{
+    if (forced_render_path >= 0 && renderPathAvailable(forced_render_path))
+    {
+        render_path = forced_render_path;
+        printf("Render path: %s (forced)\n", render_path_names[render_path]);
+        return;
+    }
+
+    char key[160];
+    getRenderPathKey(key, sizeof(key));
+
+    int cached = force_recalibration ? -1 : loadRenderPathChoice(key);
+    if (cached >= 0 && renderPathAvailable(cached))
+    {
+        render_path = cached;
+        printf("Render path: %s (cached for %s)\n", render_path_names[render_path], key);
+        return;
+    }
+
+    SDL_Texture *target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                            WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (target == NULL)
+    {
+        printf("Calibration target could not be created! SDL Error: %s\n", SDL_GetError());
+        return;
+    }
+
+    // Synthetic scene: every object type, a third of them mid-slice
+    GameObject scene[CALIBRATION_OBJECTS];
+    memset(scene, 0, sizeof(scene));
+    for (int i = 0; i < CALIBRATION_OBJECTS; i++)
+    {
+        scene[i].active = 1;
+        scene[i].type = i % (BOMB + 1);
+        scene[i].x = 60 + (i % 8) * 90;
+        scene[i].y = 80 + (i / 8) * 160;
+        scene[i].rotation = i * 0.3f;
+        scene[i].sliced = (i % 3 == 0);
+        for (int j = 0; j < SLICE_PIECES; j++)
+        {
+            scene[i].pieces[j].x = scene[i].x + (j == 0 ? -20 : 20);
+            scene[i].pieces[j].y = scene[i].y;
+            scene[i].pieces[j].rotation = scene[i].rotation;
+            scene[i].pieces[j].timeLeft = SLICE_DURATION;
+        }
+    }
+
+    // The same scene without bombs for comparing output: bombs are drawn the
+    // same way on every path, but their spark and explosion change every frame
+    GameObject fruit_scene[CALIBRATION_OBJECTS];
+    memcpy(fruit_scene, scene, sizeof(scene));
+    for (int i = 0; i < CALIBRATION_OBJECTS; i++)
+    {
+        fruit_scene[i].active = fruit_scene[i].type != BOMB;
+    }
+    Uint32 *reference = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(Uint32));
+    Uint32 *pixels = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(Uint32));
+    if (reference != NULL && pixels != NULL)
+    {
+        renderScenePixels(RENDER_PROCEDURAL, fruit_scene, CALIBRATION_OBJECTS, target, reference);
+    }
+
+    RenderPath fastest = RENDER_PROCEDURAL;
+    double fastest_ms = -1.0;
+    for (int path = 0; path < RENDER_PATHS; path++)
+    {
+        if (!renderPathAvailable(path))
+        {
+            printf("Calibration: %s path unavailable\n", render_path_names[path]);
+            continue;
+        }
+
+        double ms = timeRenderPath(path, scene, CALIBRATION_OBJECTS, target);
+        double difference = 0.0;
+        if (path != RENDER_PROCEDURAL && reference != NULL && pixels != NULL)
+        {
+            renderScenePixels(path, fruit_scene, CALIBRATION_OBJECTS, target, pixels);
+            difference = pixelDifference(reference, pixels);
+        }
+        printf("Calibration: %s path %.2f ms, %.1f%% of pixels differ from procedural\n",
+               render_path_names[path], ms, difference);
+        if (difference > CALIBRATION_MAX_DIFF_PERCENT)
+        {
+            printf("Calibration: %s path looks too different, not using it\n", render_path_names[path]);
+            continue;
+        }
+        if (fastest_ms < 0 || ms < fastest_ms)
+        {
+            fastest = path;
+            fastest_ms = ms;
+        }
+    }
+
+    free(reference);
+    free(pixels);
+    SDL_DestroyTexture(target);
+
+    render_path = fastest;
+    saveRenderPathChoice(key, render_path);
+    printf("Render path: %s (calibrated for %s)\n", render_path_names[render_path], key);
+}
+
+// Create the starfield background texture from background_seed
+void createBackground()
+{
+    // Create a solid color background if no background image is available
+    background_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                           SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    if (background_texture == NULL)
+    {
+        printf("Background texture could not be created! SDL Error: %s\n", SDL_GetError());
+        // Continue without background
+    }
+    else
+    {
+        // Set render target to the background texture
+        SDL_SetRenderTarget(renderer, background_texture);
+
+        // Fill with deep space gradient
+        for (int y = 0; y < WINDOW_HEIGHT; y++)
+        {
+            // Gradient from deep space black/purple to slightly blue
+            float gradientFactor = (float)y / WINDOW_HEIGHT;
+            Uint8 r = 5 + (int)(10 * (1.0 - gradientFactor));
+            Uint8 g = 0 + (int)(5 * (1.0 - gradientFactor));
+            Uint8 b = 20 + (int)(40 * (1.0 - gradientFactor));
+
+            SDL_SetRenderDrawColor(renderer, r, g, b, 255);
+            SDL_RenderDrawLine(renderer, 0, y, WINDOW_WIDTH, y);
+        }
+
+        // Draw distant stars - more of them for a rich space background
+        srand(background_seed);
+        for (int i = 0; i < 500; i++)
+        {
+            int x = rand() % WINDOW_WIDTH;
+            int y = rand() % WINDOW_HEIGHT;
+            int brightness = 150 + rand() % 106;  // 150-255
+            int size = rand() % 100 > 95 ? 2 : 1; // Mostly small stars, some larger
+
+            // Random star colors - mostly white, but some colored stars
+            Uint8 r = brightness;
+            Uint8 g = brightness;
+            Uint8 b = brightness;
+
+            // Add some color variation to stars
+            int color_type = rand() % 20;
+            if (color_type == 0)
+            { // Reddish
+                g = g * 0.7;
+                b = b * 0.7;
+            }
+            else if (color_type == 1)
+            { // Bluish
+                r = r * 0.7;
+                g = g * 0.8;
+            }
+            else if (color_type == 2)
+            { // Yellowish
+                b = b * 0.7;
+            }
+
+            SDL_SetRenderDrawColor(renderer, r, g, b, 255);
+            SDL_Rect star = {x, y, size, size};
+            SDL_RenderFillRect(renderer, &star);
+
+            // Add occasional twinkle effect (brighter center)
+            if (rand() % 10 == 0)
+            {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
+                SDL_Rect twinkle = {x, y, 1, 1};
+                SDL_RenderFillRect(renderer, &twinkle);
+            }
+        }
+
+        // Reset render target
+        SDL_SetRenderTarget(renderer, NULL);
+    }
+}
+
+// Create the splat accumulation texture, starting as a copy of the background
+void initSplats()
+{
+    if (background_texture == NULL)
+    {
+        return;
+    }
+
+    splat_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                      WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (splat_texture == NULL)
+    {
+        printf("Splat texture could not be created! SDL Error: %s\n", SDL_GetError());
+        return;
+    }
+
+    SDL_SetRenderTarget(renderer, splat_texture);
+    SDL_RenderCopy(renderer, background_texture, NULL, NULL);
+    SDL_SetRenderTarget(renderer, NULL);
+
+    // Fade passes blend the background back over the splats
+    SDL_SetTextureBlendMode(background_texture, SDL_BLENDMODE_BLEND);
+}
+
+// Queue a juice splat to be drawn into the accumulation texture
+void queueSplat(float x, float y, ObjectType type)
+{
+    if (num_pending_splats < MAX_PENDING_SPLATS)
+    {
+        pending_splats[num_pending_splats++] = (Splat){x, y, type};
+    }
+}
+
+// Rasterise pending splats into the accumulation texture and fade old ones
+// Each splat is drawn exactly once; fading blends a little of the clean
+// background back over the texture every SPLAT_FADE_INTERVAL frames. Either
+// way renderGame() copies a single texture per frame.
+void updateSplats()
+{
+    static int frame = 0;
+    frame++;
+
+    bool fade = splat_fade_passes > 0 && frame % SPLAT_FADE_INTERVAL == 0;
+    if (splat_texture == NULL || (num_pending_splats == 0 && !fade))
+    {
+        num_pending_splats = 0;
+        return;
+    }
+
+    SDL_SetRenderTarget(renderer, splat_texture);
+
+    if (fade)
+    {
+        SDL_SetTextureAlphaMod(background_texture, SPLAT_FADE_ALPHA);
+        SDL_RenderCopy(renderer, background_texture, NULL, NULL);
+        SDL_SetTextureAlphaMod(background_texture, 255);
+        splat_fade_passes--;
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    for (int i = 0; i < num_pending_splats; i++)
+    {
+        Splat *splat = &pending_splats[i];
+        Uint8 r, g, b;
+        switch (splat->type)
+        {
+        case APPLE:
+            r = 200, g = 20, b = 30;
+            break;
+        case BANANA:
+            r = 250, g = 230, b = 130;
+            break;
+        case ORANGE:
+            r = 255, g = 140, b = 0;
+            break;
+        default:
+            r = 30, g = 30, b = 30; // Scorch mark
+            break;
+        }
+
+        // Central blob plus a ring of droplets (filledCircleRGBA draws up-left of x, y by one radius)
+        int blob = 14 + visualRand() % 6;
+        filledCircleRGBA(renderer, splat->x + blob, splat->y + blob, blob, r, g, b, SPLAT_ALPHA);
+        for (int d = 0; d < 8; d++)
+        {
+            float angle = 2.0f * M_PI * d / 8 + (visualRand() % 100) / 100.0f;
+            float distance = blob + 4 + visualRand() % 22;
+            int size = 2 + visualRand() % 5;
+            filledCircleRGBA(renderer,
+                             splat->x + cos(angle) * distance + size,
+                             splat->y + sin(angle) * distance + size,
+                             size, r, g, b, SPLAT_ALPHA);
+        }
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    if (num_pending_splats > 0)
+    {
+        splat_fade_passes = SPLAT_FADE_PASSES;
+        num_pending_splats = 0;
+    }
+
+    SDL_SetRenderTarget(renderer, NULL);
+}
+
+// Function to initialize the game
+int initGame(void)
+{
+    // Initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+    {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    // Create window
+    window = SDL_CreateWindow("Ninja Fruit",
+                              SDL_WINDOWPOS_UNDEFINED,
+                              SDL_WINDOWPOS_UNDEFINED,
+                              WINDOW_WIDTH, WINDOW_HEIGHT,
+                              SDL_WINDOW_SHOWN);
+    if (window == NULL)
+    {
+        printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    // Create renderer, synchronised to the display unless --no-vsync
+    Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
+    if (frame_pacer.vsync_requested)
+    {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    renderer = SDL_CreateRenderer(window, -1, renderer_flags);
+    if (renderer == NULL)
+    {
+        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+        return 0;
+    }
+    initFramePacer();
+
+    // Initialize SDL_mixer
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    {
+        printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
+        // Continue without sound
+    }
+
+    // Load sound effects
+    sliceSound = Mix_LoadWAV("assets/sounds/slice.wav");
+    bombSound = Mix_LoadWAV("assets/sounds/bomb.wav");
+    backgroundMusic = Mix_LoadMUS("assets/sounds/background.wav");
+
+    if (sliceSound == NULL || bombSound == NULL || backgroundMusic == NULL)
+    {
+        printf("Warning: Could not load sounds! SDL_mixer Error: %s\n", Mix_GetError());
+        // Continue without sound
+    }
+
+    // Draw the starfield background (the seed is kept so replays can redraw it)
+    background_seed = single_thread.enabled ? single_thread.seed : time(NULL);
+    createBackground();
+    initSplats();
+
+    // Prepare the alternative render paths and pick the fastest one here
+    initRenderPaths();
+    calibrateRenderPath();
+
+    // Initialize mutex
+    pthread_mutex_init(&game_mutex, NULL);
+
+    // Initialize game objects
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        gameObjects[i].active = 0;
+    }
+
+    // Set up spawn pipe
+    if (pipe(spawn_pipe) != 0)
+    {
+        printf("Failed to create pipe\n");
+        return 0;
+    }
+
+    // Initialize game variables
+    score = 0;
+    health = 3;
+    game_time = 0;
+    start_time = simNowMs();
+
+    // Play background music
+    Mix_PlayMusic(backgroundMusic, -1);
+
+    // Initialize deadlock detection system; main() starts its thread
+    initDeadlockDetector();
+
+    // Load scores from file
+    loadScores();
+
+    return 1; // Success
+}
+
+// Spawn objects thread function
+void *spawnObjects(void *arg)
+{
+    // Avoid unused parameter warning
+    (void)arg;
+    nameThread("ninja-spawner");
+    lowJitterThread(1);
+    TRACE_THREAD_NAME("spawnObjects");
+
+    // Initialize random seed
+    srand(time(NULL));
+
+    SpawnerState spawner = {0}; // Spawn pattern state, carried between ticks
+
+    HwSample tick_start, tick_end;
+    if (hw_profiling)
+    {
+        hwCountersOpen(&hw_spawner_group);
+    }
+
+    while (isRunning())
+    {
+        TRACE_BEGIN("spawnTick");
+        if (hw_profiling)
+        {
+            hwCountersRead(&hw_spawner_group, &tick_start);
+        }
+
+        // Lock mutex before modifying shared data
+        lockGameMutex();
+
+        spawnTick(&spawner, SDL_GetTicks() / 1000);
+
+        // Unlock mutex
+        unlockGameMutex();
+        if (hw_profiling)
+        {
+            hwCountersRead(&hw_spawner_group, &tick_end);
+            hwCountersAccumulate(&hw_spawner_totals, &tick_start, &tick_end);
+        }
+        TRACE_END("spawnTick");
+
+        // Sleep to control spawn rate (increased to slow down spawn rate)
+        usleep(100000); // 100ms instead of 40ms
+    }
+
+    if (hw_profiling)
+    {
+        hwCountersClose(&hw_spawner_group);
+    }
+    return NULL;
+}
+
+// One spawner step: maybe change pattern, then spawn if the cooldown allows
+// current_time is in seconds. Caller holds game_mutex for gameObjects.
+void spawnTick(SpawnerState *sp, int current_time)
+{
+    // Decrease spawn cooldown
+    if (sp->cooldown > 0)
+    {
+        sp->cooldown--;
+    }
+
+    // Change spawn mode occasionally
+    sp->timer++;
+    if (sp->timer > 200)
+    { // About every 10 seconds
+        sp->timer = 0;
+        int prev_mode = sp->mode;
+        sp->mode = rand() % 4; // Select a random spawn pattern
+        printf("Spawn mode changed to: %d\n", sp->mode);
+
+        // If we're changing modes and there are few active fruits, force a spawn in the new mode
+        if (prev_mode != sp->mode)
+        {
+            // Count active fruits
+            int active_count = 0;
+            for (int i = 0; i < MAX_FRUITS; i++)
+            {
+                if (gameObjects[i].active)
+                {
+                    active_count++;
+                }
+            }
+
+            // If we have less than 3 active fruits, force an immediate spawn
+            if (active_count < 3)
+            {
+                sp->cooldown = 0;        // Reset cooldown to allow immediate spawn
+                sp->last_spawn_time = 0; // Reset last spawn time to force spawn
+            }
+        }
+    }
+
+    // Count active fruits
+    int active_count = 0;
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        if (gameObjects[i].active)
+        {
+            active_count++;
+        }
+    }
+
+    // Check if we need an emergency spawn - if no active fruits or it's been too long
+    bool need_emergency_spawn = (active_count == 0 || (current_time - sp->last_spawn_time > 2));
+
+    // How much the spawn governor lets through; emergency spawns ignore it
+    int density = __atomic_load_n(&spawn_governor.density, __ATOMIC_RELAXED);
+    int max_objects = __atomic_load_n(&spawn_governor.max_objects, __ATOMIC_RELAXED);
+
+    // Regular fruit spawning when cooldown is over
+    if (sp->cooldown <= 0 || need_emergency_spawn)
+    {
+        // Only spawn if we're below the limit
+        if (active_count < max_objects) // Leave room for clusters
+        {
+            bool spawned_something = false;
+
+            if (sp->mode == 0) // Regular spawning
+            {
+                // Find an inactive object slot
+                for (int i = 0; i < MAX_FRUITS; i++)
+                {
+                    if (!gameObjects[i].active)
+                    {
+                        // Random chance to spawn - reduced spawn rate
+                        if (need_emergency_spawn || spawnChance(15, density)) // Was 20 (more frequent now)
+                        {
+                            spawnFruit(i);
+                            sp->cooldown = 2; // Reduced cooldown (was 3)
+                            spawned_something = true;
+                            sp->last_spawn_time = current_time;
+                            break;
+                        }
+                    }
+                }
+            }
+            else if (sp->mode == 1 && active_count < max_objects - 2) // Cluster spawning
+            {
+                // Spawn a cluster of 3-5 fruits close together - less frequently
+                if (need_emergency_spawn || spawnChance(30, density)) // Was 40 (more frequent now)
+                {
+                    int cluster_size = formationSize(3 + rand() % 3, density, max_objects - active_count); // 3-5 fruits
+                    int base_x = 100 + rand() % (WINDOW_WIDTH - 200);
+                    float base_vx = -3.0f + (rand() % 60) / 10.0f;
+                    float base_vy = 2.0f + (rand() % 30) / 10.0f;
+
+                    int spawned = 0;
+                    for (int i = 0; i < MAX_FRUITS && spawned < cluster_size; i++)
+                    {
+                        if (!gameObjects[i].active)
+                        {
+                            spawnFruitAt(i,
+                                         base_x + (rand() % 120 - 60),
+                                         -(rand() % 20),
+                                         base_vx + ((rand() % 20 - 10) / 10.0f),
+                                         base_vy + ((rand() % 20) / 10.0f));
+                            spawned++;
+                        }
+                    }
+                    sp->cooldown = 25; // Reduced cooldown (was 40)
+                    spawned_something = true;
+                    sp->last_spawn_time = current_time;
+                }
+            }
+            else if (sp->mode == 2) // Line formation
+            {
+                // Spawn fruits in a horizontal line for slicing swipes - less frequently
+                if (need_emergency_spawn || spawnChance(35, density)) // Was 50 (more frequent now)
+                {
+                    int line_count = formationSize(4 + rand() % 3, density, max_objects - active_count); // 4-6 fruits
+                    int spacing = FRUIT_SIZE + 10;
+                    int start_x = (WINDOW_WIDTH - line_count * spacing) / 2 + rand() % 100 - 50;
+                    int y_pos = -30;
+                    float shared_vx = -1.0f + (rand() % 20) / 10.0f;
+                    float shared_vy = 2.0f + (rand() % 20) / 10.0f;
+
+                    int spawned = 0;
+                    for (int i = 0; i < MAX_FRUITS && spawned < line_count; i++)
+                    {
+                        if (!gameObjects[i].active)
+                        {
+                            spawnFruitAt(i,
+                                         start_x + spacing * spawned,
+                                         y_pos + (rand() % 20 - 10),
+                                         shared_vx,
+                                         shared_vy);
+                            spawned++;
+                        }
+                    }
+                    sp->cooldown = 30; // Reduced cooldown (was 50)
+                    spawned_something = true;
+                    sp->last_spawn_time = current_time;
+                }
+            }
+            else if (sp->mode == 3) // Arc formation
+            {
+                // Spawn fruits in an arc pattern - less frequently
+                if (need_emergency_spawn || spawnChance(60, density)) // Was 100, now 60 (more frequent)
+                {
+                    int arc_count = formationSize(5 + rand() % 3, density, max_objects - active_count); // 5-7 fruits
+                    float arc_radius = 100.0f + rand() % 50;
+                    float arc_center_x = WINDOW_WIDTH / 2 + rand() % 200 - 100;
+                    float arc_start = -M_PI / 4 - (rand() % 20) / 100.0f;
+                    float arc_end = M_PI / 4 + (rand() % 20) / 100.0f;
+                    float arc_step = arc_count > 1 ? (arc_end - arc_start) / (arc_count - 1) : 0.0f;
+
+                    float shared_vy = 3.0f + (rand() % 20) / 10.0f;
+
+                    int spawned = 0;
+                    for (int i = 0; i < MAX_FRUITS && spawned < arc_count; i++)
+                    {
+                        if (!gameObjects[i].active)
+                        {
+                            float angle = arc_start + arc_step * spawned;
+                            float x_pos = arc_center_x + cos(angle) * arc_radius;
+                            float y_pos = -30;
+                            float vx = sin(angle) * 2.0f;
+
+                            spawnFruitAt(i, x_pos, y_pos, vx, shared_vy);
+                            spawned++;
+                        }
+                    }
+                    sp->cooldown = 60; // Reduced cooldown (was 110)
+                    spawned_something = true;
+                    sp->last_spawn_time = current_time;
+                }
+            }
+
+            // Emergency spawn if nothing was spawned and we need to
+            if (need_emergency_spawn && !spawned_something && active_count == 0)
+            {
+                // Guaranteed spawn at least one fruit
+                for (int i = 0; i < MAX_FRUITS; i++)
+                {
+                    if (!gameObjects[i].active)
+                    {
+                        spawnFruit(i);
+                        sp->last_spawn_time = current_time;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Helper function to spawn a fruit with default parameters
+void spawnFruit(int index)
+{
+    gameObjects[index].active = 1;
+    gameObjects[index].x = rand() % (WINDOW_WIDTH - FRUIT_SIZE);
+    gameObjects[index].y = 0; // Drop from the top of the screen
+
+    // Random horizontal velocity component with increased speed
+    gameObjects[index].vx = (-3.0f + (rand() % 60) / 10.0f) * 1.5f; // 50% faster (was 1.3f)
+    gameObjects[index].vy = (2.0f + (rand() % 30) / 10.0f) * 1.5f;  // 50% faster (was 1.3f)
+
+    gameObjects[index].sliced = 0;
+    gameObjects[index].rotation = 0.0f;
+    gameObjects[index].rotSpeed = (0.05f + ((float)rand() / RAND_MAX) * 0.1f) * 1.5f; // Faster rotation (was 1.2f)
+    if (rand() % 2)
+        gameObjects[index].rotSpeed *= -1; // Random direction
+
+    // Determine if it's a bomb or fruit
+    if (rand() % BOMB_CHANCE == 0)
+    {
+        gameObjects[index].type = BOMB;
+    }
+    else
+    {
+        gameObjects[index].type = rand() % FRUIT_TYPES;
+    }
+
+    // Initialize slice pieces (will be used when sliced)
+    for (int j = 0; j < SLICE_PIECES; j++)
+    {
+        gameObjects[index].pieces[j].timeLeft = 0;
+    }
+
+    NINJA_PROBE2(spawn, index, (int)gameObjects[index].type);
+}
+
+// Helper function to spawn a fruit at specific position with specific velocity
+void spawnFruitAt(int index, float x, float y, float vx, float vy)
+{
+    gameObjects[index].active = 1;
+    gameObjects[index].x = x;
+    gameObjects[index].y = y;
+
+    // Apply speed multiplier
+    gameObjects[index].vx = vx * 1.5f; // 50% faster (was 1.3f)
+    gameObjects[index].vy = vy * 1.5f; // 50% faster (was 1.3f)
+
+    gameObjects[index].sliced = 0;
+    gameObjects[index].rotation = 0.0f;
+    gameObjects[index].rotSpeed = (0.05f + ((float)rand() / RAND_MAX) * 0.1f) * 1.5f; // Faster rotation (was 1.2f)
+    if (rand() % 2)
+        gameObjects[index].rotSpeed *= -1; // Random direction
+
+    // Determine if it's a bomb or fruit (less bombs in formations)
+    if (rand() % (BOMB_CHANCE * 2) == 0) // Half as many bombs in formations
+    {
+        gameObjects[index].type = BOMB;
+    }
+    else
+    {
+        gameObjects[index].type = rand() % FRUIT_TYPES;
+    }
+
+    // Initialize slice pieces (will be used when sliced)
+    for (int j = 0; j < SLICE_PIECES; j++)
+    {
+        gameObjects[index].pieces[j].timeLeft = 0;
+    }
+
+    NINJA_PROBE2(spawn, index, (int)gameObjects[index].type);
+}
+
+// Function to detect line segment intersection with circle
+// Used to detect if the slice path intersects a fruit
+int lineCircleIntersect(float line_x1, float line_y1, float line_x2, float line_y2, float circle_x, float circle_y, float radius)
+{
+    // Vector from line start to circle center
+    float dx = circle_x - line_x1;
+    float dy = circle_y - line_y1;
+
+    // Vector of the line
+    float line_dx = line_x2 - line_x1;
+    float line_dy = line_y2 - line_y1;
+
+    // Length squared of the line segment
+    float line_len_sq = line_dx * line_dx + line_dy * line_dy;
+
+    // Exit early if line has zero length
+    if (line_len_sq == 0)
+    {
+        return dx * dx + dy * dy <= radius * radius;
+    }
+
+    // Calculate projection of circle center onto line
+    float t = (dx * line_dx + dy * line_dy) / line_len_sq;
+
+    // Clamp t to [0,1] for line segment
+    if (t < 0)
+        t = 0;
+    if (t > 1)
+        t = 1;
+
+    // Find closest point on line segment to circle center
+    float closest_x = line_x1 + t * line_dx;
+    float closest_y = line_y1 + t * line_dy;
+
+    // Check if this point is within the circle
+    float dist_x = closest_x - circle_x;
+    float dist_y = closest_y - circle_y;
+    float dist_sq = dist_x * dist_x + dist_y * dist_y;
+
+    return dist_sq <= radius * radius;
+}
+
+// Work out an object's hit shapes for the blade
+// Both slice passes test against these: the line pass uses the line circles,
+// the sampled pass uses the boxes and circles that checkCollision() tests.
+// The debug overlay draws the same shapes.
+void computeHitShape(const GameObject *obj, HitShape *shape)
+{
+    memset(shape, 0, sizeof(*shape));
+
+    // Get center coordinates and boundaries
+    float center_x = obj->x + FRUIT_SIZE / 2;
+    float center_y = obj->y + FRUIT_SIZE / 2;
+    shape->center_x = center_x;
+    shape->center_y = center_y;
+
+    // The banana's curve means we need to offset its shapes based on rotation
+    if (obj->type == BANANA)
+    {
+        shape->offset_x = cos(obj->rotation) * FRUIT_SIZE * 0.2f;
+        shape->offset_y = sin(obj->rotation) * FRUIT_SIZE * 0.1f;
+
+        // Use a wider but shorter box for banana due to its curved shape
+        shape->has_banana_box = 1;
+        shape->banana_w = FRUIT_SIZE * 1.6f;
+        shape->banana_h = FRUIT_SIZE * 0.8f;
+        shape->banana_left = center_x - shape->banana_w / 2 + shape->offset_x;
+        shape->banana_top = center_y - shape->banana_h / 2 + shape->offset_y;
+    }
+    // Oranges are more spherical, so they get a more accurate circle
+    else if (obj->type == ORANGE)
+    {
+        shape->orange_radius = FRUIT_SIZE * 0.55f;
+    }
+
+    // Radius for the line pass - generous, and larger for bananas
+    if (obj->type == BANANA)
+        shape->line_radius = FRUIT_SIZE * 0.8f;
+    else if (obj->type == ORANGE)
+        shape->line_radius = FRUIT_SIZE * 0.55f; // Match exactly with orangeRadius in rendering
+    else
+        shape->line_radius = FRUIT_SIZE * 0.7f;
+
+    // Box collision - using more generous box for banana and orange
+    float box_scale = (obj->type == BANANA || obj->type == ORANGE) ? 1.3f : 1.2f;
+    shape->box_left = obj->x - (FRUIT_SIZE * (box_scale - 1.0f) / 2);
+    shape->box_top = obj->y - (FRUIT_SIZE * (box_scale - 1.0f) / 2);
+    shape->box_size = FRUIT_SIZE * box_scale;
+
+    // Very generous hit radius - almost the entire fruit area
+    switch (obj->type)
+    {
+    case APPLE:
+        shape->radius = FRUIT_SIZE * 0.6f;
+        break;
+    case ORANGE:
+        shape->radius = FRUIT_SIZE * 0.55f;
+        break;
+    case BANANA:
+        shape->radius = FRUIT_SIZE * 0.75f;
+        break;
+    case BOMB:
+        shape->radius = FRUIT_SIZE * 0.5f;
+        break;
+    default:
+        shape->radius = FRUIT_SIZE * 0.6f;
+    }
+
+    // Fast-moving fruit also get a bigger circle slightly ahead of them, since
+    // they may have moved between frames
+    float velocity_magnitude = sqrt(obj->vx * obj->vx + obj->vy * obj->vy);
+    if (velocity_magnitude > 5.0f)
+    {
+        float speed_bonus = (obj->type == BANANA || obj->type == ORANGE) ? 0.25f : 0.2f;
+        shape->has_lead = 1;
+        shape->lead_radius = shape->radius + velocity_magnitude * speed_bonus;
+        shape->lead_x = center_x + obj->vx * 0.15f;
+        shape->lead_y = center_y + obj->vy * 0.15f;
+    }
+
+    // Broadphase bound: the farthest any of the shapes above reaches from the
+    // center, plus a margin for the blade samples being rounded to pixels
+    float reach = shape->line_radius + hypotf(shape->offset_x, shape->offset_y);
+    reach = fmaxf(reach, shape->box_size / 2 * (float)M_SQRT2);
+    reach = fmaxf(reach, shape->radius);
+    if (shape->has_banana_box)
+    {
+        reach = fmaxf(reach, hypotf(fabsf(shape->offset_x) + shape->banana_w / 2,
+                                    fabsf(shape->offset_y) + shape->banana_h / 2));
+    }
+    if (shape->has_lead)
+    {
+        reach = fmaxf(reach, hypotf(shape->lead_x - center_x, shape->lead_y - center_y) + shape->lead_radius);
+    }
+    shape->broadphase_radius = reach + BROADPHASE_MARGIN;
+}
+
+// Test a blade sample against an object's hit shapes (the sampled pass)
+int hitShapeContains(const HitShape *shape, float slice_x, float slice_y)
+{
+    // Check if the slice point is within the banana's elongated box
+    if (shape->has_banana_box &&
+        slice_x >= shape->banana_left && slice_x <= shape->banana_left + shape->banana_w &&
+        slice_y >= shape->banana_top && slice_y <= shape->banana_top + shape->banana_h)
+    {
+        return 1;
+    }
+
+    // Distance from slice point to the center
+    float dx = slice_x - shape->center_x;
+    float dy = slice_y - shape->center_y;
+    float distance_squared = dx * dx + dy * dy;
+
+    if (shape->orange_radius > 0 && distance_squared < shape->orange_radius * shape->orange_radius)
+    {
+        return 1;
+    }
+
+    // Box collision check
+    if (slice_x >= shape->box_left && slice_x <= shape->box_left + shape->box_size &&
+        slice_y >= shape->box_top && slice_y <= shape->box_top + shape->box_size)
+    {
+        return 1;
+    }
+
+    // If box collision failed, try circle collision as a backup
+    // This helps with curved shapes and other fruits
+    if (distance_squared < shape->radius * shape->radius)
+    {
+        return 1;
+    }
+
+    // Also check slightly ahead of a fast fruit's position
+    if (shape->has_lead)
+    {
+        float vel_dx = slice_x - shape->lead_x;
+        float vel_dy = slice_y - shape->lead_y;
+        if (vel_dx * vel_dx + vel_dy * vel_dy < shape->lead_radius * shape->lead_radius)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Test the whole blade segment against an object's line circles (the line pass)
+int hitShapeLineHit(const HitShape *shape, float x1, float y1, float x2, float y2)
+{
+    // Bananas check both the center and a point offset along their curve
+    if (shape->has_banana_box &&
+        lineCircleIntersect(x1, y1, x2, y2, shape->center_x + shape->offset_x, shape->center_y + shape->offset_y,
+                            shape->line_radius))
+    {
+        return 1;
+    }
+    return lineCircleIntersect(x1, y1, x2, y2, shape->center_x, shape->center_y, shape->line_radius);
+}
+
+// Squared distance from a point to a line segment
+float segmentDistanceSq(float x1, float y1, float x2, float y2, float px, float py)
+{
+    float line_dx = x2 - x1;
+    float line_dy = y2 - y1;
+    float line_len_sq = line_dx * line_dx + line_dy * line_dy;
+    float t = line_len_sq > 0 ? ((px - x1) * line_dx + (py - y1) * line_dy) / line_len_sq : 0.0f;
+    t = fminf(fmaxf(t, 0.0f), 1.0f);
+
+    float dx = x1 + t * line_dx - px;
+    float dy = y1 + t * line_dy - py;
+    return dx * dx + dy * dy;
+}
+
+// Improved collision detection function to account for velocity
+int checkCollision(float slice_x, float slice_y, GameObject *obj)
+{
+    HitShape shape;
+    computeHitShape(obj, &shape);
+    return hitShapeContains(&shape, slice_x, slice_y);
+}
+
+// Slice an object hit by the blade
+// Splits it into two pieces flying apart across the slice direction, leaves
+// a juice splat behind and applies the score or bomb damage. Caller holds
+// game_mutex.
+void applySlice(int i)
+{
+    GameObject *obj = &gameObjects[i];
+    obj->sliced = 1;
+
+    // Initialize slice pieces
+    float sliceAngle = atan2(mouse_y - prev_mouse_y, mouse_x - prev_mouse_x);
+    float center_x = obj->x + FRUIT_SIZE / 2;
+    float center_y = obj->y + FRUIT_SIZE / 2;
+
+    // Create two pieces moving in different directions
+    for (int j = 0; j < SLICE_PIECES; j++)
+    {
+        obj->pieces[j].x = center_x;
+        obj->pieces[j].y = center_y;
+
+        // Different velocities for each piece
+        float pieceAngle = sliceAngle + (j == 0 ? M_PI / 2 : -M_PI / 2);
+        float speed = (2.0f + (rand() % 20) / 10.0f) * 1.5f; // 50% faster
+
+        obj->pieces[j].vx = cos(pieceAngle) * speed;
+        obj->pieces[j].vy = sin(pieceAngle) * speed + obj->vy / 2;
+        obj->pieces[j].rotation = obj->rotation;
+        obj->pieces[j].rotSpeed = obj->rotSpeed * 2.0f * (j == 0 ? 1 : -1);
+        obj->pieces[j].timeLeft = SLICE_DURATION;
+    }
+
+    queueSplat(center_x, center_y, obj->type);
+
+    if (obj->type == BOMB)
+    {
+        // Play bomb sound
+        TRACE_BEGIN("Mix_PlayChannel");
+        Mix_PlayChannel(-1, bombSound, 0);
+        TRACE_END("Mix_PlayChannel");
+        // Reduce health when bomb is sliced
+        health--;
+        NINJA_PROBE2(bomb_hit, i, health);
+        if (health <= 0)
+        {
+            printf("Game Over! Final score: %d\n", score);
+            health = 0; // Ensure health doesn't go below 0
+            game_state = STATE_GAME_OVER;
+            NINJA_PROBE1(game_over, score);
+            addScore(score);
+        }
+        // No score penalty for bombs
+        printf("Bomb sliced! Health: %d\n", health);
+    }
+    else
+    {
+        // Play slice sound
+        TRACE_BEGIN("Mix_PlayChannel");
+        Mix_PlayChannel(-1, sliceSound, 0);
+        TRACE_END("Mix_PlayChannel");
+        score += 1;
+        slices_total++;
+        NINJA_PROBE2(slice, i, (int)obj->type);
+        printf("%s sliced! Score: %d\n",
+               obj->type == BANANA ? "Banana" : obj->type == ORANGE ? "Orange" : "Fruit", score);
+    }
+}
+
+// Slice everything the blade crossed moving from (x1, y1) to (x2, y2)
+// A broadphase first drops objects whose hit shapes can't reach the blade
+// segment at all. The candidates then get the line pass against the whole
+// segment and the sampled pass at SLICE_SAMPLES + 1 points along it, in the
+// same order as before the broadphase existed. With the collision overlay on,
+// culled objects are tested too, to catch the broadphase ever missing a hit.
+// Caller holds game_mutex.
+void slicePass(float x1, float y1, float x2, float y2)
+{
+    CollisionStats *stats = &perf_stats.collisions;
+    static HitShape shapes[MAX_FRUITS];
+    int candidates[MAX_FRUITS];
+    int num_candidates = 0;
+    int hit[MAX_FRUITS] = {0};
+
+    stats->passes++;
+    collision_debug.x1 = x1;
+    collision_debug.y1 = y1;
+    collision_debug.x2 = x2;
+    collision_debug.y2 = y2;
+    collision_debug.has_pass = 1;
+
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        collision_debug.candidate[i] = 0;
+        if (!gameObjects[i].active || gameObjects[i].sliced)
+        {
+            continue;
+        }
+
+        HitShape *shape = &shapes[i];
+        computeHitShape(&gameObjects[i], shape);
+        float bound = shape->broadphase_radius;
+        if (segmentDistanceSq(x1, y1, x2, y2, shape->center_x, shape->center_y) > bound * bound)
+        {
+            stats->culled++;
+            stats->tests_avoided += (shape->has_banana_box ? 2 : 1) + SLICE_SAMPLES + 1;
+
+            if (collision_debug.visible)
+            {
+                int missed = hitShapeLineHit(shape, x1, y1, x2, y2);
+                for (int t = 0; t <= SLICE_SAMPLES && !missed; t++)
+                {
+                    float lerp = (float)t / SLICE_SAMPLES;
+                    missed = hitShapeContains(shape, (int)(x1 + (x2 - x1) * lerp), (int)(y1 + (y2 - y1) * lerp));
+                }
+                if (missed)
+                {
+                    stats->cull_errors++;
+                    printf("Broadphase culled object %d that the blade hit\n", i);
+                }
+            }
+            continue;
+        }
+
+        candidates[num_candidates++] = i;
+        collision_debug.candidate[i] = 1;
+    }
+    stats->candidates += num_candidates;
+
+    // First check if the line formed by the blade intersects any object
+    for (int c = 0; c < num_candidates; c++)
+    {
+        int i = candidates[c];
+        stats->tests += shapes[i].has_banana_box ? 2 : 1;
+        if (hitShapeLineHit(&shapes[i], x1, y1, x2, y2))
+        {
+            hit[i] = 1;
+            applySlice(i);
+        }
+    }
+
+    // Also check slice along multiple points on the path for very precise slicing
+    for (int t = 0; t <= SLICE_SAMPLES; t++)
+    {
+        float lerp = (float)t / SLICE_SAMPLES;
+        int slice_x = x1 + (x2 - x1) * lerp;
+        int slice_y = y1 + (y2 - y1) * lerp;
+
+        for (int c = 0; c < num_candidates; c++)
+        {
+            int i = candidates[c];
+            if (hit[i])
+            {
+                continue;
+            }
+
+            stats->tests++;
+            if (hitShapeContains(&shapes[i], slice_x, slice_y))
+            {
+                hit[i] = 1;
+                applySlice(i);
+            }
+        }
+    }
+
+    // Tally hits, and candidates the blade came close to without hitting
+    for (int c = 0; c < num_candidates; c++)
+    {
+        int i = candidates[c];
+        if (hit[i])
+        {
+            stats->hits++;
+            continue;
+        }
+
+        float near = shapes[i].line_radius + NEAR_MISS_PX;
+        if (segmentDistanceSq(x1, y1, x2, y2, shapes[i].center_x, shapes[i].center_y) <= near * near)
+        {
+            stats->near_misses++;
+        }
+    }
+}
+
+// Draw an unfilled circle
+void drawCircleOutline(float x, float y, float radius)
+{
+    SDL_Point points[CIRCLE_SEGMENTS + 1];
+    for (int s = 0; s <= CIRCLE_SEGMENTS; s++)
+    {
+        float angle = s * 2.0f * M_PI / CIRCLE_SEGMENTS;
+        points[s].x = x + cosf(angle) * radius;
+        points[s].y = y + sinf(angle) * radius;
+    }
+    SDL_RenderDrawLines(renderer, points, CIRCLE_SEGMENTS + 1);
+}
+
+// Show or hide the collision overlay; showing it starts the cull check afresh
+void toggleCollisionDebug()
+{
+    collision_debug.visible = !collision_debug.visible;
+    perf_stats.collision_totals.cull_errors = 0;
+}
+
+// Draw every live object's hit shapes, the last blade segment and its samples,
+// and the collision counters
+void drawCollisionDebug()
+{
+    lockGameMutex();
+    drawScopePush(SCOPE_PERF);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        GameObject *obj = &gameObjects[i];
+        if (!obj->active || obj->sliced)
+        {
+            continue;
+        }
+
+        HitShape shape;
+        computeHitShape(obj, &shape);
+
+        // Broadphase bound, brighter if it was a candidate in the last pass
+        Uint8 bound_alpha = collision_debug.candidate[i] ? 200 : 70;
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, bound_alpha);
+        drawCircleOutline(shape.center_x, shape.center_y, shape.broadphase_radius);
+
+        // Line pass circles
+        SDL_SetRenderDrawColor(renderer, 255, 220, 0, 200);
+        drawCircleOutline(shape.center_x, shape.center_y, shape.line_radius);
+        if (shape.has_banana_box)
+        {
+            drawCircleOutline(shape.center_x + shape.offset_x, shape.center_y + shape.offset_y, shape.line_radius);
+        }
+
+        // Sampled pass boxes
+        SDL_SetRenderDrawColor(renderer, 0, 255, 120, 200);
+        SDL_Rect box = {shape.box_left, shape.box_top, shape.box_size, shape.box_size};
+        SDL_RenderDrawRect(renderer, &box);
+        if (shape.has_banana_box)
+        {
+            SDL_Rect banana = {shape.banana_left, shape.banana_top, shape.banana_w, shape.banana_h};
+            SDL_RenderDrawRect(renderer, &banana);
+        }
+
+        // Sampled pass circles
+        SDL_SetRenderDrawColor(renderer, 0, 200, 255, 200);
+        drawCircleOutline(shape.center_x, shape.center_y, shape.radius);
+        if (shape.orange_radius > 0)
+        {
+            drawCircleOutline(shape.center_x, shape.center_y, shape.orange_radius);
+        }
+        if (shape.has_lead)
+        {
+            SDL_SetRenderDrawColor(renderer, 255, 80, 255, 200);
+            drawCircleOutline(shape.lead_x, shape.lead_y, shape.lead_radius);
+        }
+    }
+
+    // Last blade segment and the points the sampled pass tested
+    if (collision_debug.has_pass)
+    {
+        float x1 = collision_debug.x1, y1 = collision_debug.y1;
+        float x2 = collision_debug.x2, y2 = collision_debug.y2;
+        SDL_SetRenderDrawColor(renderer, 255, 40, 40, 255);
+        SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
+        for (int t = 0; t <= SLICE_SAMPLES; t++)
+        {
+            float lerp = (float)t / SLICE_SAMPLES;
+            SDL_Rect sample = {(int)(x1 + (x2 - x1) * lerp) - 1, (int)(y1 + (y2 - y1) * lerp) - 1, 3, 3};
+            SDL_RenderFillRect(renderer, &sample);
+        }
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    unlockGameMutex();
+
+    // Counters for the previous frame
+    CollisionStats *last = &perf_stats.last_collisions;
+    char line[64];
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    snprintf(line, sizeof(line), "TESTS %ld HITS %ld NEAR %ld", last->tests, last->hits, last->near_misses);
+    drawDigitalText(renderer, line, 10, 70, 6, 10, 2);
+    snprintf(line, sizeof(line), "CAND %ld CULLED %ld SAVED %ld", last->candidates, last->culled, last->tests_avoided);
+    drawDigitalText(renderer, line, 10, 84, 6, 10, 2);
+    snprintf(line, sizeof(line), "CULL ERRORS %ld", perf_stats.collision_totals.cull_errors);
+    drawDigitalText(renderer, line, 10, 98, 6, 10, 2);
+
+    drawScopePop();
+}
+
+// Print collision counters for the whole run
+void printCollisionStats()
+{
+    CollisionStats *total = &perf_stats.collision_totals;
+    if (total->passes == 0)
+    {
+        return;
+    }
+
+    long avoidable = total->tests + total->tests_avoided;
+    printf("Collisions: %ld slice passes, %ld narrow-phase tests, %ld hits, %ld near misses\n",
+           total->passes, total->tests, total->hits, total->near_misses);
+    printf("Collisions: broadphase culled %ld objects and %ld tests (%.1f%%), %ld cull errors\n",
+           total->culled, total->tests_avoided, avoidable > 0 ? 100.0 * total->tests_avoided / avoidable : 0.0,
+           total->cull_errors);
+}
+
+// Feed one real pointer sample to an alpha-beta filter
+// Samples more than BLADE_RESET_MS apart start a new stroke from rest.
+// Returns how far the sample landed from where the filter expected it.
+float bladeFilterUpdate(BladeFilter *f, float x, float y, Uint32 timestamp)
+{
+    float dt = (float)(timestamp - f->timestamp);
+    if (!f->valid || dt > BLADE_RESET_MS)
+    {
+        f->x = x;
+        f->y = y;
+        f->vx = 0.0f;
+        f->vy = 0.0f;
+        f->timestamp = timestamp;
+        f->valid = 1;
+        return 0.0f;
+    }
+
+    // SDL timestamps are in whole milliseconds; events in the same one are treated as half a millisecond apart
+    float step = dt > 0.0f ? dt : 0.5f;
+    float px = f->x + f->vx * step;
+    float py = f->y + f->vy * step;
+    float rx = x - px;
+    float ry = y - py;
+
+    f->x = px + BLADE_ALPHA * rx;
+    f->y = py + BLADE_ALPHA * ry;
+    f->vx += BLADE_BETA * rx / step;
+    f->vy += BLADE_BETA * ry / step;
+    f->timestamp = timestamp;
+    return sqrtf(rx * rx + ry * ry);
+}
+
+// Where the filter expects the pointer to be at timestamp, at most BLADE_MAX_LEAD_PX past its estimate
+// Returns 0 if the pointer has been still too long to say.
+int bladeFilterPredict(const BladeFilter *f, Uint32 timestamp, float ahead_ms, float *x, float *y)
+{
+    float dt = (float)(timestamp - f->timestamp) + ahead_ms;
+    if (!f->valid || dt > BLADE_RESET_MS)
+    {
+        return 0;
+    }
+
+    float dx = f->vx * dt;
+    float dy = f->vy * dt;
+    float lead = sqrtf(dx * dx + dy * dy);
+    if (lead > BLADE_MAX_LEAD_PX)
+    {
+        dx *= BLADE_MAX_LEAD_PX / lead;
+        dy *= BLADE_MAX_LEAD_PX / lead;
+    }
+    *x = f->x + dx;
+    *y = f->y + dy;
+    return 1;
+}
+
+// A real pointer sample from handleEvents(); any earlier prediction is simply replaced
+void bladePredictorSample(int x, int y, Uint32 timestamp)
+{
+    BladePredictor *bp = &blade_predictor;
+    if (!bp->enabled)
+    {
+        return;
+    }
 
-                // Gradient from yellow to slightly darker yellow
-                int shade = 255 - abs(i) * 3;
-                filledCircleRGBA(renderer, cx, cy, 8, shade, shade, 0, 255);
-            }
+    float error = bladeFilterUpdate(&bp->filter, x, y, timestamp);
+    if (error > 0.0f)
+    {
+        bp->samples++;
+        bp->error_sum += error;
+        bp->error_max = error > bp->error_max ? error : bp->error_max;
+    }
+}
 
-            // Add shadows and highlights
-            for (int i = -18; i <= -5; i++)
-            {
-                float angle = (float)i / 20.0f * 3.14f;
-                float cx = x + cos(angle + rotation) * halfSize * 0.75f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.25f;
-                filledCircleRGBA(renderer, cx, cy, 3, 255, 255, 150, 150);
-            }
+// Extend the blade to where the pointer is now, just before present
+// The trail was drawn from events drained at the top of the frame. Peeking the
+// queue again here (without removing anything, so handleEvents() still does the
+// real slicing next frame) lets the tip follow motion that arrived while the
+// frame was simulated and rendered. With the predictor on, the tip is then
+// carried on to where the pointer should be when the frame is seen. Objects
+// the extension crosses get a provisional highlight; nothing is sliced until
+// real events are handled, so a misprediction never scores.
+void lateLatchBlade()
+{
+    LateLatch *ll = &late_latch;
+    BladePredictor *bp = &blade_predictor;
+    if ((!ll->enabled && !bp->enabled) || game_state != STATE_PLAYING)
+    {
+        return;
+    }
 
-            // Banana ends (darker)
-            for (int i = -20; i <= -18; i++)
-            {
-                float angle = (float)i / 20.0f * 3.14f;
-                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
-                filledCircleRGBA(renderer, cx, cy, 6, 200, 180, 0, 255);
-            }
+    SDL_Event events[LATE_LATCH_EVENTS];
+    int n = 0;
+    if (ll->enabled)
+    {
+        SDL_PumpEvents();
+        n = SDL_PeepEvents(events, LATE_LATCH_EVENTS, SDL_PEEKEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION);
+        n = n > 0 ? n : 0;
+    }
 
-            for (int i = 18; i <= 20; i++)
-            {
-                float angle = (float)i / 20.0f * 3.14f;
-                float cx = x + cos(angle + rotation) * halfSize * 0.8f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
-                filledCircleRGBA(renderer, cx, cy, 6, 200, 180, 0, 255);
-            }
-        }
-        else
+    SDL_Point tip[LATE_LATCH_EVENTS + 2];
+    tip[0] = (SDL_Point){mouse_x, mouse_y};
+    int injected = 0;
+    BladeFilter filter = bp->filter; // Peeked samples refine a copy; handleEvents() feeds the real one
+    for (int i = 0; i < n; i++)
+    {
+        tip[i + 1] = (SDL_Point){events[i].motion.x, events[i].motion.y};
+        bladeFilterUpdate(&filter, events[i].motion.x, events[i].motion.y, events[i].motion.timestamp);
+        if (events[i].motion.which == LATENCY_MOUSE_ID)
         {
-            // Sliced banana with more detailed inside - enhanced appearance
-            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+            latencyEventHandled();
+            injected = 1;
+        }
+    }
+    int points = n + 1;
+    int real_points = points;
 
-            // Separation gap between banana halves
-            float separationX = 16.0f; // Increased from 15 for more visible separation
+    float px, py;
+    if (bp->enabled && mouse_down && bladeFilterPredict(&filter, SDL_GetTicks(), bp->ahead_ms, &px, &py))
+    {
+        tip[points++] = (SDL_Point){(int)px, (int)py};
+        bp->predictions++;
+    }
 
-            // Left half - more curved for better visual slicing
-            for (int i = -10; i <= 0; i++)
-            {
-                float angle = (float)i / 10.0f * 3.14f;
-                float cx = x - separationX + cos(angle + rotation) * halfSize * 0.7f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
-                filledCircleRGBA(renderer, cx, cy, 6, 255, 255, 30, 255);
-            }
+    // Same threshold handleEvents() uses for a slice
+    float dx = tip[points - 1].x - tip[0].x;
+    float dy = tip[points - 1].y - tip[0].y;
+    if (dx * dx + dy * dy <= 25.0f)
+    {
+        if (injected)
+        {
+            drawLatencyPatch();
+        }
+        return;
+    }
+    if (n > 0)
+    {
+        ll->frames_latched++;
+        ll->events_latched += n;
+    }
 
-            // Right half - more curved for better visual slicing
-            for (int i = 0; i <= 10; i++)
-            {
-                float angle = (float)i / 10.0f * 3.14f;
-                float cx = x + separationX + cos(angle + rotation) * halfSize * 0.7f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.3f;
-                filledCircleRGBA(renderer, cx, cy, 6, 255, 255, 30, 255);
-            }
+    drawScopePush(SCOPE_TRAIL);
 
-            // Inside (creamy white) - more visible and contrasting
-            for (int i = -8; i <= 0; i++)
-            {
-                float angle = (float)i / 8.0f * 3.14f;
-                float cx = x - separationX + cos(angle + rotation) * halfSize * 0.5f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.2f;
-                filledCircleRGBA(renderer, cx, cy, 5, 255, 250, 220, 255); // Bigger inside (was 4)
-            }
+    // Tip in the style of the head of the trail: bright core and a softer edge either
+    // side. The predicted part is fainter.
+    SDL_Point edge[LATE_LATCH_EVENTS + 2];
+    for (int part = 0; part < 2; part++)
+    {
+        int first = part == 0 ? 0 : real_points - 1;
+        int count = part == 0 ? real_points : points - real_points + 1;
+        if (count < 2)
+        {
+            continue;
+        }
+        Uint8 alpha = part == 0 ? 255 : 140;
 
-            for (int i = 0; i <= 8; i++)
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, alpha);
+        SDL_RenderDrawLines(renderer, &tip[first], count);
+        for (int side = -1; side <= 1; side += 2)
+        {
+            for (int i = 0; i < count; i++)
             {
-                float angle = (float)i / 8.0f * 3.14f;
-                float cx = x + separationX + cos(angle + rotation) * halfSize * 0.5f;
-                float cy = y + sin(angle + rotation) * halfSize * 0.2f;
-                filledCircleRGBA(renderer, cx, cy, 5, 255, 250, 220, 255); // Bigger inside (was 4)
+                edge[i] = (SDL_Point){tip[first + i].x, tip[first + i].y + side};
             }
+            SDL_SetRenderDrawColor(renderer, 255, 255, 220, alpha / 2);
+            SDL_RenderDrawLines(renderer, edge, count);
+        }
+    }
 
-            // Seeds - darker and more visible
-            SDL_SetRenderDrawColor(renderer, 20, 20, 0, 255); // Darker seeds (was 30, 30, 0)
-            for (int i = -2; i <= 2; i++)
-            {
-                SDL_Rect seed1 = {x - separationX + i * 5, y, 3, 3}; // Bigger seeds
-                SDL_Rect seed2 = {x + separationX + i * 5, y, 3, 3}; // Bigger seeds
-                SDL_RenderFillRect(renderer, &seed1);
-                SDL_RenderFillRect(renderer, &seed2);
-            }
+    // Provisional hits along the extension
+    float hit_x[MAX_FRUITS], hit_y[MAX_FRUITS], hit_r[MAX_FRUITS];
+    int hits = 0;
+    lockGameMutex();
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        if (!gameObjects[i].active || gameObjects[i].sliced)
+        {
+            continue;
+        }
 
-            // Draw slice "cut line" for more obvious slice effect
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 180);
-            for (int i = -2; i <= 2; i++)
+        HitShape shape;
+        computeHitShape(&gameObjects[i], &shape);
+        for (int s = 0; s < points - 1; s++)
+        {
+            float bound = shape.broadphase_radius;
+            if (segmentDistanceSq(tip[s].x, tip[s].y, tip[s + 1].x, tip[s + 1].y, shape.center_x, shape.center_y) <=
+                    bound * bound &&
+                hitShapeLineHit(&shape, tip[s].x, tip[s].y, tip[s + 1].x, tip[s + 1].y))
             {
-                SDL_RenderDrawLine(renderer,
-                                   x - halfSize + 10, y + i,
-                                   x + halfSize - 10, y + i);
+                hit_x[hits] = shape.center_x;
+                hit_y[hits] = shape.center_y;
+                hit_r[hits] = shape.line_radius;
+                hits++;
+                break;
             }
         }
-        break;
-
-    case ORANGE:
-        if (!sliced)
-        {
-            // Orange with texture and gradient - adjusted to match collision radius of FRUIT_SIZE * 0.55f
-            int orangeRadius = (int)(halfSize * 0.85f); // Approximately 55% of FRUIT_SIZE (halfSize is FRUIT_SIZE/2)
+    }
+    unlockGameMutex();
 
-            // Main orange body - more consistent size
-            filledCircleRGBA(renderer, x + halfSize / 2, y + halfSize / 2, orangeRadius, 255, 140, 0, 255);
-            filledCircleRGBA(renderer, x + halfSize / 2, y + halfSize / 2, orangeRadius - 3, 255, 165, 0, 255);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
+    for (int h = 0; h < hits; h++)
+    {
+        drawCircleOutline(hit_x[h], hit_y[h], hit_r[h] + 4);
+    }
+    ll->provisional_hits += hits;
 
-            // Subtle highlight (much smaller than before)
-            filledCircleRGBA(renderer,
-                             x + halfSize / 2 - orangeRadius / 4,
-                             y + halfSize / 2 - orangeRadius / 4,
-                             orangeRadius / 8, 255, 230, 180, 150);
+    drawScopePop();
 
-            // Texture dots
-            SDL_SetRenderDrawColor(renderer, 200, 120, 0, 255);
-            for (int i = 0; i < 20; i++)
-            {
-                // float angle = 2.0f * 3.14f * i / 20.0f + rotation;
-                // float radius = orangeRadius - 5 - (rand() % 5);
-                float cx = x;
-                float cy = y;
-                filledCircleRGBA(renderer, cx, cy, 2, 220, 140, 0, 200);
-            }
+    // An injected latency event picked up here is first shown by this frame
+    if (injected)
+    {
+        drawLatencyPatch();
+    }
+}
 
-            // Stem/leaf detail at top
-            SDL_SetRenderDrawColor(renderer, 50, 100, 0, 255);
-            SDL_Rect stem = {x + halfSize / 2 - 4, y + halfSize / 2 - orangeRadius - 2, 8, 6};
-            SDL_RenderFillRect(renderer, &stem);
+// Handle SDL events
+void handleEvents()
+{
+    SDL_Event e;
 
-            // Small leaf
-            SDL_SetRenderDrawColor(renderer, 0, 130, 0, 255);
-            SDL_Point leaf[3] = {
-                {x + halfSize / 2, y + halfSize / 2 - orangeRadius + 1},
-                {x + halfSize / 2 + 10, y + halfSize / 2 - orangeRadius - 4},
-                {x + halfSize / 2 + 5, y + halfSize / 2 - orangeRadius + 4}};
-            SDL_RenderDrawLines(renderer, leaf, 3);
+    while (SDL_PollEvent(&e))
+    {
+        if (e.type == SDL_QUIT)
+        {
+            stopRunning();
         }
-        else
+        else if (e.type == SDL_MOUSEMOTION)
         {
-            // Sliced orange with detailed segments - enhanced separation
-            float separationX = 18.0f;                  // Increased from 15 for more visible separation
-            int orangeRadius = (int)(halfSize * 0.85f); // Match the unsliced radius
+            // Store previous position before updating current
+            prev_mouse_x = mouse_x;
+            prev_mouse_y = mouse_y;
 
-            // Outer rind - brighter color
-            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 5, 255, 140, 0, 255);
-            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 5, 255, 140, 0, 255);
+            // Update current mouse position
+            mouse_x = e.motion.x;
+            mouse_y = e.motion.y;
 
-            // White pith layer - more contrast
-            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 7, 255, 240, 220, 255); // Whiter
-            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 7, 255, 240, 220, 255); // Whiter
+            if (e.motion.which == LATENCY_MOUSE_ID)
+            {
+                latencyEventHandled();
+            }
+            bladePredictorSample(mouse_x, mouse_y, e.motion.timestamp);
 
-            // Inside pulp - more vibrant
-            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, orangeRadius - 10, 255, 160, 80, 255); // More orange (was 180, 100)
-            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, orangeRadius - 10, 255, 160, 80, 255); // More orange
+            // Only process mouse movement for slicing if we're in the PLAYING state
+            if (game_state == STATE_PLAYING)
+            {
+                // Improve slice detection - check if mouse moved fast enough to count as a slice
+                float mouse_movement = sqrt(pow(mouse_x - prev_mouse_x, 2) + pow(mouse_y - prev_mouse_y, 2));
 
-            // Segment lines with thickness - more visible segments
-            SDL_SetRenderDrawColor(renderer, 255, 220, 180, 255); // Brighter lines
-            for (int i = 0; i < 8; i++)
+                // Only count as a slice if the movement is significant
+                if (mouse_movement > 5)
+                {
+                    lockGameMutex();
+                    slicePass(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y);
+                    unlockGameMutex();
+
+                    // Set mouse_down to true for rendering the slice trail
+                    mouse_down = 1;
+                }
+                else
+                {
+                    // If mouse barely moved, don't show the slice trail
+                    mouse_down = 0;
+                }
+            }
+        }
+        else if (e.type == SDL_MOUSEBUTTONDOWN)
+        {
+            // Game over screen button clicks
+            if (game_state == STATE_GAME_OVER)
             {
-                float angle = 2.0f * M_PI * i / 8.0f;
-                for (int w = -2; w <= 2; w++) // Wider lines (was -1 to 1)
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+
+                // Check if the click is on the "Restart" button
+                SDL_Rect restartButton = {WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 20, 100, 40};
+                if (mouseX >= restartButton.x && mouseX <= restartButton.x + restartButton.w &&
+                    mouseY >= restartButton.y && mouseY <= restartButton.y + restartButton.h)
                 {
-                    SDL_RenderDrawLine(renderer,
-                                       x + halfSize / 2 - separationX, y + halfSize / 2,
-                                       x + halfSize / 2 - separationX + cos(angle + w * 0.05) * (orangeRadius - 10),
-                                       y + halfSize / 2 + sin(angle + w * 0.05) * (orangeRadius - 10));
+                    // Reset the game
+                    resetGame();
+                    return;
+                }
 
-                    SDL_RenderDrawLine(renderer,
-                                       x + halfSize / 2 + separationX, y + halfSize / 2,
-                                       x + halfSize / 2 + separationX + cos(angle + w * 0.05) * (orangeRadius - 10),
-                                       y + halfSize / 2 + sin(angle + w * 0.05) * (orangeRadius - 10));
+                // Check if the click is on the "Leaderboard" button
+                SDL_Rect leaderboardButton = {WINDOW_WIDTH / 2 + 20, WINDOW_HEIGHT / 2 + 20, 100, 40};
+                if (mouseX >= leaderboardButton.x && mouseX <= leaderboardButton.x + leaderboardButton.w &&
+                    mouseY >= leaderboardButton.y && mouseY <= leaderboardButton.y + leaderboardButton.h)
+                {
+                    // Show leaderboard
+                    game_state = STATE_LEADERBOARD;
+                    return;
+                }
+            }
+            // Leaderboard screen back button click
+            else if (game_state == STATE_LEADERBOARD)
+            {
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+
+                // Check if the click is on the "Back" button
+                SDL_Rect backButton = {WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT - 70, 100, 40};
+                if (mouseX >= backButton.x && mouseX <= backButton.x + backButton.w &&
+                    mouseY >= backButton.y && mouseY <= backButton.y + backButton.h)
+                {
+                    // Return to game over screen
+                    game_state = STATE_GAME_OVER;
+                    return;
+                }
+            }
+        }
+        else if (e.type == SDL_KEYDOWN)
+        {
+            if (e.key.keysym.sym == SDLK_ESCAPE)
+            {
+                // In leaderboard state, go back to game over screen
+                if (game_state == STATE_LEADERBOARD)
+                {
+                    game_state = STATE_GAME_OVER;
+                }
+                else
+                {
+                    stopRunning();
                 }
             }
-
-            // Seeds at center - more visible
-            SDL_SetRenderDrawColor(renderer, 255, 240, 200, 255);
-            filledCircleRGBA(renderer, x + halfSize / 2 - separationX, y + halfSize / 2, 6, 255, 240, 200, 255);
-            filledCircleRGBA(renderer, x + halfSize / 2 + separationX, y + halfSize / 2, 6, 255, 240, 200, 255);
-
-            // Individual seeds - more prominent
-            SDL_SetRenderDrawColor(renderer, 200, 160, 50, 255);
-            for (int i = 0; i < 5; i++)
+            else if (e.key.keysym.sym == SDLK_r && game_state != STATE_PLAYING)
             {
-                float angle = 2.0f * M_PI * i / 5.0f;
-                SDL_Rect seed1 = {
-                    x + halfSize / 2 - separationX + cos(angle) * 3 - 1,
-                    y + halfSize / 2 + sin(angle) * 3 - 1,
-                    3, 4}; // Bigger (was 2, 3)
-                SDL_Rect seed2 = {
-                    x + halfSize / 2 + separationX + cos(angle) * 3 - 1,
-                    y + halfSize / 2 + sin(angle) * 3 - 1,
-                    3, 4}; // Bigger
-                SDL_RenderFillRect(renderer, &seed1);
-                SDL_RenderFillRect(renderer, &seed2);
+                // Reset game if not currently playing
+                resetGame();
             }
-
-            // Draw slice "cut line" for more obvious slice effect
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 180);
-            for (int i = -2; i <= 2; i++)
+            else if (e.key.keysym.sym == SDLK_F3)
             {
-                SDL_RenderDrawLine(renderer,
-                                   x, y + halfSize / 2 + i,
-                                   x + FRUIT_SIZE, y + halfSize / 2 + i);
+                // Toggle the performance overlay
+                togglePerfOverlay();
             }
-        }
-        break;
-
-    case BOMB:
-        if (!sliced)
-        {
-            // Black bomb with metallic sheen
-            filledCircleRGBA(renderer, x, y, halfSize - 5, 20, 20, 20, 255);
-
-            // Metallic highlight
-            filledCircleRGBA(renderer, x - halfSize / 4, y - halfSize / 4, halfSize / 3, 40, 40, 40, 200);
-            filledCircleRGBA(renderer, x - halfSize / 3, y - halfSize / 3, halfSize / 6, 70, 70, 70, 200);
-
-            // Fuse
-            SDL_SetRenderDrawColor(renderer, 160, 120, 80, 255);
-            // Wavy fuse
-            for (int i = 0; i < 15; i++)
+            else if (e.key.keysym.sym == SDLK_F5)
             {
-                float wave = sin(i * 0.5) * 3;
-                SDL_Rect fuseBit = {
-                    x - 2 + wave,
-                    y - halfSize - 5 + i,
-                    4,
-                    2};
-                SDL_RenderFillRect(renderer, &fuseBit);
+                // Toggle the hitbox overlay
+                toggleCollisionDebug();
             }
+        }
+    }
+}
 
-            // Spark (animated)
-            static float sparkPhase = 0.0f;
-            sparkPhase += 0.1f;
+// Update game state
+void updateGame()
+{
+    lockGameMutex();
 
-            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-            filledCircleRGBA(renderer,
-                             x + sin(sparkPhase) * 3,
-                             y - halfSize - 10 + cos(sparkPhase) * 2,
-                             4 + sin(sparkPhase + 1.0f) * 2,
-                             255, 200 + sin(sparkPhase) * 55, 0, 255);
+    // Only update game objects if the game is active
+    if (game_state == STATE_PLAYING)
+    {
+        // Update game timer
+        Uint32 current_time = simNowMs();
+        game_time = (current_time - start_time) / 1000; // Convert to seconds
 
-            // Inner glow
-            filledCircleRGBA(renderer,
-                             x + sin(sparkPhase) * 2,
-                             y - halfSize - 10 + cos(sparkPhase) * 1,
-                             2,
-                             255, 255, 200, 255);
-        }
-        else
+        // Check if game is over due to no health
+        if (health <= 0)
         {
-            // Explosion effect with more detail and animation
-            static float explosionPhase = 0.0f;
-            explosionPhase += 0.05f;
+            // Change game state and save score
+            game_state = STATE_GAME_OVER;
+            NINJA_PROBE1(game_over, score);
+            addScore(score);
+        }
 
-            // Central flash
-            filledCircleRGBA(renderer, x, y, halfSize, 255, 255, 200, 150);
+        perf_stats.active_objects = updateObjects(gameObjects, MAX_FRUITS);
+    }
 
-            // Fiery explosion particles
-            for (int i = 0; i < 30; i++)
-            {
-                float angle = 2.0f * M_PI * i / 30.0f + explosionPhase;
-                float speedVar = 0.6f + 0.4f * sin(i + explosionPhase);
-                float distance = (halfSize - 5) * (1.0f + ((float)rand() / RAND_MAX) * 0.8f) * speedVar;
-                float cx = x + cos(angle) * distance;
-                float cy = y + sin(angle) * distance;
+    if (spectator_stream.active)
+    {
+        publishSpectatorTick();
+    }
+    if (replay_recorder.active)
+    {
+        recordReplayStep();
+    }
 
-                // Fire colors
-                Uint8 r = 220 + rand() % 36;
-                Uint8 g = 100 + (i % 20) * 8;
-                Uint8 b = rand() % 40;
+    unlockGameMutex();
+}
 
-                // Size varies based on distance
-                float size = 5 + (halfSize - distance / 5) / 5;
+// Move objects and their slice pieces one frame, retiring those that have left the screen
+// Returns how many were active. Caller holds game_mutex for gameObjects.
+int updateObjects(GameObject *objects, int count)
+{
+    int active_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (objects[i].active)
+        {
+            active_count++;
 
-                filledCircleRGBA(renderer, cx, cy, size, r, g, b, 255);
+            // Update main fruit position
+            objects[i].vy += 0.3f; // Increased gravity effect (was 0.2f)
+            objects[i].x += objects[i].vx;
+            objects[i].y += objects[i].vy;
+            objects[i].rotation += objects[i].rotSpeed;
 
-                // Smaller bright center
-                filledCircleRGBA(renderer, cx, cy, size / 2, 255, 230, 200, 255);
+            // Update slice pieces if sliced
+            if (objects[i].sliced)
+            {
+                for (int j = 0; j < SLICE_PIECES; j++)
+                {
+                    if (objects[i].pieces[j].timeLeft > 0)
+                    {
+                        objects[i].pieces[j].vy += 0.45f; // Heavier gravity for pieces (was 0.3f)
+                        objects[i].pieces[j].x += objects[i].pieces[j].vx;
+                        objects[i].pieces[j].y += objects[i].pieces[j].vy;
+                        objects[i].pieces[j].rotation += objects[i].pieces[j].rotSpeed;
+                        objects[i].pieces[j].timeLeft--;
+                    }
+                }
             }
 
-            // Smoke particles
-            for (int i = 0; i < 15; i++)
+            // Check if out of bounds
+            if (objects[i].y > WINDOW_HEIGHT + FRUIT_SIZE ||
+                objects[i].x < -FRUIT_SIZE ||
+                objects[i].x > WINDOW_WIDTH + FRUIT_SIZE)
             {
-                float angle = 2.0f * M_PI * i / 15.0f - explosionPhase;
-                float distance = (halfSize - 5) * (1.2f + ((float)rand() / RAND_MAX) * 1.0f);
-                float cx = x + cos(angle) * distance;
-                float cy = y + sin(angle) * distance;
+                // Check if all animation is complete
+                bool animationDone = true;
+                if (objects[i].sliced)
+                {
+                    for (int j = 0; j < SLICE_PIECES; j++)
+                    {
+                        if (objects[i].pieces[j].timeLeft > 0)
+                        {
+                            animationDone = false;
+                            break;
+                        }
+                    }
+                }
 
-                // Gray smoke
-                Uint8 gray = 40 + rand() % 60;
+                if (animationDone)
+                {
+                    objects[i].active = 0;
 
-                filledCircleRGBA(renderer, cx, cy, 7 + rand() % 7, gray, gray, gray, 150);
+                    // No penalty for missing a fruit - REMOVED
+                    // Just deactivate the fruit without affecting score
+                }
             }
         }
-        break;
     }
+
+    return active_count;
 }
 
-// Helper function for drawing filled circles since SDL doesn't provide one
-void filledCircleRGBA(SDL_Renderer *renderer, int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+// Render the game
+void renderGame()
 {
-    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    // Lock mutex before rendering
+    lockGameMutex();
 
-    for (int w = 0; w < radius * 2; w++)
-    {
-        for (int h = 0; h < radius * 2; h++)
-        {
-            int dx = radius - w;
-            int dy = radius - h;
-            if ((dx * dx + dy * dy) <= (radius * radius))
-            {
-                SDL_RenderDrawPoint(renderer, x + dx - radius, y + dy - radius);
-            }
-        }
-    }
-}
+    // Draw new juice splats into the accumulation texture
+    drawScopePush(SCOPE_BACKGROUND);
+    updateSplats();
 
-// Function to initialize the game
-int initGame(void)
-{
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
-    {
-        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
-        return 0;
-    }
+    // Clear screen
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
 
-    // Create window
-    window = SDL_CreateWindow("Ninja Fruit",
-                              SDL_WINDOWPOS_UNDEFINED,
-                              SDL_WINDOWPOS_UNDEFINED,
-                              WINDOW_WIDTH, WINDOW_HEIGHT,
-                              SDL_WINDOW_SHOWN);
-    if (window == NULL)
-    {
-        printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
-        return 0;
-    }
+    // Draw background (with any juice splats on it)
+    SDL_RenderCopy(renderer, splat_texture != NULL ? splat_texture : background_texture, NULL, NULL);
+    drawScopePop();
 
-    // Create renderer
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (renderer == NULL)
-    {
-        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
-        return 0;
-    }
+    drawScopePush(SCOPE_HUD);
 
-    // Initialize SDL_mixer
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    // ===== Draw Score Panel =====
+    // Create a nice-looking score panel in top-left
+    for (int i = 0; i < 40; i++)
     {
-        printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
-        // Continue without sound
+        int alpha = 180 - i * 3;
+        if (alpha < 0)
+            alpha = 0;
+        SDL_SetRenderDrawColor(renderer, 30, 30, 60, alpha);
+        SDL_Rect scoreGradient = {10, 10 + i, 120, 1};
+        SDL_RenderFillRect(renderer, &scoreGradient);
     }
 
-    // Load sound effects
-    sliceSound = Mix_LoadWAV("assets/sounds/slice.wav");
-    bombSound = Mix_LoadWAV("assets/sounds/bomb.wav");
-    backgroundMusic = Mix_LoadMUS("assets/sounds/background.wav");
+    // Main score box
+    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
+    SDL_Rect scoreRect = {10, 10, 140, 40}; // Increased width from 120 to 140
+    SDL_RenderFillRect(renderer, &scoreRect);
 
-    if (sliceSound == NULL || bombSound == NULL || backgroundMusic == NULL)
-    {
-        printf("Warning: Could not load sounds! SDL_mixer Error: %s\n", Mix_GetError());
-        // Continue without sound
-    }
+    // Border for score box
+    SDL_SetRenderDrawColor(renderer, 200, 150, 100, 255); // Changed color from blue to amber
+    SDL_Rect scoreBorder = {10, 10, 140, 40};             // Increased width from 120 to 140
+    SDL_RenderDrawRect(renderer, &scoreBorder);
 
-    // Create a solid color background if no background image is available
-    background_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                                           SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+    // Draw score text
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-    if (background_texture == NULL)
-    {
-        printf("Background texture could not be created! SDL Error: %s\n", SDL_GetError());
-        // Continue without background
-    }
-    else
-    {
-        // Set render target to the background texture
-        SDL_SetRenderTarget(renderer, background_texture);
+    // Display score number (simplistic digital-style)
+    char scoreStr[20];
+    sprintf(scoreStr, "%d", score);
+    int digitWidth = 10; // Reduced from 12 to 10
 
-        // Fill with deep space gradient
-        for (int y = 0; y < WINDOW_HEIGHT; y++)
-        {
-            // Gradient from deep space black/purple to slightly blue
-            float gradientFactor = (float)y / WINDOW_HEIGHT;
-            Uint8 r = 5 + (int)(10 * (1.0 - gradientFactor));
-            Uint8 g = 0 + (int)(5 * (1.0 - gradientFactor));
-            Uint8 b = 20 + (int)(40 * (1.0 - gradientFactor));
+    // Calculate position to center score in its box
+    int scoreDigits = strlen(scoreStr);
+    int digitSpacing = 4; // Increased spacing between digits (was 2)
+    int totalScoreWidth = scoreDigits * digitWidth + (scoreDigits - 1) * digitSpacing;
+    int digitX = scoreRect.x + (scoreRect.w - totalScoreWidth) / 2;
+    int digitY = scoreRect.y + (scoreRect.h - 18) / 2; // Center vertically (18 is digit height)
+
+    // Set drawing color back to white for the score display
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+    // Display score as a digital-style number
+    for (int i = 0; scoreStr[i] != '\0'; i++)
+    {
+        int digit = scoreStr[i] - '0';
 
-            SDL_SetRenderDrawColor(renderer, r, g, b, 255);
-            SDL_RenderDrawLine(renderer, 0, y, WINDOW_WIDTH, y);
-        }
+        // Simple digital rendering - rectangles for each segment
+        // Adjust positioning based on digit
+        SDL_Rect segments[7]; // 7 segments in a digital display
 
-        // Draw distant stars - more of them for a rich space background
-        srand(time(NULL));
-        for (int i = 0; i < 500; i++)
+        // Initialize segments to off position
+        for (int s = 0; s < 7; s++)
         {
-            int x = rand() % WINDOW_WIDTH;
-            int y = rand() % WINDOW_HEIGHT;
-            int brightness = 150 + rand() % 106;  // 150-255
-            int size = rand() % 100 > 95 ? 2 : 1; // Mostly small stars, some larger
+            segments[s].x = digitX + i * (digitWidth + digitSpacing);
+            segments[s].y = digitY;
+            segments[s].w = 8;
+            segments[s].h = 2;
+        }
 
-            // Random star colors - mostly white, but some colored stars
-            Uint8 r = brightness;
-            Uint8 g = brightness;
-            Uint8 b = brightness;
+        // Horizontal segments
+        segments[0].y = digitY;      // Top
+        segments[3].y = digitY + 8;  // Middle
+        segments[6].y = digitY + 16; // Bottom
 
-            // Add some color variation to stars
-            int color_type = rand() % 20;
-            if (color_type == 0)
-            { // Reddish
-                g = g * 0.7;
-                b = b * 0.7;
-            }
-            else if (color_type == 1)
-            { // Bluish
-                r = r * 0.7;
-                g = g * 0.8;
-            }
-            else if (color_type == 2)
-            { // Yellowish
-                b = b * 0.7;
-            }
+        // Vertical segments
+        segments[1].x = digitX + i * (digitWidth + digitSpacing) + 8; // Top right
+        segments[1].y = digitY;
+        segments[1].w = 2;
+        segments[1].h = 8;
 
-            SDL_SetRenderDrawColor(renderer, r, g, b, 255);
-            SDL_Rect star = {x, y, size, size};
-            SDL_RenderFillRect(renderer, &star);
+        segments[2].x = digitX + i * (digitWidth + digitSpacing) + 8; // Bottom right
+        segments[2].y = digitY + 8;
+        segments[2].w = 2;
+        segments[2].h = 8;
 
-            // Add occasional twinkle effect (brighter center)
-            if (rand() % 10 == 0)
+        segments[4].x = digitX + i * (digitWidth + digitSpacing); // Top left
+        segments[4].y = digitY;
+        segments[4].w = 2;
+        segments[4].h = 8;
+
+        segments[5].x = digitX + i * (digitWidth + digitSpacing); // Bottom left
+        segments[5].y = digitY + 8;
+        segments[5].w = 2;
+        segments[5].h = 8;
+
+        // Define which segments are on for each digit
+        bool segmentOn[10][7] = {
+            {1, 1, 1, 0, 1, 1, 1}, // 0
+            {0, 1, 1, 0, 0, 0, 0}, // 1
+            {1, 1, 0, 1, 0, 1, 1}, // 2
+            {1, 1, 1, 1, 0, 0, 1}, // 3
+            {0, 1, 1, 1, 1, 0, 0}, // 4
+            {1, 0, 1, 1, 1, 0, 1}, // 5
+            {1, 0, 1, 1, 1, 1, 1}, // 6
+            {1, 1, 1, 0, 0, 0, 0}, // 7
+            {1, 1, 1, 1, 1, 1, 1}, // 8
+            {1, 1, 1, 1, 1, 0, 1}  // 9
+        };
+
+        // Render the active segments for this digit
+        for (int s = 0; s < 7; s++)
+        {
+            if (segmentOn[digit][s])
             {
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
-                SDL_Rect twinkle = {x, y, 1, 1};
-                SDL_RenderFillRect(renderer, &twinkle);
+                SDL_RenderFillRect(renderer, &segments[s]);
             }
         }
-
-        // Reset render target
-        SDL_SetRenderTarget(renderer, NULL);
     }
 
-    // Initialize mutex
-    pthread_mutex_init(&game_mutex, NULL);
+    // ===== Draw Timer in top-middle =====
+    int minutes = game_time / 60;
+    int seconds = game_time % 60;
 
-    // Initialize game objects
-    for (int i = 0; i < MAX_FRUITS; i++)
-    {
-        gameObjects[i].active = 0;
-    }
+    // Timer background
+    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
+    SDL_Rect timerRect = {WINDOW_WIDTH / 2 - 60, 10, 120, 50}; // Increased width from 100 to 120
+    SDL_RenderFillRect(renderer, &timerRect);
 
-    // Set up spawn pipe
-    if (pipe(spawn_pipe) != 0)
-    {
-        printf("Failed to create pipe\n");
-        return 0;
-    }
+    // Timer border
+    SDL_SetRenderDrawColor(renderer, 100, 200, 100, 255);
+    SDL_Rect timerBorder = {WINDOW_WIDTH / 2 - 60, 10, 120, 50}; // Increased width from 100 to 120
+    SDL_RenderDrawRect(renderer, &timerBorder);
 
-    // Initialize game variables
-    score = 0;
-    health = 3;
-    game_time = 0;
-    start_time = SDL_GetTicks();
+    // Display timer as MM:SS
+    char timeStr[10];
+    sprintf(timeStr, "%02d:%02d", minutes, seconds);
 
-    // Play background music
-    Mix_PlayMusic(backgroundMusic, -1);
+    // Improved timer rendering with better digital display
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-    // Initialize deadlock detection system
-    initDeadlockDetector();
+    // Calculate position to center timer text
+    int timerDigitWidth = 10; // Increased for better visibility
+    int digitHeight = 30;     // Increased for better visibility
+    int segmentThickness = 3; // Thicker segments
+
+    // Calculate width of timer text (5 characters plus spacing)
+    int timerSpacing = 4;                                        // Increased spacing between digits (was 2)
+    int timerTextWidth = 5 * timerDigitWidth + 4 * timerSpacing; // 5 chars (MM:SS) with 4px spacing between each
+    int timeX = WINDOW_WIDTH / 2 - timerTextWidth / 2;
+    int timeY = timerRect.y + (timerRect.h - digitHeight) / 2; // Center vertically
 
-    // Create deadlock monitoring thread
-    if (pthread_create(&deadlock_thread, NULL, deadlockMonitor, NULL) != 0)
+    // Draw each character in the time string with improved digital segments
+    for (int i = 0; timeStr[i] != '\0'; i++)
     {
-        fprintf(stderr, "Failed to create deadlock monitoring thread\n");
-        return 0;
-    }
+        if (timeStr[i] == ':')
+        {
+            // Draw colon with larger dots
+            int dotSize = digitHeight / 5;
+            int dotY1 = timeY + digitHeight / 3 - dotSize / 2;
+            int dotY2 = timeY + 2 * digitHeight / 3 - dotSize / 2;
+            SDL_Rect colon1 = {timeX + i * (timerDigitWidth + timerSpacing), dotY1, dotSize, dotSize};
+            SDL_Rect colon2 = {timeX + i * (timerDigitWidth + timerSpacing), dotY2, dotSize, dotSize};
+            SDL_RenderFillRect(renderer, &colon1);
+            SDL_RenderFillRect(renderer, &colon2);
+        }
+        else
+        {
+            // Convert character to digit
+            int digit = timeStr[i] - '0';
+            int x = timeX + i * (timerDigitWidth + timerSpacing);
+            int y = timeY;
 
-    // Load scores from file
-    loadScores();
+            // Arrays to define which segments are on for each digit (7-segment display)
+            // Segments: 0=top, 1=top-right, 2=bottom-right, 3=bottom, 4=bottom-left, 5=top-left, 6=middle
+            bool segments[10][7] = {
+                {1, 1, 1, 1, 1, 1, 0}, // 0
+                {0, 1, 1, 0, 0, 0, 0}, // 1
+                {1, 1, 0, 1, 1, 0, 1}, // 2
+                {1, 1, 1, 1, 0, 0, 1}, // 3
+                {0, 1, 1, 0, 0, 1, 1}, // 4
+                {1, 0, 1, 1, 0, 1, 1}, // 5
+                {1, 0, 1, 1, 1, 1, 1}, // 6
+                {1, 1, 1, 0, 0, 0, 0}, // 7
+                {1, 1, 1, 1, 1, 1, 1}, // 8
+                {1, 1, 1, 1, 0, 1, 1}  // 9
+            };
 
-    return 1; // Success
-}
+            // Define coordinates for each segment
+            SDL_Rect segs[7];
 
-// Spawn objects thread function
-void *spawnObjects(void *arg)
-{
-    // Avoid unused parameter warning
-    (void)arg;
+            // Horizontal segments (top, middle, bottom)
+            segs[0] = (SDL_Rect){x, y, timerDigitWidth, segmentThickness}; // Top
 
-    // Initialize random seed
-    srand(time(NULL));
+            // Define local variables needed for rendering
+            int digitHeight = 30;                // Height of the digit
+            int digitWidth = timerDigitWidth;    // Use existing width
+            int segThickness = segmentThickness; // Use existing thickness
 
-    // Variables for controlling spawn patterns
-    int spawn_mode = 0; // 0 = regular, 1 = cluster, 2 = line, 3 = arc
-    int spawn_timer = 0;
-    int spawn_cooldown = 0;
-    int last_spawn_time = 0; // Track when we last spawned something
+            segs[6] = (SDL_Rect){x, y + digitHeight / 2 - segThickness / 2, digitWidth, segThickness}; // Middle
+            segs[3] = (SDL_Rect){x, y + digitHeight - segThickness, digitWidth, segThickness};         // Bottom
 
-    while (running)
-    {
-        // Lock mutex before modifying shared data
-        pthread_mutex_lock(&game_mutex);
+            // Vertical segments (top-right, bottom-right, bottom-left, top-left)
+            segs[1] = (SDL_Rect){x + digitWidth - segThickness, y, segThickness, digitHeight / 2};                   // Top-right
+            segs[2] = (SDL_Rect){x + digitWidth - segThickness, y + digitHeight / 2, segThickness, digitHeight / 2}; // Bottom-right
+            segs[4] = (SDL_Rect){x, y + digitHeight / 2, segThickness, digitHeight / 2};                             // Bottom-left
+            segs[5] = (SDL_Rect){x, y, segThickness, digitHeight / 2};                                               // Top-left
+
+            // Draw the active segments for this digit
+            for (int s = 0; s < 7; s++)
+            {
+                if (segments[digit][s])
+                {
+                    SDL_RenderFillRect(renderer, &segs[s]);
+                }
+            }
+        }
+    }
+
+    // ===== Draw Health Hearts in top-right =====
+    // Health background
+    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
+    SDL_Rect healthRect = {WINDOW_WIDTH - 150, 10, 140, 40}; // Updated to match scoreRect dimensions
+    SDL_RenderFillRect(renderer, &healthRect);
+
+    // Health border
+    SDL_SetRenderDrawColor(renderer, 200, 100, 100, 255);
+    SDL_Rect healthBorder = {WINDOW_WIDTH - 150, 10, 140, 40}; // Updated to match scoreRect dimensions
+    SDL_RenderDrawRect(renderer, &healthBorder);
 
-        // Get current time
-        int current_time = SDL_GetTicks() / 1000;
+    // Draw hearts
+    // Calculate total width of all hearts with spacing between them
+    int heartWidth = 16;   // Approximate width of a heart
+    int heartSpacing = 25; // Space between hearts
+    int totalHeartsWidth = (3 * heartWidth) + (2 * heartSpacing);
+    int startX = healthRect.x + (healthRect.w - totalHeartsWidth) / 2 + 7; // Center hearts horizontally
 
-        // Decrease spawn cooldown
-        if (spawn_cooldown > 0)
+    for (int i = 0; i < 3; i++)
+    {
+        if (i < health)
+        {
+            // Full heart - red
+            SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255);
+        }
+        else
         {
-            spawn_cooldown--;
+            // Empty heart - gray outline
+            SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
         }
 
-        // Change spawn mode occasionally
-        spawn_timer++;
-        if (spawn_timer > 200)
-        { // About every 10 seconds
-            spawn_timer = 0;
-            int prev_mode = spawn_mode;
-            spawn_mode = rand() % 4; // Select a random spawn pattern
-            printf("Spawn mode changed to: %d\n", spawn_mode);
+        // Draw a heart shape - simplified
+        int heartX = startX + i * (heartWidth + heartSpacing);
+        int heartY = healthRect.y + healthRect.h / 2; // Center hearts vertically in the box
+
+        // Draw heart shape (very simplified)
+        SDL_Point heartPoints[] = {
+            {heartX, heartY + 5},
+            {heartX - 8, heartY - 3},
+            {heartX - 4, heartY - 7},
+            {heartX, heartY - 2},
+            {heartX + 4, heartY - 7},
+            {heartX + 8, heartY - 3},
+            {heartX, heartY + 5}};
+
+        SDL_RenderDrawLines(renderer, heartPoints, 7);
 
-            // If we're changing modes and there are few active fruits, force a spawn in the new mode
-            if (prev_mode != spawn_mode)
+        // Fill heart if it's a full heart
+        if (i < health)
+        {
+            for (int y = heartY - 6; y <= heartY + 4; y++)
             {
-                // Count active fruits
-                int active_count = 0;
-                for (int i = 0; i < MAX_FRUITS; i++)
+                for (int x = heartX - 7; x <= heartX + 7; x++)
                 {
-                    if (gameObjects[i].active)
+                    // Simple formula to check if point is inside heart shape
+                    int dx = x - heartX;
+                    int dy = y - heartY;
+                    if ((dx * dx + dy * dy) < 50 && y <= heartY + 5)
                     {
-                        active_count++;
+                        SDL_RenderDrawPoint(renderer, x, y);
                     }
                 }
-
-                // If we have less than 3 active fruits, force an immediate spawn
-                if (active_count < 3)
-                {
-                    spawn_cooldown = 0;  // Reset cooldown to allow immediate spawn
-                    last_spawn_time = 0; // Reset last spawn time to force spawn
-                }
             }
         }
+    }
 
-        // Count active fruits
-        int active_count = 0;
-        for (int i = 0; i < MAX_FRUITS; i++)
+    drawScopePop();
+
+    // Draw each game object
+    drawGameObjects(gameObjects, MAX_FRUITS);
+
+    // Draw slicing effect when mouse is down
+    drawScopePush(SCOPE_TRAIL);
+    if (mouse_down && (prev_mouse_x != mouse_x || prev_mouse_y != mouse_y))
+    {
+        // Create dynamic slice trail
+        static float trailOpacity[15] = {0}; // Increased from 10 to 15 for longer trail
+        static int trailX[15] = {0};         // X positions for trail segments
+        static int trailY[15] = {0};         // Y positions for trail segments
+        static float trailWidth[15] = {0};   // Width of each trail segment
+
+        // Shift trail values
+        for (int i = 14; i > 0; i--)
         {
-            if (gameObjects[i].active)
-            {
-                active_count++;
-            }
+            trailX[i] = trailX[i - 1];
+            trailY[i] = trailY[i - 1];
+            trailOpacity[i] = trailOpacity[i - 1] * 0.85f; // Slower fade out (was 0.8f)
+            trailWidth[i] = trailWidth[i - 1] * 0.9f;      // Gradual thinning
         }
 
-        // Check if we need an emergency spawn - if no active fruits or it's been too long
-        bool need_emergency_spawn = (active_count == 0 || (current_time - last_spawn_time > 2));
+        // Add new point to trail
+        trailX[0] = mouse_x;
+        trailY[0] = mouse_y;
+        trailOpacity[0] = 1.0f; // Full opacity at start (was 0.9f)
+
+        // Calculate trail width based on mouse movement speed
+        float movement = sqrt(pow(mouse_x - prev_mouse_x, 2) + pow(mouse_y - prev_mouse_y, 2));
+        trailWidth[0] = fmin(3.5f, 1.5f + movement * 0.05f); // Thinner trail: was 6.0f max, now 3.5f max
+
+        // Shorter trail and thinner edges when the quality governor is shedding detail
+        int trailSegments = quality_governor.level >= QUALITY_MEDIUM ? 8 : 15;
+        float thicknessScale = quality_governor.level >= QUALITY_MEDIUM ? 0.75f : 1.5f;
 
-        // Regular fruit spawning when cooldown is over
-        if (spawn_cooldown <= 0 || need_emergency_spawn)
+        // Draw trail with improved gradient
+        for (int i = 1; i < trailSegments; i++)
         {
-            // Only spawn if we're below the limit
-            if (active_count < MAX_FRUITS - 3) // Leave room for clusters
+            if (trailOpacity[i] > 0.05f)
             {
-                bool spawned_something = false;
+                int alpha = (int)(trailOpacity[i] * 255);
+                float thickness = trailWidth[i];
+                if (thickness < 0.5f)
+                    thickness = 0.5f;
+
+                // Bright core
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, alpha);
+                SDL_RenderDrawLine(renderer, trailX[i - 1], trailY[i - 1], trailX[i], trailY[i]);
 
-                if (spawn_mode == 0) // Regular spawning
+                // Thinner colored trail with better rainbow effect
+                for (int t = 1; t <= (int)(thickness * thicknessScale); t++) // Reduced multiplier from 2 to 1.5
                 {
-                    // Find an inactive object slot
-                    for (int i = 0; i < MAX_FRUITS; i++)
+                    float tFactor = t / thickness;
+
+                    // Vibrant sword-like colors
+                    Uint8 r, g, b;
+                    // Calculate hue based on position in trail and current time for animation
+                    float hue = (i * 20 + SDL_GetTicks() / 10) % 360;
+
+                    // Simple HSV to RGB conversion for vibrant colors
+                    if (hue < 60)
                     {
-                        if (!gameObjects[i].active)
-                        {
-                            // Random chance to spawn - reduced spawn rate
-                            if (need_emergency_spawn || rand() % 15 == 0) // Was 20 (more frequent now)
-                            {
-                                spawnFruit(i);
-                                spawn_cooldown = 2; // Reduced cooldown (was 3)
-                                spawned_something = true;
-                                last_spawn_time = current_time;
-                                break;
-                            }
-                        }
+                        r = 255;
+                        g = (Uint8)(hue * 4.25);
+                        b = 0;
                     }
-                }
-                else if (spawn_mode == 1 && active_count < MAX_FRUITS - 5) // Cluster spawning
-                {
-                    // Spawn a cluster of 3-5 fruits close together - less frequently
-                    if (need_emergency_spawn || rand() % 30 == 0) // Was 40 (more frequent now)
+                    else if (hue < 120)
                     {
-                        int cluster_size = 3 + rand() % 3; // 3-5 fruits
-                        int base_x = 100 + rand() % (WINDOW_WIDTH - 200);
-                        float base_vx = -3.0f + (rand() % 60) / 10.0f;
-                        float base_vy = 2.0f + (rand() % 30) / 10.0f;
-
-                        int spawned = 0;
-                        for (int i = 0; i < MAX_FRUITS && spawned < cluster_size; i++)
-                        {
-                            if (!gameObjects[i].active)
-                            {
-                                spawnFruitAt(i,
-                                             base_x + (rand() % 120 - 60),
-                                             -(rand() % 20),
-                                             base_vx + ((rand() % 20 - 10) / 10.0f),
-                                             base_vy + ((rand() % 20) / 10.0f));
-                                spawned++;
-                            }
-                        }
-                        spawn_cooldown = 25; // Reduced cooldown (was 40)
-                        spawned_something = true;
-                        last_spawn_time = current_time;
+                        r = (Uint8)((120 - hue) * 4.25);
+                        g = 255;
+                        b = 0;
                     }
-                }
-                else if (spawn_mode == 2) // Line formation
-                {
-                    // Spawn fruits in a horizontal line for slicing swipes - less frequently
-                    if (need_emergency_spawn || rand() % 35 == 0) // Was 50 (more frequent now)
+                    else if (hue < 180)
                     {
-                        int line_count = 4 + rand() % 3; // 4-6 fruits
-                        int spacing = FRUIT_SIZE + 10;
-                        int start_x = (WINDOW_WIDTH - line_count * spacing) / 2 + rand() % 100 - 50;
-                        int y_pos = -30;
-                        float shared_vx = -1.0f + (rand() % 20) / 10.0f;
-                        float shared_vy = 2.0f + (rand() % 20) / 10.0f;
-
-                        int spawned = 0;
-                        for (int i = 0; i < MAX_FRUITS && spawned < line_count; i++)
-                        {
-                            if (!gameObjects[i].active)
-                            {
-                                spawnFruitAt(i,
-                                             start_x + spacing * spawned,
-                                             y_pos + (rand() % 20 - 10),
-                                             shared_vx,
-                                             shared_vy);
-                                spawned++;
-                            }
-                        }
-                        spawn_cooldown = 30; // Reduced cooldown (was 50)
-                        spawned_something = true;
-                        last_spawn_time = current_time;
+                        r = 0;
+                        g = 255;
+                        b = (Uint8)((hue - 120) * 4.25);
                     }
-                }
-                else if (spawn_mode == 3) // Arc formation
-                {
-                    // Spawn fruits in an arc pattern - less frequently
-                    if (need_emergency_spawn || rand() % 60 == 0) // Was 100, now 60 (more frequent)
+                    else if (hue < 240)
                     {
-                        int arc_count = 5 + rand() % 3; // 5-7 fruits
-                        float arc_radius = 100.0f + rand() % 50;
-                        float arc_center_x = WINDOW_WIDTH / 2 + rand() % 200 - 100;
-                        float arc_start = -M_PI / 4 - (rand() % 20) / 100.0f;
-                        float arc_end = M_PI / 4 + (rand() % 20) / 100.0f;
-                        float arc_step = (arc_end - arc_start) / (arc_count - 1);
-
-                        float shared_vy = 3.0f + (rand() % 20) / 10.0f;
-
-                        int spawned = 0;
-                        for (int i = 0; i < MAX_FRUITS && spawned < arc_count; i++)
-                        {
-                            if (!gameObjects[i].active)
-                            {
-                                float angle = arc_start + arc_step * spawned;
-                                float x_pos = arc_center_x + cos(angle) * arc_radius;
-                                float y_pos = -30;
-                                float vx = sin(angle) * 2.0f;
-
-                                spawnFruitAt(i, x_pos, y_pos, vx, shared_vy);
-                                spawned++;
-                            }
-                        }
-                        spawn_cooldown = 60; // Reduced cooldown (was 110)
-                        spawned_something = true;
-                        last_spawn_time = current_time;
+                        r = 0;
+                        g = (Uint8)((240 - hue) * 4.25);
+                        b = 255;
                     }
-                }
-
-                // Emergency spawn if nothing was spawned and we need to
-                if (need_emergency_spawn && !spawned_something && active_count == 0)
-                {
-                    // Guaranteed spawn at least one fruit
-                    for (int i = 0; i < MAX_FRUITS; i++)
+                    else if (hue < 300)
                     {
-                        if (!gameObjects[i].active)
-                        {
-                            spawnFruit(i);
-                            last_spawn_time = current_time;
-                            break;
-                        }
+                        r = (Uint8)((hue - 240) * 4.25);
+                        g = 0;
+                        b = 255;
+                    }
+                    else
+                    {
+                        r = 255;
+                        g = 0;
+                        b = (Uint8)((360 - hue) * 4.25);
                     }
-                }
-            }
-        }
-
-        // Unlock mutex
-        pthread_mutex_unlock(&game_mutex);
-
-        // Sleep to control spawn rate (increased to slow down spawn rate)
-        usleep(100000); // 100ms instead of 40ms
-    }
-
-    return NULL;
-}
-
-// Helper function to spawn a fruit with default parameters
-void spawnFruit(int index)
-{
-    gameObjects[index].active = 1;
-    gameObjects[index].x = rand() % (WINDOW_WIDTH - FRUIT_SIZE);
-    gameObjects[index].y = 0; // Drop from the top of the screen
-
-    // Random horizontal velocity component with increased speed
-    gameObjects[index].vx = (-3.0f + (rand() % 60) / 10.0f) * 1.5f; // 50% faster (was 1.3f)
-    gameObjects[index].vy = (2.0f + (rand() % 30) / 10.0f) * 1.5f;  // 50% faster (was 1.3f)
-
-    gameObjects[index].sliced = 0;
-    gameObjects[index].rotation = 0.0f;
-    gameObjects[index].rotSpeed = (0.05f + ((float)rand() / RAND_MAX) * 0.1f) * 1.5f; // Faster rotation (was 1.2f)
-    if (rand() % 2)
-        gameObjects[index].rotSpeed *= -1; // Random direction
-
-    // Determine if it's a bomb or fruit
-    if (rand() % BOMB_CHANCE == 0)
-    {
-        gameObjects[index].type = BOMB;
-    }
-    else
-    {
-        gameObjects[index].type = rand() % FRUIT_TYPES;
-    }
-
-    // Initialize slice pieces (will be used when sliced)
-    for (int j = 0; j < SLICE_PIECES; j++)
-    {
-        gameObjects[index].pieces[j].timeLeft = 0;
-    }
-}
-
-// Helper function to spawn a fruit at specific position with specific velocity
-void spawnFruitAt(int index, float x, float y, float vx, float vy)
-{
-    gameObjects[index].active = 1;
-    gameObjects[index].x = x;
-    gameObjects[index].y = y;
-
-    // Apply speed multiplier
-    gameObjects[index].vx = vx * 1.5f; // 50% faster (was 1.3f)
-    gameObjects[index].vy = vy * 1.5f; // 50% faster (was 1.3f)
-
-    gameObjects[index].sliced = 0;
-    gameObjects[index].rotation = 0.0f;
-    gameObjects[index].rotSpeed = (0.05f + ((float)rand() / RAND_MAX) * 0.1f) * 1.5f; // Faster rotation (was 1.2f)
-    if (rand() % 2)
-        gameObjects[index].rotSpeed *= -1; // Random direction
-
-    // Determine if it's a bomb or fruit (less bombs in formations)
-    if (rand() % (BOMB_CHANCE * 2) == 0) // Half as many bombs in formations
-    {
-        gameObjects[index].type = BOMB;
-    }
-    else
-    {
-        gameObjects[index].type = rand() % FRUIT_TYPES;
-    }
-
-    // Initialize slice pieces (will be used when sliced)
-    for (int j = 0; j < SLICE_PIECES; j++)
-    {
-        gameObjects[index].pieces[j].timeLeft = 0;
-    }
-}
-
-// Function to detect line segment intersection with circle
-// Used to detect if the slice path intersects a fruit
-int lineCircleIntersect(float line_x1, float line_y1, float line_x2, float line_y2, float circle_x, float circle_y, float radius)
-{
-    // Vector from line start to circle center
-    float dx = circle_x - line_x1;
-    float dy = circle_y - line_y1;
-
-    // Vector of the line
-    float line_dx = line_x2 - line_x1;
-    float line_dy = line_y2 - line_y1;
-
-    // Length squared of the line segment
-    float line_len_sq = line_dx * line_dx + line_dy * line_dy;
-
-    // Exit early if line has zero length
-    if (line_len_sq == 0)
-    {
-        return dx * dx + dy * dy <= radius * radius;
-    }
-
-    // Calculate projection of circle center onto line
-    float t = (dx * line_dx + dy * line_dy) / line_len_sq;
-
-    // Clamp t to [0,1] for line segment
-    if (t < 0)
-        t = 0;
-    if (t > 1)
-        t = 1;
 
-    // Find closest point on line segment to circle center
-    float closest_x = line_x1 + t * line_dx;
-    float closest_y = line_y1 + t * line_dy;
+                    // Adjust alpha based on distance from center of trail
+                    int edgeAlpha = (int)(alpha / (tFactor + 1));
 
-    // Check if this point is within the circle
-    float dist_x = closest_x - circle_x;
-    float dist_y = closest_y - circle_y;
-    float dist_sq = dist_x * dist_x + dist_y * dist_y;
+                    SDL_SetRenderDrawColor(renderer, r, g, b, edgeAlpha);
 
-    return dist_sq <= radius * radius;
-}
+                    // Draw parallel lines to create thickness
+                    float angle = atan2(trailY[i] - trailY[i - 1], trailX[i] - trailX[i - 1]) + M_PI / 2;
+                    float distance = t * 0.5f; // Reduced from 0.7f to 0.5f for thinner trail
 
-// Improved collision detection function to account for velocity
-int checkCollision(float slice_x, float slice_y, GameObject *obj)
-{
-    // Get center coordinates and boundaries
-    float center_x = obj->x + FRUIT_SIZE / 2;
-    float center_y = obj->y + FRUIT_SIZE / 2;
+                    int offsetX = (int)(cos(angle) * distance);
+                    int offsetY = (int)(sin(angle) * distance);
 
-    // Special case for banana - use an elongated box along its curve
-    if (obj->type == BANANA)
-    {
-        // Use a wider but shorter box for banana due to its curved shape
-        float banana_box_width = FRUIT_SIZE * 1.6f;
-        float banana_box_height = FRUIT_SIZE * 0.8f;
+                    SDL_RenderDrawLine(renderer,
+                                       trailX[i - 1] + offsetX, trailY[i - 1] + offsetY,
+                                       trailX[i] + offsetX, trailY[i] + offsetY);
 
-        // The banana's curve means we need to offset the box based on rotation
-        float box_offset_x = cos(obj->rotation) * FRUIT_SIZE * 0.2f;
-        float box_offset_y = sin(obj->rotation) * FRUIT_SIZE * 0.1f;
+                    SDL_RenderDrawLine(renderer,
+                                       trailX[i - 1] - offsetX, trailY[i - 1] - offsetY,
+                                       trailX[i] - offsetX, trailY[i] - offsetY);
+                }
 
-        float box_left = center_x - banana_box_width / 2 + box_offset_x;
-        float box_top = center_y - banana_box_height / 2 + box_offset_y;
+                // Add smaller sparkle effects
+                if (i % 3 == 0 && quality_governor.level < QUALITY_LOW) // Less frequent sparkles (was i % 2)
+                {
+                    int sparkleSize = 2 - i / 7; // Smaller sparkles (was 4 - i/5)
+                    if (sparkleSize > 0)
+                    {
+                        // Brighter sparkle color
+                        SDL_SetRenderDrawColor(renderer, 255, 255, 220, alpha);
 
-        // Check if the slice point is within the banana's elongated box
-        if (slice_x >= box_left && slice_x <= box_left + banana_box_width &&
-            slice_y >= box_top && slice_y <= box_top + banana_box_height)
-        {
-            return 1; // Hit!
+                        // Draw as a filled circle instead of a rectangle for better appearance
+                        filledCircleRGBA(renderer,
+                                         trailX[i],
+                                         trailY[i],
+                                         sparkleSize,
+                                         255, 255, 220, alpha);
+                    }
+                }
+            }
         }
     }
-    // Special case for orange - more spherical, so use a more accurate circle
-    else if (obj->type == ORANGE)
+    drawScopePop();
+
+    // If game over, display a message
+    drawScopePush(SCOPE_MENUS);
+    if (game_state == STATE_GAME_OVER)
     {
-        // Calculate distance from slice point to orange center
-        float dx = slice_x - center_x;
-        float dy = slice_y - center_y;
-        float distance_squared = dx * dx + dy * dy;
+        // Semi-transparent overlay
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+        SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
+        SDL_RenderFillRect(renderer, &overlay);
 
-        // Oranges should have a slightly larger hit radius than other fruits
-        float orange_radius = FRUIT_SIZE * 0.55f;
+        // Game over message box
+        SDL_SetRenderDrawColor(renderer, 50, 50, 70, 240);
+        SDL_Rect messageBox = {WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 100, 300, 200};
+        SDL_RenderFillRect(renderer, &messageBox);
 
-        if (distance_squared < orange_radius * orange_radius)
-        {
-            return 1; // Hit!
-        }
-    }
+        // Box border
+        SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
+        SDL_Rect messageBorder = {WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 100, 300, 200};
+        SDL_RenderDrawRect(renderer, &messageBorder);
 
-    // For other fruits, use the standard box collision first
-    // Box collision detection - using more generous box for banana and orange
-    float box_scale = (obj->type == BANANA || obj->type == ORANGE) ? 1.3f : 1.2f;
-    float box_left = obj->x - (FRUIT_SIZE * (box_scale - 1.0f) / 2);
-    float box_top = obj->y - (FRUIT_SIZE * (box_scale - 1.0f) / 2);
-    float box_width = FRUIT_SIZE * box_scale;
-    float box_height = FRUIT_SIZE * box_scale;
+        // Game Over Text with digital display
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-    // Box collision check
-    if (slice_x >= box_left && slice_x <= box_left + box_width &&
-        slice_y >= box_top && slice_y <= box_top + box_height)
-    {
-        return 1; // Hit!
-    }
+        // Draw "GAME OVER" text centered
+        int gameOverWidth = strlen("GAME OVER") * 18 + (strlen("GAME OVER") - 1) * 3;
+        int gameOverX = WINDOW_WIDTH / 2 - gameOverWidth / 2;
+        drawDigitalText(renderer, "GAME OVER", gameOverX, WINDOW_HEIGHT / 2 - 70, 18, 28, 3);
 
-    // If box collision failed, try circle collision as a backup
-    // This helps with curved shapes and other fruits
+        // Draw final score with digital display centered
+        char scoreStr[20];
+        sprintf(scoreStr, "SCORE %d", score);
+        int scoreTextWidth = strlen(scoreStr) * 14 + (strlen(scoreStr) - 1) * 3;
+        int scoreTextX = WINDOW_WIDTH / 2 - scoreTextWidth / 2;
+        drawDigitalText(renderer, scoreStr, scoreTextX, WINDOW_HEIGHT / 2 - 20, 14, 22, 3);
 
-    // Calculate distance from slice point to fruit center
-    float dx = slice_x - center_x;
-    float dy = slice_y - center_y;
-    float distance_squared = dx * dx + dy * dy;
+        // Render "Restart" button
+        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
+        SDL_Rect restartButton = {WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 20, 100, 40};
+        SDL_RenderFillRect(renderer, &restartButton);
 
-    // Very generous hit radius - almost the entire fruit area
-    float hit_radius;
-    switch (obj->type)
-    {
-    case APPLE:
-        hit_radius = FRUIT_SIZE * 0.6f;
-        break;
-    case ORANGE:
-        hit_radius = FRUIT_SIZE * 0.55f; // Changed from 0.65f to match orangeRadius defined elsewhere
-        break;
-    case BANANA:
-        hit_radius = FRUIT_SIZE * 0.75f; // Increased from 0.7f
-        break;
-    case BOMB:
-        hit_radius = FRUIT_SIZE * 0.5f;
-        break;
-    default:
-        hit_radius = FRUIT_SIZE * 0.6f;
-    }
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &restartButton);
 
-    // Check simple circle collision
-    if (distance_squared < hit_radius * hit_radius)
-    {
-        return 1; // Hit!
-    }
+        // Draw "RESTART" text centered in button
+        int restartWidth = strlen("RESTART") * 10 + (strlen("RESTART") - 1) * 2;
+        int restartX = restartButton.x + (restartButton.w - restartWidth) / 2;
+        int restartY = restartButton.y + (restartButton.h - 20) / 2;
+        drawDigitalText(renderer, "RESTART", restartX, restartY, 10, 20, 2);
 
-    // For fast-moving fruits, create a velocity-based adjustment
-    // This helps with hitting fruits that might have moved between frames
-    float velocity_magnitude = sqrt(obj->vx * obj->vx + obj->vy * obj->vy);
+        // Render "Leaderboard" button
+        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
+        SDL_Rect leaderboardButton = {WINDOW_WIDTH / 2 + 20, WINDOW_HEIGHT / 2 + 20, 100, 40};
+        SDL_RenderFillRect(renderer, &leaderboardButton);
 
-    // If the fruit is moving fast, increase the hit radius even more
-    if (velocity_magnitude > 5.0f)
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &leaderboardButton);
+
+        // Draw "SCORES" text centered in button
+        int scoresWidth = strlen("SCORES") * 10 + (strlen("SCORES") - 1) * 2;
+        int scoresX = leaderboardButton.x + (leaderboardButton.w - scoresWidth) / 2;
+        int scoresY = leaderboardButton.y + (leaderboardButton.h - 20) / 2;
+        drawDigitalText(renderer, "SCORES", scoresX, scoresY, 10, 20, 2);
+    }
+    // Display leaderboard
+    else if (game_state == STATE_LEADERBOARD)
     {
-        // Increase hit radius based on velocity - more for banana and orange
-        float speed_bonus = (obj->type == BANANA || obj->type == ORANGE) ? 0.25f : 0.2f;
-        hit_radius += velocity_magnitude * speed_bonus;
+        // Semi-transparent overlay
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+        SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
+        SDL_RenderFillRect(renderer, &overlay);
 
-        // Also check slightly ahead of the fruit's position based on its direction
-        // This helps with hitting fruits that appear to be ahead of their hitbox
-        float vel_dx = slice_x - (center_x + obj->vx * 0.15f);
-        float vel_dy = slice_y - (center_y + obj->vy * 0.15f);
-        float vel_distance_squared = vel_dx * vel_dx + vel_dy * vel_dy;
+        // Leaderboard box
+        SDL_SetRenderDrawColor(renderer, 50, 50, 70, 240);
+        SDL_Rect leaderboardBox = {WINDOW_WIDTH / 2 - 220, 50, 440, WINDOW_HEIGHT - 150}; // Increased width from 400 to 440
+        SDL_RenderFillRect(renderer, &leaderboardBox);
 
-        // Return true if future position check succeeds
-        if (vel_distance_squared < hit_radius * hit_radius)
-        {
-            return 1;
-        }
-    }
+        // Box border
+        SDL_SetRenderDrawColor(renderer, 100, 100, 200, 255);
+        SDL_RenderDrawRect(renderer, &leaderboardBox);
 
-    // Return false as all tests failed
-    return 0;
-}
+        // Draw "LEADERBOARD" title with digital display
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-// Handle SDL events
-void handleEvents()
-{
-    SDL_Event e;
+        // Center the "LEADERBOARD" title
+        int titleWidth = strlen("LEADERBOARD") * 16 + (strlen("LEADERBOARD") - 1) * 3; // Character width * count + spacing
+        int titleX = WINDOW_WIDTH / 2 - titleWidth / 2;
+        drawDigitalText(renderer, "LEADERBOARD", titleX, 70, 16, 28, 3); // Centered
 
-    while (SDL_PollEvent(&e))
-    {
-        if (e.type == SDL_QUIT)
-        {
-            running = 0;
-        }
-        else if (e.type == SDL_MOUSEMOTION)
+        // Display each score entry with digital display
+        int maxDisplayScores = 9; // Changed from 10 to 9
+        for (int i = 0; i < num_scores && i < maxDisplayScores; i++)
         {
-            // Store previous position before updating current
-            prev_mouse_x = mouse_x;
-            prev_mouse_y = mouse_y;
+            int y = 130 + i * 40;
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-            // Update current mouse position
-            mouse_x = e.motion.x;
-            mouse_y = e.motion.y;
+            // Calculate the width of a row to center contents
+            char fullRowText[50];
+            sprintf(fullRowText, "%d.  %d  %s", i + 1, leaderboard[i].score, leaderboard[i].date);
 
-            // Only process mouse movement for slicing if we're in the PLAYING state
-            if (game_state == STATE_PLAYING)
-            {
-                // Improve slice detection - check if mouse moved fast enough to count as a slice
-                float mouse_movement = sqrt(pow(mouse_x - prev_mouse_x, 2) + pow(mouse_y - prev_mouse_y, 2));
+            // Rank - left aligned with padding from left edge
+            char rankStr[5];
+            sprintf(rankStr, "%d.", i + 1);
+            drawDigitalText(renderer, rankStr, leaderboardBox.x + 30, y, 12, 22, 3);
 
-                // Only count as a slice if the movement is significant
-                if (mouse_movement > 5)
-                {
-                    pthread_mutex_lock(&game_mutex);
+            // Score - centered in the middle section
+            char scoreStr[20];
+            sprintf(scoreStr, "%d", leaderboard[i].score);
+            drawDigitalText(renderer, scoreStr, WINDOW_WIDTH / 2 - (strlen(scoreStr) * 12) / 2, y, 12, 22, 3);
 
-                    // Track which objects were sliced to avoid double-counting
-                    int sliced_objects[MAX_FRUITS] = {0};
+            // Date (shortened to just show essential info) - right aligned with padding
+            char dateShort[15];
+            strncpy(dateShort, leaderboard[i].date, 10); // Just show the date part
+            dateShort[10] = '\0';
+            drawDigitalText(renderer, dateShort, leaderboardBox.x + leaderboardBox.w - 30 - (strlen(dateShort) * 8), y, 8, 18, 2);
+        }
 
-                    // First check if the line formed by mouse movement intersects any fruit
-                    for (int i = 0; i < MAX_FRUITS; i++)
-                    {
-                        if (gameObjects[i].active && !gameObjects[i].sliced && !sliced_objects[i])
-                        {
-                            float center_x = gameObjects[i].x + FRUIT_SIZE / 2;
-                            float center_y = gameObjects[i].y + FRUIT_SIZE / 2;
-
-                            // Use a generous radius for line intersection test - larger for bananas and oranges
-                            float hit_radius;
-                            if (gameObjects[i].type == BANANA)
-                            {
-                                // Bananas need a wider hit area due to their elongated shape
-                                hit_radius = FRUIT_SIZE * 0.8f;
-
-                                // For bananas, also check with an offset based on rotation to account for its curve
-                                float offset_x = cos(gameObjects[i].rotation) * FRUIT_SIZE * 0.2f;
-                                float offset_y = sin(gameObjects[i].rotation) * FRUIT_SIZE * 0.1f;
-
-                                // Check both the center and the offset points
-                                if (lineCircleIntersect(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y,
-                                                        center_x + offset_x, center_y + offset_y, hit_radius) ||
-                                    lineCircleIntersect(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y,
-                                                        center_x, center_y, hit_radius))
-                                {
-                                    // Fruit hit by slice line!
-                                    gameObjects[i].sliced = 1;
-                                    sliced_objects[i] = 1;
-
-                                    // Initialize slice pieces
-                                    float sliceAngle = atan2(mouse_y - prev_mouse_y, mouse_x - prev_mouse_x);
-
-                                    // Create two pieces moving in different directions
-                                    for (int j = 0; j < SLICE_PIECES; j++)
-                                    {
-                                        gameObjects[i].pieces[j].x = center_x;
-                                        gameObjects[i].pieces[j].y = center_y;
-
-                                        // Different velocities for each piece
-                                        float pieceAngle = sliceAngle + (j == 0 ? M_PI / 2 : -M_PI / 2);
-                                        float speed = (2.0f + (rand() % 20) / 10.0f) * 1.5f; // 50% faster
-
-                                        gameObjects[i].pieces[j].vx = cos(pieceAngle) * speed;
-                                        gameObjects[i].pieces[j].vy = sin(pieceAngle) * speed + gameObjects[i].vy / 2;
-                                        gameObjects[i].pieces[j].rotation = gameObjects[i].rotation;
-                                        gameObjects[i].pieces[j].rotSpeed = gameObjects[i].rotSpeed * 2.0f * (j == 0 ? 1 : -1);
-                                        gameObjects[i].pieces[j].timeLeft = SLICE_DURATION;
-                                    }
-
-                                    // Play slice sound
-                                    Mix_PlayChannel(-1, sliceSound, 0);
-                                    score += 1;
-                                    printf("Banana sliced! Score: %d\n", score);
-                                }
-                            }
-                            else if (gameObjects[i].type == ORANGE)
-                            {
-                                // Oranges can have a larger radius since they're round
-                                hit_radius = FRUIT_SIZE * 0.55f; // Match exactly with orangeRadius in rendering (0.85f of halfSize = 0.55f of FRUIT_SIZE)
-
-                                if (lineCircleIntersect(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y,
-                                                        center_x, center_y, hit_radius))
-                                {
-                                    // Orange hit by slice line!
-                                    gameObjects[i].sliced = 1;
-                                    sliced_objects[i] = 1;
-
-                                    // Initialize slice pieces
-                                    float sliceAngle = atan2(mouse_y - prev_mouse_y, mouse_x - prev_mouse_x);
-
-                                    // Create two pieces moving in different directions
-                                    for (int j = 0; j < SLICE_PIECES; j++)
-                                    {
-                                        gameObjects[i].pieces[j].x = center_x;
-                                        gameObjects[i].pieces[j].y = center_y;
-
-                                        // Different velocities for each piece
-                                        float pieceAngle = sliceAngle + (j == 0 ? M_PI / 2 : -M_PI / 2);
-                                        float speed = (2.0f + (rand() % 20) / 10.0f) * 1.5f; // 50% faster
-
-                                        gameObjects[i].pieces[j].vx = cos(pieceAngle) * speed;
-                                        gameObjects[i].pieces[j].vy = sin(pieceAngle) * speed + gameObjects[i].vy / 2;
-                                        gameObjects[i].pieces[j].rotation = gameObjects[i].rotation;
-                                        gameObjects[i].pieces[j].rotSpeed = gameObjects[i].rotSpeed * 2.0f * (j == 0 ? 1 : -1);
-                                        gameObjects[i].pieces[j].timeLeft = SLICE_DURATION;
-                                    }
-
-                                    // Play slice sound
-                                    Mix_PlayChannel(-1, sliceSound, 0);
-                                    score += 1;
-                                    printf("Orange sliced! Score: %d\n", score);
-                                }
-                            }
-                            else
-                            {
-                                // For other fruit types and bombs
-                                hit_radius = FRUIT_SIZE * 0.7f;
-
-                                // Check current movement path
-                                if (lineCircleIntersect(prev_mouse_x, prev_mouse_y, mouse_x, mouse_y,
-                                                        center_x, center_y, hit_radius))
-                                {
-                                    // Fruit hit by slice line!
-                                    gameObjects[i].sliced = 1;
-                                    sliced_objects[i] = 1;
-
-                                    // Initialize slice pieces
-                                    float sliceAngle = atan2(mouse_y - prev_mouse_y, mouse_x - prev_mouse_x);
-
-                                    // Create two pieces moving in different directions
-                                    for (int j = 0; j < SLICE_PIECES; j++)
-                                    {
-                                        gameObjects[i].pieces[j].x = center_x;
-                                        gameObjects[i].pieces[j].y = center_y;
-
-                                        // Different velocities for each piece
-                                        float pieceAngle = sliceAngle + (j == 0 ? M_PI / 2 : -M_PI / 2);
-                                        float speed = (2.0f + (rand() % 20) / 10.0f) * 1.5f; // 50% faster
-
-                                        gameObjects[i].pieces[j].vx = cos(pieceAngle) * speed;
-                                        gameObjects[i].pieces[j].vy = sin(pieceAngle) * speed + gameObjects[i].vy / 2;
-                                        gameObjects[i].pieces[j].rotation = gameObjects[i].rotation;
-                                        gameObjects[i].pieces[j].rotSpeed = gameObjects[i].rotSpeed * 2.0f * (j == 0 ? 1 : -1);
-                                        gameObjects[i].pieces[j].timeLeft = SLICE_DURATION;
-                                    }
-
-                                    if (gameObjects[i].type == BOMB)
-                                    {
-                                        // Play bomb sound
-                                        Mix_PlayChannel(-1, bombSound, 0);
-                                        // Reduce health when bomb is sliced
-                                        health--;
-                                        if (health <= 0)
-                                        {
-                                            printf("Game Over! Final score: %d\n", score);
-                                            health = 0; // Ensure health doesn't go below 0
-                                            game_state = STATE_GAME_OVER;
-                                            addScore(score);
-                                        }
-                                        // No score penalty for bombs
-                                        printf("Bomb sliced! Health: %d\n", health);
-                                    }
-                                    else
-                                    {
-                                        // Play slice sound
-                                        Mix_PlayChannel(-1, sliceSound, 0);
-                                        score += 1;
-                                        printf("Fruit sliced! Score: %d\n", score);
-                                    }
-                                }
-                            }
-                        }
-                    }
+        // Back button
+        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
+        SDL_Rect backButton = {WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT - 70, 100, 40};
+        SDL_RenderFillRect(renderer, &backButton);
 
-                    // Also check slice along multiple points on the path for very precise slicing
-                    int samples = 12; // Good balance of precision and performance
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &backButton);
 
-                    for (int t = 0; t <= samples; t++)
-                    {
-                        float lerp = (float)t / samples;
-                        int slice_x = prev_mouse_x + (mouse_x - prev_mouse_x) * lerp;
-                        int slice_y = prev_mouse_y + (mouse_y - prev_mouse_y) * lerp;
+        // Draw "BACK" text centered in button
+        int backWidth = strlen("BACK") * 12 + (strlen("BACK") - 1) * 2;
+        int backX = backButton.x + (backButton.w - backWidth) / 2;
+        int backY = backButton.y + (backButton.h - 20) / 2;
+        drawDigitalText(renderer, "BACK", backX, backY, 12, 20, 2);
+    }
+    drawScopePop();
 
-                        for (int i = 0; i < MAX_FRUITS; i++)
-                        {
-                            // Only process objects that haven't been sliced yet in this motion
-                            if (gameObjects[i].active && !gameObjects[i].sliced && !sliced_objects[i])
-                            {
-                                // Use improved collision detection function
-                                if (checkCollision(slice_x, slice_y, &gameObjects[i]))
-                                {
-                                    gameObjects[i].sliced = 1;
-                                    sliced_objects[i] = 1;
-
-                                    // Initialize slice pieces
-                                    float sliceAngle = atan2(mouse_y - prev_mouse_y, mouse_x - prev_mouse_x);
-                                    float center_x = gameObjects[i].x + FRUIT_SIZE / 2;
-                                    float center_y = gameObjects[i].y + FRUIT_SIZE / 2;
-
-                                    // Create two pieces moving in different directions
-                                    for (int j = 0; j < SLICE_PIECES; j++)
-                                    {
-                                        gameObjects[i].pieces[j].x = center_x;
-                                        gameObjects[i].pieces[j].y = center_y;
-
-                                        // Different velocities for each piece
-                                        float pieceAngle = sliceAngle + (j == 0 ? M_PI / 2 : -M_PI / 2);
-                                        float speed = (2.0f + (rand() % 20) / 10.0f) * 1.5f; // 50% faster
-
-                                        gameObjects[i].pieces[j].vx = cos(pieceAngle) * speed;
-                                        gameObjects[i].pieces[j].vy = sin(pieceAngle) * speed + gameObjects[i].vy / 2;
-                                        gameObjects[i].pieces[j].rotation = gameObjects[i].rotation;
-                                        gameObjects[i].pieces[j].rotSpeed = gameObjects[i].rotSpeed * 2.0f * (j == 0 ? 1 : -1);
-                                        gameObjects[i].pieces[j].timeLeft = SLICE_DURATION;
-                                    }
-
-                                    if (gameObjects[i].type == BOMB)
-                                    {
-                                        // Play bomb sound
-                                        Mix_PlayChannel(-1, bombSound, 0);
-                                        // Reduce health when bomb is sliced
-                                        health--;
-                                        if (health <= 0)
-                                        {
-                                            printf("Game Over! Final score: %d\n", score);
-                                            health = 0; // Ensure health doesn't go below 0
-                                            game_state = STATE_GAME_OVER;
-                                            addScore(score);
-                                        }
-                                        // No score penalty for bombs
-                                        printf("Bomb sliced! Health: %d\n", health);
-                                    }
-                                    else
-                                    {
-                                        // Play slice sound
-                                        Mix_PlayChannel(-1, sliceSound, 0);
-                                        score += 1;
-                                        printf("Fruit sliced! Score: %d\n", score);
-                                    }
-
-                                    // Don't break here - need to check remaining fruits
-                                }
-                            }
-                        }
-                    }
+    // Latency test flash patch goes on top of the game
+    drawLatencyPatch();
+
+    // Unlock mutex after rendering
+    unlockGameMutex();
+}
 
-                    pthread_mutex_unlock(&game_mutex);
+// Write the stream header for a capture file at fps frames per second (PPM streams have none)
+void writeVideoHeader(FILE *file, int is_y4m, int fps)
+{
+    if (is_y4m)
+    {
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", WINDOW_WIDTH, WINDOW_HEIGHT, fps);
+    }
+}
 
-                    // Set mouse_down to true for rendering the slice trail
-                    mouse_down = 1;
-                }
-                else
-                {
-                    // If mouse barely moved, don't show the slice trail
-                    mouse_down = 0;
-                }
-            }
-        }
-        else if (e.type == SDL_MOUSEBUTTONDOWN)
-        {
-            // Game over screen button clicks
-            if (game_state == STATE_GAME_OVER)
-            {
-                int mouseX = e.button.x;
-                int mouseY = e.button.y;
+// Append a frame already encoded into scratch by writeVideoFrame(), as it writes them
+void writeEncodedFrame(FILE *file, int is_y4m, const Uint8 *scratch)
+{
+    const int pixels = WINDOW_WIDTH * WINDOW_HEIGHT;
 
-                // Check if the click is on the "Restart" button
-                SDL_Rect restartButton = {WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 20, 100, 40};
-                if (mouseX >= restartButton.x && mouseX <= restartButton.x + restartButton.w &&
-                    mouseY >= restartButton.y && mouseY <= restartButton.y + restartButton.h)
-                {
-                    // Reset the game
-                    resetGame();
-                    return;
-                }
+    if (is_y4m)
+    {
+        fputs("FRAME\n", file);
+        fwrite(scratch, 1, pixels * 3 / 2, file);
+    }
+    else
+    {
+        fprintf(file, "P6\n%d %d\n255\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+        fwrite(scratch, 3, pixels, file);
+    }
+}
 
-                // Check if the click is on the "Leaderboard" button
-                SDL_Rect leaderboardButton = {WINDOW_WIDTH / 2 + 20, WINDOW_HEIGHT / 2 + 20, 100, 40};
-                if (mouseX >= leaderboardButton.x && mouseX <= leaderboardButton.x + leaderboardButton.w &&
-                    mouseY >= leaderboardButton.y && mouseY <= leaderboardButton.y + leaderboardButton.h)
-                {
-                    // Show leaderboard
-                    game_state = STATE_LEADERBOARD;
-                    return;
-                }
-            }
-            // Leaderboard screen back button click
-            else if (game_state == STATE_LEADERBOARD)
-            {
-                int mouseX = e.button.x;
-                int mouseY = e.button.y;
+// Encode one ARGB8888 frame and append it to a Y4M or raw PPM stream
+// scratch must hold WINDOW_WIDTH * WINDOW_HEIGHT * 3 bytes.
+void writeVideoFrame(FILE *file, int is_y4m, const Uint32 *argb, Uint8 *scratch)
+{
+    const int pixels = WINDOW_WIDTH * WINDOW_HEIGHT;
 
-                // Check if the click is on the "Back" button
-                SDL_Rect backButton = {WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT - 70, 100, 40};
-                if (mouseX >= backButton.x && mouseX <= backButton.x + backButton.w &&
-                    mouseY >= backButton.y && mouseY <= backButton.y + backButton.h)
-                {
-                    // Return to game over screen
-                    game_state = STATE_GAME_OVER;
-                    return;
-                }
-            }
+    if (!is_y4m)
+    {
+        // PPM: packed 8-bit RGB
+        for (int i = 0; i < pixels; i++)
+        {
+            scratch[i * 3] = argb[i] >> 16;
+            scratch[i * 3 + 1] = argb[i] >> 8;
+            scratch[i * 3 + 2] = argb[i];
         }
-        else if (e.type == SDL_KEYDOWN)
+        writeEncodedFrame(file, is_y4m, scratch);
+        return;
+    }
+
+    // Y4M: full-range BT.601 luma plane, then 2x2-subsampled chroma planes
+    Uint8 *y_plane = scratch;
+    Uint8 *u_plane = y_plane + pixels;
+    Uint8 *v_plane = u_plane + pixels / 4;
+
+    for (int i = 0; i < pixels; i++)
+    {
+        int r = (argb[i] >> 16) & 0xFF;
+        int g = (argb[i] >> 8) & 0xFF;
+        int b = argb[i] & 0xFF;
+        y_plane[i] = (77 * r + 150 * g + 29 * b) >> 8;
+    }
+
+    for (int y = 0; y < WINDOW_HEIGHT; y += 2)
+    {
+        for (int x = 0; x < WINDOW_WIDTH; x += 2)
         {
-            if (e.key.keysym.sym == SDLK_ESCAPE)
-            {
-                // In leaderboard state, go back to game over screen
-                if (game_state == STATE_LEADERBOARD)
-                {
-                    game_state = STATE_GAME_OVER;
-                }
-                else
-                {
-                    running = 0;
-                }
-            }
-            else if (e.key.keysym.sym == SDLK_r && game_state != STATE_PLAYING)
+            int r = 0, g = 0, b = 0;
+            for (int k = 0; k < 4; k++)
             {
-                // Reset game if not currently playing
-                resetGame();
+                Uint32 p = argb[(y + k / 2) * WINDOW_WIDTH + x + k % 2];
+                r += (p >> 16) & 0xFF;
+                g += (p >> 8) & 0xFF;
+                b += p & 0xFF;
             }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+
+            int c = (y / 2) * (WINDOW_WIDTH / 2) + x / 2;
+            u_plane[c] = 128 + ((-43 * r - 85 * g + 128 * b) >> 8);
+            v_plane[c] = 128 + ((128 * r - 107 * g - 21 * b) >> 8);
         }
     }
+
+    writeEncodedFrame(file, is_y4m, scratch);
 }
 
-// Update game state
-void updateGame()
+// Frame capture writer thread - encodes and writes queued frames
+void *frameCaptureWriter(void *arg)
 {
-    pthread_mutex_lock(&game_mutex);
+    (void)arg; // Unused parameter
+    nameThread("ninja-capture");
+    lowJitterThread(0);
+    FrameCapture *fc = &frame_capture;
 
-    // Only update game objects if the game is active
-    if (game_state == STATE_PLAYING)
+    pthread_mutex_lock(&fc->mutex);
+    while (1)
     {
-        // Update game timer
-        Uint32 current_time = SDL_GetTicks();
-        game_time = (current_time - start_time) / 1000; // Convert to seconds
+        while (fc->queued == 0 && !fc->stopping)
+        {
+            pthread_cond_wait(&fc->cond, &fc->mutex);
+        }
+        if (fc->queued == 0)
+        {
+            break; // Stopping and fully drained
+        }
 
-        // Check if game is over due to no health
-        if (health <= 0)
+        int buffer = fc->queue[fc->queue_head];
+        fc->queue_head = (fc->queue_head + 1) % CAPTURE_BUFFERS;
+        fc->queued--;
+        int holds = fc->holds[buffer];
+        pthread_mutex_unlock(&fc->mutex);
+
+        // scratch still has the previous frame, which stays on screen over missed refreshes
+        for (int i = 0; i < holds; i++)
         {
-            // Change game state and save score
-            game_state = STATE_GAME_OVER;
-            addScore(score);
+            writeEncodedFrame(fc->file, fc->is_y4m, fc->scratch);
         }
+        writeVideoFrame(fc->file, fc->is_y4m, fc->buffers[buffer], fc->scratch);
 
-        for (int i = 0; i < MAX_FRUITS; i++)
+        pthread_mutex_lock(&fc->mutex);
+        fc->free_list[fc->free_count++] = buffer;
+        fc->frames_written += holds + 1;
+        fc->frames_repeated += holds;
+    }
+    pthread_mutex_unlock(&fc->mutex);
+
+    return NULL;
+}
+
+// Open the capture file and start the writer thread
+// Files ending in .y4m get a YUV4MPEG2 stream, anything else a raw PPM stream.
+int startFrameCapture(const char *path)
+{
+    FrameCapture *fc = &frame_capture;
+    const char *ext = strrchr(path, '.');
+
+    fc->file = fopen(path, "wb");
+    if (fc->file == NULL)
+    {
+        perror("Failed to open capture file");
+        return 0;
+    }
+    fc->is_y4m = ext != NULL && strcmp(ext, ".y4m") == 0;
+
+    fc->scratch = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 3);
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    {
+        fc->buffers[i] = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(Uint32));
+        fc->free_list[i] = i;
+        if (fc->buffers[i] == NULL || fc->scratch == NULL)
         {
-            if (gameObjects[i].active)
-            {
-                // Update main fruit position
-                gameObjects[i].vy += 0.3f; // Increased gravity effect (was 0.2f)
-                gameObjects[i].x += gameObjects[i].vx;
-                gameObjects[i].y += gameObjects[i].vy;
-                gameObjects[i].rotation += gameObjects[i].rotSpeed;
+            printf("Failed to allocate capture buffers\n");
+            freeFrameCaptureBuffers();
+            fclose(fc->file);
+            fc->file = NULL;
+            return 0;
+        }
+    }
+    fc->free_count = CAPTURE_BUFFERS;
 
-                // Update slice pieces if sliced
-                if (gameObjects[i].sliced)
-                {
-                    for (int j = 0; j < SLICE_PIECES; j++)
-                    {
-                        if (gameObjects[i].pieces[j].timeLeft > 0)
-                        {
-                            gameObjects[i].pieces[j].vy += 0.45f; // Heavier gravity for pieces (was 0.3f)
-                            gameObjects[i].pieces[j].x += gameObjects[i].pieces[j].vx;
-                            gameObjects[i].pieces[j].y += gameObjects[i].pieces[j].vy;
-                            gameObjects[i].pieces[j].rotation += gameObjects[i].pieces[j].rotSpeed;
-                            gameObjects[i].pieces[j].timeLeft--;
-                        }
-                    }
-                }
+    pthread_mutex_init(&fc->mutex, NULL);
+    pthread_cond_init(&fc->cond, NULL);
 
-                // Check if out of bounds
-                if (gameObjects[i].y > WINDOW_HEIGHT + FRUIT_SIZE ||
-                    gameObjects[i].x < -FRUIT_SIZE ||
-                    gameObjects[i].x > WINDOW_WIDTH + FRUIT_SIZE)
-                {
-                    // Check if all animation is complete
-                    bool animationDone = true;
-                    if (gameObjects[i].sliced)
-                    {
-                        for (int j = 0; j < SLICE_PIECES; j++)
-                        {
-                            if (gameObjects[i].pieces[j].timeLeft > 0)
-                            {
-                                animationDone = false;
-                                break;
-                            }
-                        }
-                    }
+    // One frame per refresh; the writer repeats frames to cover missed ones
+    writeVideoHeader(fc->file, fc->is_y4m, (int)lround(1000.0 / frame_pacer.target_ms));
 
-                    if (animationDone)
-                    {
-                        gameObjects[i].active = 0;
+    if (pthread_create(&fc->thread, NULL, frameCaptureWriter, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create frame capture thread\n");
+        freeFrameCaptureBuffers();
+        pthread_cond_destroy(&fc->cond);
+        pthread_mutex_destroy(&fc->mutex);
+        fclose(fc->file);
+        fc->file = NULL;
+        return 0;
+    }
 
-                        // No penalty for missing a fruit - REMOVED
-                        // Just deactivate the fruit without affecting score
-                    }
-                }
-            }
+    fc->active = 1;
+    printf("Recording gameplay to %s (%s)\n", path, fc->is_y4m ? "Y4M" : "PPM stream");
+    return 1;
+}
+
+// Free the capture buffers and scratch space, whichever were allocated
+void freeFrameCaptureBuffers()
+{
+    FrameCapture *fc = &frame_capture;
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    {
+        free(fc->buffers[i]);
+        fc->buffers[i] = NULL;
+    }
+    free(fc->scratch);
+    fc->scratch = NULL;
+    fc->free_count = 0;
+}
+
+// Read back the frame about to be presented and hand it to the writer
+// Runs on the render thread. If the writer has fallen behind and no buffer
+// is free, the frame is dropped rather than waiting. The refreshes since the
+// last kept frame, including dropped ones, are passed along so the writer
+// can keep the video in real time.
+void captureFrame()
+{
+    FrameCapture *fc = &frame_capture;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    pthread_mutex_lock(&fc->mutex);
+    int buffer = fc->free_count > 0 ? fc->free_list[--fc->free_count] : -1;
+    if (buffer < 0)
+    {
+        fc->frames_dropped++;
+    }
+    pthread_mutex_unlock(&fc->mutex);
+
+    if (buffer >= 0)
+    {
+        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, fc->buffers[buffer],
+                             WINDOW_WIDTH * sizeof(Uint32));
+
+        int refreshes = 1;
+        if (fc->last_capture != 0)
+        {
+            double elapsed_ms = (start - fc->last_capture) * 1000.0 / SDL_GetPerformanceFrequency();
+            refreshes = (int)lround(elapsed_ms / frame_pacer.target_ms);
         }
+        fc->last_capture = start;
+
+        pthread_mutex_lock(&fc->mutex);
+        fc->holds[buffer] = refreshes > 1 ? refreshes - 1 : 0;
+        fc->queue[(fc->queue_head + fc->queued) % CAPTURE_BUFFERS] = buffer;
+        fc->queued++;
+        pthread_cond_signal(&fc->cond);
+        pthread_mutex_unlock(&fc->mutex);
     }
 
-    pthread_mutex_unlock(&game_mutex);
+    // Render thread cost, which should stay below CAPTURE_BUDGET_MS
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    fc->capture_ms_total += ms;
+    fc->frames_captured++;
+    if (ms > fc->capture_ms_max)
+    {
+        fc->capture_ms_max = ms;
+    }
+    if (ms > CAPTURE_BUDGET_MS)
+    {
+        fc->frames_over_budget++;
+    }
 }
 
-// Render the game
-void renderGame()
+// Flush remaining frames, stop the writer and report capture costs
+void stopFrameCapture()
 {
-    // Lock mutex before rendering
-    pthread_mutex_lock(&game_mutex);
+    FrameCapture *fc = &frame_capture;
+    if (!fc->active)
+    {
+        return;
+    }
+    fc->active = 0;
+
+    pthread_mutex_lock(&fc->mutex);
+    fc->stopping = 1;
+    pthread_cond_signal(&fc->cond);
+    pthread_mutex_unlock(&fc->mutex);
+    pthread_join(fc->thread, NULL);
+
+    fclose(fc->file);
+    freeFrameCaptureBuffers();
+    pthread_cond_destroy(&fc->cond);
+    pthread_mutex_destroy(&fc->mutex);
+
+    printf("Capture: %ld frames written (%ld of them repeats covering missed refreshes), %ld dropped\n",
+           fc->frames_written, fc->frames_repeated, fc->frames_dropped);
+    if (fc->frames_captured > 0)
+    {
+        printf("Capture: render thread cost avg %.3f ms, max %.3f ms, %ld frames over %.1f ms\n",
+               fc->capture_ms_total / fc->frames_captured, fc->capture_ms_max,
+               fc->frames_over_budget, CAPTURE_BUDGET_MS);
+    }
+}
 
-    // Clear screen
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+// Start recording the game state after every simulation step to a replay file
+int startReplayRecording(const char *path)
+{
+    ReplayRecorder *rr = &replay_recorder;
 
-    // Draw background
-    SDL_RenderCopy(renderer, background_texture, NULL, NULL);
+    rr->file = fopen(path, "wb");
+    if (rr->file == NULL)
+    {
+        perror("Failed to open replay file");
+        return 0;
+    }
 
-    // ===== Draw Score Panel =====
-    // Create a nice-looking score panel in top-left
-    for (int i = 0; i < 40; i++)
+    memset(&rr->header, 0, sizeof(rr->header));
+    memcpy(rr->header.magic, REPLAY_MAGIC, sizeof(rr->header.magic));
+    rr->header.background_seed = background_seed;
+    rr->header.fps = (uint32_t)lround(1000.0 / SIM_STEP_MS);
+    fwrite(&rr->header, sizeof(rr->header), 1, rr->file);
+    rr->offset = sizeof(rr->header);
+
+    for (int i = 0; i < REPLAY_BUFFERS; i++)
     {
-        int alpha = 180 - i * 3;
-        if (alpha < 0)
-            alpha = 0;
-        SDL_SetRenderDrawColor(renderer, 30, 30, 60, alpha);
-        SDL_Rect scoreGradient = {10, 10 + i, 120, 1};
-        SDL_RenderFillRect(renderer, &scoreGradient);
+        rr->free_list[i] = i;
     }
+    rr->free_count = REPLAY_BUFFERS;
+    pthread_mutex_init(&rr->mutex, NULL);
+    pthread_cond_init(&rr->cond, NULL);
 
-    // Main score box
-    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
-    SDL_Rect scoreRect = {10, 10, 140, 40}; // Increased width from 120 to 140
-    SDL_RenderFillRect(renderer, &scoreRect);
+    if (pthread_create(&rr->thread, NULL, replayWriter, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create replay writer thread\n");
+        pthread_cond_destroy(&rr->cond);
+        pthread_mutex_destroy(&rr->mutex);
+        fclose(rr->file);
+        rr->file = NULL;
+        return 0;
+    }
 
-    // Border for score box
-    SDL_SetRenderDrawColor(renderer, 200, 150, 100, 255); // Changed color from blue to amber
-    SDL_Rect scoreBorder = {10, 10, 140, 40};             // Increased width from 120 to 140
-    SDL_RenderDrawRect(renderer, &scoreBorder);
+    rr->active = 1;
+    printf("Recording replay to %s\n", path);
+    return 1;
+}
 
-    // Draw score text
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+// Hand this simulation step's state to the replay writer
+// Called from updateGame() with game_mutex held; costs one copy of the
+// objects. If the writer has fallen REPLAY_BUFFERS steps behind, the step is
+// dropped rather than waited for, leaving a gap in the recorded step numbers.
+void recordReplayStep()
+{
+    ReplayRecorder *rr = &replay_recorder;
+    uint32_t step = rr->steps++;
 
-    // Display score number (simplistic digital-style)
-    char scoreStr[20];
-    sprintf(scoreStr, "%d", score);
-    int digitWidth = 10; // Reduced from 12 to 10
+    pthread_mutex_lock(&rr->mutex);
+    int buffer = rr->free_count > 0 ? rr->free_list[--rr->free_count] : -1;
+    if (buffer < 0)
+    {
+        rr->frames_dropped++;
+    }
+    pthread_mutex_unlock(&rr->mutex);
+    if (buffer < 0)
+    {
+        return;
+    }
 
-    // Calculate position to center score in its box
-    int scoreDigits = strlen(scoreStr);
-    int digitSpacing = 4; // Increased spacing between digits (was 2)
-    int totalScoreWidth = scoreDigits * digitWidth + (scoreDigits - 1) * digitSpacing;
-    int digitX = scoreRect.x + (scoreRect.w - totalScoreWidth) / 2;
-    int digitY = scoreRect.y + (scoreRect.h - 18) / 2; // Center vertically (18 is digit height)
+    StateSnapshot *snapshot = &rr->snapshots[buffer];
+    snapshot->tick = step;
+    snapshot->frame = currentReplayFrame();
+    memcpy(snapshot->objects, gameObjects, sizeof(gameObjects));
 
-    // Set drawing color back to white for the score display
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    pthread_mutex_lock(&rr->mutex);
+    rr->queue[(rr->queue_head + rr->queued) % REPLAY_BUFFERS] = buffer;
+    rr->queued++;
+    pthread_cond_signal(&rr->cond);
+    pthread_mutex_unlock(&rr->mutex);
+}
 
-    // Display score as a digital-style number
-    for (int i = 0; scoreStr[i] != '\0'; i++)
+// Append one snapshot to the replay file, indexing every REPLAY_KEYFRAME_INTERVAL'th
+// Every frame is stored in full, so each indexed frame doubles as a keyframe
+// a renderer can seek to. Returns 0 on a write error.
+int writeReplayFrame(ReplayRecorder *rr, StateSnapshot *snapshot)
+{
+    if (rr->header.frame_count % REPLAY_KEYFRAME_INTERVAL == 0)
     {
-        int digit = scoreStr[i] - '0';
+        if (rr->header.index_count == rr->index_capacity)
+        {
+            uint32_t capacity = rr->index_capacity ? rr->index_capacity * 2 : 256;
+            uint64_t *index = realloc(rr->index, capacity * sizeof(uint64_t));
+            if (index == NULL)
+            {
+                printf("Replay index full, stopping replay recording\n");
+                return 0;
+            }
+            rr->index = index;
+            rr->index_capacity = capacity;
+        }
+        rr->index[rr->header.index_count++] = rr->offset;
+    }
 
-        // Simple digital rendering - rectangles for each segment
-        // Adjust positioning based on digit
-        SDL_Rect segments[7]; // 7 segments in a digital display
+    ReplayFrame *frame = &snapshot->frame;
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        if (snapshot->objects[i].active)
+        {
+            frame->object_count++;
+        }
+    }
 
-        // Initialize segments to off position
-        for (int s = 0; s < 7; s++)
+    uint32_t step = snapshot->tick;
+    size_t written = fwrite(&step, sizeof(step), 1, rr->file);
+    written += fwrite(frame, sizeof(*frame), 1, rr->file);
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        if (snapshot->objects[i].active)
         {
-            segments[s].x = digitX + i * (digitWidth + digitSpacing);
-            segments[s].y = digitY;
-            segments[s].w = 8;
-            segments[s].h = 2;
+            ReplayObject object = {i, snapshot->objects[i]};
+            written += fwrite(&object, sizeof(object), 1, rr->file);
         }
+    }
+    if (written != (size_t)frame->object_count + 2)
+    {
+        perror("Failed to write replay");
+        return 0;
+    }
 
-        // Horizontal segments
-        segments[0].y = digitY;      // Top
-        segments[3].y = digitY + 8;  // Middle
-        segments[6].y = digitY + 16; // Bottom
+    rr->offset += sizeof(step) + sizeof(*frame) + frame->object_count * sizeof(ReplayObject);
+    rr->header.frame_count++;
+    return 1;
+}
 
-        // Vertical segments
-        segments[1].x = digitX + i * (digitWidth + digitSpacing) + 8; // Top right
-        segments[1].y = digitY;
-        segments[1].w = 2;
-        segments[1].h = 8;
+// Writer thread: write queued frames to the replay file in order
+void *replayWriter(void *arg)
+{
+    (void)arg; // Unused parameter
+    ReplayRecorder *rr = &replay_recorder;
+    nameThread("ninja-replay");
+    lowJitterThread(0);
+    TRACE_THREAD_NAME("ninja-replay");
+
+    pthread_mutex_lock(&rr->mutex);
+    while (1)
+    {
+        while (rr->queued == 0 && !rr->stopping)
+        {
+            pthread_cond_wait(&rr->cond, &rr->mutex);
+        }
+        if (rr->queued == 0)
+        {
+            break; // Stopping, and everything recorded has been written
+        }
+
+        int buffer = rr->queue[rr->queue_head];
+        rr->queue_head = (rr->queue_head + 1) % REPLAY_BUFFERS;
+        rr->queued--;
+        pthread_mutex_unlock(&rr->mutex);
+
+        if (!rr->failed && !writeReplayFrame(rr, &rr->snapshots[buffer]))
+        {
+            rr->failed = 1;
+        }
+
+        pthread_mutex_lock(&rr->mutex);
+        rr->free_list[rr->free_count++] = buffer;
+    }
+    pthread_mutex_unlock(&rr->mutex);
+    return NULL;
+}
+
+// Finish writing, then write the keyframe index and the final replay header
+void stopReplayRecording()
+{
+    ReplayRecorder *rr = &replay_recorder;
+    if (rr->file == NULL)
+    {
+        return;
+    }
+    rr->active = 0;
+
+    pthread_mutex_lock(&rr->mutex);
+    rr->stopping = 1;
+    pthread_cond_signal(&rr->cond);
+    pthread_mutex_unlock(&rr->mutex);
+    pthread_join(rr->thread, NULL);
+    pthread_cond_destroy(&rr->cond);
+    pthread_mutex_destroy(&rr->mutex);
+
+    rr->header.step_count = rr->steps;
+    rr->header.index_offset = rr->offset;
+    fwrite(rr->index, sizeof(uint64_t), rr->header.index_count, rr->file);
+    fseek(rr->file, 0, SEEK_SET);
+    fwrite(&rr->header, sizeof(rr->header), 1, rr->file);
+    fclose(rr->file);
+    rr->file = NULL;
+
+    free(rr->index);
+    rr->index = NULL;
+    printf("Replay saved: %u of %u steps at %u per second, %ld dropped because the writer fell behind%s\n",
+           rr->header.frame_count, rr->header.step_count, rr->header.fps, rr->frames_dropped,
+           rr->failed ? " (stopped early by an error)" : "");
+}
+
+// The score, timer, state and blade as a replay frame, with no objects counted yet
+ReplayFrame currentReplayFrame()
+{
+    ReplayFrame frame = {score, health, game_time, game_state,
+                         mouse_x, mouse_y, prev_mouse_x, prev_mouse_y, mouse_down, 0};
+    return frame;
+}
+
+// Set the score, timer, state and blade from a replay frame
+void applyReplayFrame(const ReplayFrame *frame)
+{
+    score = frame->score;
+    health = frame->health;
+    game_time = frame->game_time;
+    game_state = frame->game_state;
+    mouse_x = frame->mouse_x;
+    mouse_y = frame->mouse_y;
+    prev_mouse_x = frame->prev_mouse_x;
+    prev_mouse_y = frame->prev_mouse_y;
+    mouse_down = frame->mouse_down;
+}
+
+// Load the next replay frame into the game globals and its step number into step, 0 at end of file
+int loadReplayFrame(FILE *file, uint32_t *step)
+{
+    ReplayFrame frame;
+    if (fread(step, sizeof(*step), 1, file) != 1 || fread(&frame, sizeof(frame), 1, file) != 1)
+    {
+        return 0;
+    }
+    applyReplayFrame(&frame);
+
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        gameObjects[i].active = 0;
+    }
+    for (int i = 0; i < frame.object_count; i++)
+    {
+        ReplayObject object;
+        if (fread(&object, sizeof(object), 1, file) != 1 || object.slot < 0 || object.slot >= MAX_FRUITS)
+        {
+            return 0;
+        }
+        gameObjects[object.slot] = object.object;
+    }
+
+    return 1;
+}
+
+// Write one rendered step of a replay to a video segment, or to a PPM image numbered by step
+int writeReplayOutput(FILE *segment, const char *out, uint32_t step, const Uint32 *pixels, Uint8 *scratch)
+{
+    if (segment != NULL)
+    {
+        writeVideoFrame(segment, 1, pixels, scratch);
+        return 1;
+    }
+
+    char image_path[512];
+    snprintf(image_path, sizeof(image_path), "%s/frame_%06u.ppm", out, step);
+    FILE *image = fopen(image_path, "wb");
+    if (image == NULL)
+    {
+        perror("Failed to open output image");
+        return 0;
+    }
+    writeVideoFrame(image, 0, pixels, scratch);
+    fclose(image);
+    return 1;
+}
+
+// Worker process: render frames [start, end) of a replay headlessly
+// Seeks to the keyframe before the segment and renders a short pre-roll
+// without output so the blade trail has its history. Frames go either to
+// PPM images numbered by step or to a headerless Y4M segment for stitching.
+// Steps dropped while recording are filled with repeats of the frame before
+// them, so the output keeps the game's timing.
+int renderReplaySegment(const char *replay_path, const ReplayHeader *header, const uint64_t *index,
+                        int start, int end, const char *out, int is_video, int job)
+{
+    FILE *replay = fopen(replay_path, "rb");
+    if (replay == NULL)
+    {
+        return 1;
+    }
 
-        segments[2].x = digitX + i * (digitWidth + digitSpacing) + 8; // Bottom right
-        segments[2].y = digitY + 8;
-        segments[2].w = 2;
-        segments[2].h = 8;
+    // Offscreen software renderer - no window or GPU needed
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL)
+    {
+        printf("Job %d: renderer could not be created! SDL Error: %s\n", job, SDL_GetError());
+        fclose(replay);
+        return 1;
+    }
+    pthread_mutex_init(&game_mutex, NULL);
+    background_seed = header->background_seed;
+    createBackground();
 
-        segments[4].x = digitX + i * (digitWidth + digitSpacing); // Top left
-        segments[4].y = digitY;
-        segments[4].w = 2;
-        segments[4].h = 8;
+    Uint32 *pixels = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(Uint32));
+    Uint8 *scratch = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 3);
+    FILE *segment = NULL;
+    if (is_video)
+    {
+        char segment_path[512];
+        snprintf(segment_path, sizeof(segment_path), "%s.part%d", out, job);
+        segment = fopen(segment_path, "wb");
+    }
+    if (pixels == NULL || scratch == NULL || (is_video && segment == NULL))
+    {
+        fclose(replay);
+        return 1;
+    }
 
-        segments[5].x = digitX + i * (digitWidth + digitSpacing); // Bottom left
-        segments[5].y = digitY + 8;
-        segments[5].w = 2;
-        segments[5].h = 8;
+    int keyframe = (start > REPLAY_PREROLL ? start - REPLAY_PREROLL : 0) / REPLAY_KEYFRAME_INTERVAL;
+    fseek(replay, (long)index[keyframe], SEEK_SET);
 
-        // Define which segments are on for each digit
-        bool segmentOn[10][7] = {
-            {1, 1, 1, 0, 1, 1, 1}, // 0
-            {0, 1, 1, 0, 0, 0, 0}, // 1
-            {1, 1, 0, 1, 0, 1, 1}, // 2
-            {1, 1, 1, 1, 0, 0, 1}, // 3
-            {0, 1, 1, 1, 1, 0, 0}, // 4
-            {1, 0, 1, 1, 1, 0, 1}, // 5
-            {1, 0, 1, 1, 1, 1, 1}, // 6
-            {1, 1, 1, 0, 0, 0, 0}, // 7
-            {1, 1, 1, 1, 1, 1, 1}, // 8
-            {1, 1, 1, 1, 1, 0, 1}  // 9
-        };
+    int status = 0;
+    long previous_step = -1;
+    for (int frame = keyframe * REPLAY_KEYFRAME_INTERVAL; frame < end && status == 0; frame++)
+    {
+        uint32_t step;
+        if (!loadReplayFrame(replay, &step))
+        {
+            printf("Job %d: replay ended early at frame %d\n", job, frame);
+            status = 1;
+            break;
+        }
 
-        // Render the active segments for this digit
-        for (int s = 0; s < 7; s++)
+        // Hold the previous frame, still in pixels, over any dropped steps
+        if (frame >= start && frame > 0)
         {
-            if (segmentOn[digit][s])
+            for (long held = previous_step + 1; held < step && status == 0; held++)
             {
-                SDL_RenderFillRect(renderer, &segments[s]);
+                status = !writeReplayOutput(segment, out, (uint32_t)held, pixels, scratch);
             }
         }
+        previous_step = step;
+
+        renderGame();
+        if (frame < start - 1)
+        {
+            continue; // Pre-roll
+        }
+
+        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, pixels, WINDOW_WIDTH * sizeof(Uint32));
+        if (frame >= start && !writeReplayOutput(segment, out, step, pixels, scratch))
+        {
+            status = 1;
+        }
     }
 
-    // ===== Draw Timer in top-middle =====
-    int minutes = game_time / 60;
-    int seconds = game_time % 60;
+    // The last segment also holds its final frame over steps dropped at the very end
+    if (end == (int)header->frame_count)
+    {
+        for (long held = previous_step + 1; held < header->step_count && status == 0; held++)
+        {
+            status = !writeReplayOutput(segment, out, (uint32_t)held, pixels, scratch);
+        }
+    }
 
-    // Timer background
-    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
-    SDL_Rect timerRect = {WINDOW_WIDTH / 2 - 60, 10, 120, 50}; // Increased width from 100 to 120
-    SDL_RenderFillRect(renderer, &timerRect);
+    if (segment != NULL)
+    {
+        fclose(segment);
+    }
+    free(scratch);
+    free(pixels);
+    fclose(replay);
+    return status;
+}
 
-    // Timer border
-    SDL_SetRenderDrawColor(renderer, 100, 200, 100, 255);
-    SDL_Rect timerBorder = {WINDOW_WIDTH / 2 - 60, 10, 120, 50}; // Increased width from 100 to 120
-    SDL_RenderDrawRect(renderer, &timerBorder);
+// Tool mode: render a replay to an image sequence or a Y4M video
+// Splits the frames into equal time ranges, forks one worker process per
+// range and, for video output, stitches the segments together at the end.
+int renderReplay(const char *replay_path, const char *out, int jobs)
+{
+    FILE *replay = fopen(replay_path, "rb");
+    if (replay == NULL)
+    {
+        perror("Failed to open replay");
+        return 1;
+    }
 
-    // Display timer as MM:SS
-    char timeStr[10];
-    sprintf(timeStr, "%02d:%02d", minutes, seconds);
+    ReplayHeader header;
+    if (fread(&header, sizeof(header), 1, replay) != 1 ||
+        memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.index_count == 0 || header.fps == 0 || header.step_count < header.frame_count)
+    {
+        printf("%s is not a complete replay file\n", replay_path);
+        fclose(replay);
+        return 1;
+    }
 
-    // Improved timer rendering with better digital display
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    uint64_t *index = malloc(header.index_count * sizeof(uint64_t));
+    fseek(replay, (long)header.index_offset, SEEK_SET);
+    if (index == NULL || fread(index, sizeof(uint64_t), header.index_count, replay) != header.index_count)
+    {
+        printf("Could not read replay index\n");
+        free(index);
+        fclose(replay);
+        return 1;
+    }
+    fclose(replay);
 
-    // Calculate position to center timer text
-    int timerDigitWidth = 10; // Increased for better visibility
-    int digitHeight = 30;     // Increased for better visibility
-    int segmentThickness = 3; // Thicker segments
+    const char *ext = strrchr(out, '.');
+    int is_video = ext != NULL && strcmp(ext, ".y4m") == 0;
+    if (!is_video && mkdir(out, 0755) != 0 && errno != EEXIST)
+    {
+        perror("Failed to create output directory");
+        free(index);
+        return 1;
+    }
 
-    // Calculate width of timer text (5 characters plus spacing)
-    int timerSpacing = 4;                                        // Increased spacing between digits (was 2)
-    int timerTextWidth = 5 * timerDigitWidth + 4 * timerSpacing; // 5 chars (MM:SS) with 4px spacing between each
-    int timeX = WINDOW_WIDTH / 2 - timerTextWidth / 2;
-    int timeY = timerRect.y + (timerRect.h - digitHeight) / 2; // Center vertically
+    if (jobs <= 0)
+    {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if ((uint32_t)jobs > header.frame_count)
+    {
+        jobs = (int)header.frame_count;
+    }
+    if (jobs < 1)
+    {
+        jobs = 1;
+    }
 
-    // Draw each character in the time string with improved digital segments
-    for (int i = 0; timeStr[i] != '\0'; i++)
+    printf("Rendering %u frames (%u recorded, the rest held over dropped steps) from %s with %d jobs\n",
+           header.step_count, header.frame_count, replay_path, jobs);
+    fflush(stdout);
+    Uint64 start_time = SDL_GetPerformanceCounter();
+
+    pid_t *workers = malloc(jobs * sizeof(pid_t));
+    if (workers == NULL)
     {
-        if (timeStr[i] == ':')
+        printf("Out of memory for %d render jobs\n", jobs);
+        free(index);
+        return 1;
+    }
+    for (int job = 0; job < jobs; job++)
+    {
+        int start = (long)header.frame_count * job / jobs;
+        int end = (long)header.frame_count * (job + 1) / jobs;
+
+        workers[job] = fork();
+        if (workers[job] == -1)
         {
-            // Draw colon with larger dots
-            int dotSize = digitHeight / 5;
-            int dotY1 = timeY + digitHeight / 3 - dotSize / 2;
-            int dotY2 = timeY + 2 * digitHeight / 3 - dotSize / 2;
-            SDL_Rect colon1 = {timeX + i * (timerDigitWidth + timerSpacing), dotY1, dotSize, dotSize};
-            SDL_Rect colon2 = {timeX + i * (timerDigitWidth + timerSpacing), dotY2, dotSize, dotSize};
-            SDL_RenderFillRect(renderer, &colon1);
-            SDL_RenderFillRect(renderer, &colon2);
+            perror("Fork failed");
+            exit(EXIT_FAILURE);
         }
-        else
+        if (workers[job] == 0)
         {
-            // Convert character to digit
-            int digit = timeStr[i] - '0';
-            int x = timeX + i * (timerDigitWidth + timerSpacing);
-            int y = timeY;
+            // Child process renders its range and exits
+            int status = renderReplaySegment(replay_path, &header, index, start, end, out, is_video, job);
+            fflush(stdout);
+            _exit(status);
+        }
+    }
 
-            // Arrays to define which segments are on for each digit (7-segment display)
-            // Segments: 0=top, 1=top-right, 2=bottom-right, 3=bottom, 4=bottom-left, 5=top-left, 6=middle
-            bool segments[10][7] = {
-                {1, 1, 1, 1, 1, 1, 0}, // 0
-                {0, 1, 1, 0, 0, 0, 0}, // 1
-                {1, 1, 0, 1, 1, 0, 1}, // 2
-                {1, 1, 1, 1, 0, 0, 1}, // 3
-                {0, 1, 1, 0, 0, 1, 1}, // 4
-                {1, 0, 1, 1, 0, 1, 1}, // 5
-                {1, 0, 1, 1, 1, 1, 1}, // 6
-                {1, 1, 1, 0, 0, 0, 0}, // 7
-                {1, 1, 1, 1, 1, 1, 1}, // 8
-                {1, 1, 1, 1, 0, 1, 1}  // 9
-            };
+    int failed = 0;
+    for (int job = 0; job < jobs; job++)
+    {
+        int status;
+        if (waitpid(workers[job], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            printf("Render job %d failed\n", job);
+            failed = 1;
+        }
+    }
+    free(workers);
+    free(index);
 
-            // Define coordinates for each segment
-            SDL_Rect segs[7];
+    // Stitch the video segments in order behind a single stream header
+    if (is_video && !failed)
+    {
+        FILE *video = fopen(out, "wb");
+        if (video == NULL)
+        {
+            perror("Failed to open output video");
+            return 1;
+        }
+        writeVideoHeader(video, 1, header.fps);
 
-            // Horizontal segments (top, middle, bottom)
-            segs[0] = (SDL_Rect){x, y, timerDigitWidth, segmentThickness}; // Top
+        char buffer[65536];
+        for (int job = 0; job < jobs; job++)
+        {
+            char segment_path[512];
+            snprintf(segment_path, sizeof(segment_path), "%s.part%d", out, job);
+            FILE *segment = fopen(segment_path, "rb");
+            if (segment == NULL)
+            {
+                failed = 1;
+                break;
+            }
+            size_t bytes;
+            while ((bytes = fread(buffer, 1, sizeof(buffer), segment)) > 0)
+            {
+                fwrite(buffer, 1, bytes, video);
+            }
+            fclose(segment);
+            remove(segment_path);
+        }
+        fclose(video);
+    }
 
-            // Define local variables needed for rendering
-            int digitHeight = 30;                // Height of the digit
-            int digitWidth = timerDigitWidth;    // Use existing width
-            int segThickness = segmentThickness; // Use existing thickness
+    double seconds = (SDL_GetPerformanceCounter() - start_time) / (double)SDL_GetPerformanceFrequency();
+    double played = header.step_count / (double)header.fps;
+    printf("Rendered %.1f s of gameplay in %.1f s (%.1fx real time) to %s\n",
+           played, seconds, seconds > 0 ? played / seconds : 0.0, out);
 
-            segs[6] = (SDL_Rect){x, y + digitHeight / 2 - segThickness / 2, digitWidth, segThickness}; // Middle
-            segs[3] = (SDL_Rect){x, y + digitHeight - segThickness, digitWidth, segThickness};         // Bottom
+    return failed;
+}
 
-            // Vertical segments (top-right, bottom-right, bottom-left, top-left)
-            segs[1] = (SDL_Rect){x + digitWidth - segThickness, y, segThickness, digitHeight / 2};                   // Top-right
-            segs[2] = (SDL_Rect){x + digitWidth - segThickness, y + digitHeight / 2, segThickness, digitHeight / 2}; // Bottom-right
-            segs[4] = (SDL_Rect){x, y + digitHeight / 2, segThickness, digitHeight / 2};                             // Bottom-left
-            segs[5] = (SDL_Rect){x, y, segThickness, digitHeight / 2};                                               // Top-left
+// Open the spectator socket and start the encoder thread
+int startSpectatorStream()
+{
+    SpectatorStream *ss = &spectator_stream;
+    if (ss->path == NULL)
+    {
+        return 0;
+    }
 
-            // Draw the active segments for this digit
-            for (int s = 0; s < 7; s++)
-            {
-                if (segments[digit][s])
-                {
-                    SDL_RenderFillRect(renderer, &segs[s]);
-                }
-            }
-        }
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(ss->path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Spectator socket path too long: %s\n", ss->path);
+        return 0;
     }
+    strcpy(addr.sun_path, ss->path);
 
-    // ===== Draw Health Hearts in top-right =====
-    // Health background
-    SDL_SetRenderDrawColor(renderer, 30, 30, 60, 180);
-    SDL_Rect healthRect = {WINDOW_WIDTH - 150, 10, 140, 40}; // Updated to match scoreRect dimensions
-    SDL_RenderFillRect(renderer, &healthRect);
+    ss->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ss->listen_fd < 0)
+    {
+        perror("Failed to create spectator socket");
+        return 0;
+    }
+    unlink(ss->path); // Left over from a previous run
+    if (bind(ss->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(ss->listen_fd, 8) != 0)
+    {
+        perror("Failed to open spectator socket");
+        close(ss->listen_fd);
+        ss->listen_fd = -1;
+        return 0;
+    }
 
-    // Health border
-    SDL_SetRenderDrawColor(renderer, 200, 100, 100, 255);
-    SDL_Rect healthBorder = {WINDOW_WIDTH - 150, 10, 140, 40}; // Updated to match scoreRect dimensions
-    SDL_RenderDrawRect(renderer, &healthBorder);
+    for (int i = 0; i < SPECTATE_BUFFERS; i++)
+    {
+        ss->free_list[i] = i;
+    }
+    ss->free_count = SPECTATE_BUFFERS;
+    pthread_mutex_init(&ss->mutex, NULL);
+    pthread_cond_init(&ss->cond, NULL);
 
-    // Draw hearts
-    // Calculate total width of all hearts with spacing between them
-    int heartWidth = 16;   // Approximate width of a heart
-    int heartSpacing = 25; // Space between hearts
-    int totalHeartsWidth = (3 * heartWidth) + (2 * heartSpacing);
-    int startX = healthRect.x + (healthRect.w - totalHeartsWidth) / 2 + 7; // Center hearts horizontally
+    if (pthread_create(&ss->thread, NULL, spectatorEncoder, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create spectator encoder thread\n");
+        close(ss->listen_fd);
+        ss->listen_fd = -1;
+        unlink(ss->path);
+        return 0;
+    }
 
-    for (int i = 0; i < 3; i++)
+    ss->active = 1;
+    printf("Spectator stream: listening on %s\n", ss->path);
+    return 1;
+}
+
+// Hand this simulation step's state to the spectator encoder
+// Called from updateGame() with game_mutex held. Costs one copy of the
+// objects, and nothing at all while nobody is watching. If the encoder still
+// has every snapshot the step is dropped rather than waited for; spectators
+// are sent deltas from what they have, so they just see the next one.
+void publishSpectatorTick()
+{
+    SpectatorStream *ss = &spectator_stream;
+    ss->ticks++;
+    if (__atomic_load_n(&ss->watching, __ATOMIC_RELAXED) == 0)
     {
-        if (i < health)
-        {
-            // Full heart - red
-            SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255);
-        }
-        else
-        {
-            // Empty heart - gray outline
-            SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
-        }
+        return;
+    }
 
-        // Draw a heart shape - simplified
-        int heartX = startX + i * (heartWidth + heartSpacing);
-        int heartY = healthRect.y + healthRect.h / 2; // Center hearts vertically in the box
+    pthread_mutex_lock(&ss->mutex);
+    int buffer = ss->free_count > 0 ? ss->free_list[--ss->free_count] : -1;
+    pthread_mutex_unlock(&ss->mutex);
+    if (buffer < 0)
+    {
+        ss->ticks_dropped++;
+        return;
+    }
 
-        // Draw heart shape (very simplified)
-        SDL_Point heartPoints[] = {
-            {heartX, heartY + 5},
-            {heartX - 8, heartY - 3},
-            {heartX - 4, heartY - 7},
-            {heartX, heartY - 2},
-            {heartX + 4, heartY - 7},
-            {heartX + 8, heartY - 3},
-            {heartX, heartY + 5}};
+    StateSnapshot *snapshot = &ss->snapshots[buffer];
+    snapshot->tick = ss->ticks;
+    snapshot->frame = currentReplayFrame();
+    memcpy(snapshot->objects, gameObjects, sizeof(gameObjects));
 
-        SDL_RenderDrawLines(renderer, heartPoints, 7);
+    pthread_mutex_lock(&ss->mutex);
+    ss->queue[(ss->queue_head + ss->queued) % SPECTATE_BUFFERS] = buffer;
+    ss->queued++;
+    pthread_cond_signal(&ss->cond);
+    pthread_mutex_unlock(&ss->mutex);
+}
 
-        // Fill heart if it's a full heart
-        if (i < health)
+// Encode the message taking a spectator from its baseline to snapshot into client->out
+// A spectator without a baseline gets a keyframe of every live object. Otherwise
+// only slots that spawned, despawned or changed are sent, and a changed object
+// only carries the words that differ, usually its position, velocity and angle.
+int encodeSpectatorMessage(SpectatorClient *client, const StateSnapshot *snapshot)
+{
+    SpectateHeader header = {SPECTATE_MAGIC, client->has_baseline ? SPECTATE_DELTA : SPECTATE_KEYFRAME,
+                             snapshot->tick, 0, 0, background_seed, snapshot->frame};
+    uint8_t *out = client->out + sizeof(header);
+
+    for (int i = 0; i < MAX_FRUITS; i++)
+    {
+        const GameObject *now = &snapshot->objects[i];
+        const GameObject *then = &client->baseline[i];
+        int was_active = client->has_baseline && then->active;
+
+        if (!now->active)
         {
-            for (int y = heartY - 6; y <= heartY + 4; y++)
-            {
-                for (int x = heartX - 7; x <= heartX + 7; x++)
-                {
-                    // Simple formula to check if point is inside heart shape
-                    int dx = x - heartX;
-                    int dy = y - heartY;
-                    if ((dx * dx + dy * dy) < 50 && y <= heartY + 5)
-                    {
-                        SDL_RenderDrawPoint(renderer, x, y);
-                    }
-                }
+            if (was_active)
+            {
+                *out++ = i;
+                *out++ = SPECTATE_OBJ_GONE;
+                header.records++;
             }
+            continue;
         }
-    }
+        header.frame.object_count++;
 
-    // Draw each game object
-    for (int i = 0; i < MAX_FRUITS; i++)
-    {
-        if (gameObjects[i].active)
+        if (!was_active)
+        {
+            *out++ = i;
+            *out++ = SPECTATE_OBJ_FULL;
+            memcpy(out, now, sizeof(*now));
+            out += sizeof(*now);
+            header.records++;
+            continue;
+        }
+
+        uint32_t now_words[SPECTATE_OBJECT_WORDS], then_words[SPECTATE_OBJECT_WORDS];
+        memcpy(now_words, now, sizeof(now_words));
+        memcpy(then_words, then, sizeof(then_words));
+        uint32_t mask = 0;
+        for (unsigned int w = 0; w < SPECTATE_OBJECT_WORDS; w++)
         {
-            if (!gameObjects[i].sliced)
+            if (now_words[w] != then_words[w])
             {
-                // Draw unsliced fruit/bomb
-                drawFruit(gameObjects[i].type, gameObjects[i].x, gameObjects[i].y,
-                          gameObjects[i].rotation, 0);
+                mask |= 1u << w;
             }
-            else
+        }
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        *out++ = i;
+        *out++ = SPECTATE_OBJ_DELTA;
+        memcpy(out, &mask, sizeof(mask));
+        out += sizeof(mask);
+        for (unsigned int w = 0; w < SPECTATE_OBJECT_WORDS; w++)
+        {
+            if (mask & (1u << w))
             {
-                // Draw sliced pieces if they still have time left
-                for (int j = 0; j < SLICE_PIECES; j++)
-                {
-                    if (gameObjects[i].pieces[j].timeLeft > 0)
-                    {
-                        drawFruit(gameObjects[i].type,
-                                  gameObjects[i].pieces[j].x,
-                                  gameObjects[i].pieces[j].y,
-                                  gameObjects[i].pieces[j].rotation, 1);
-                    }
-                }
+                memcpy(out, &now_words[w], sizeof(uint32_t));
+                out += sizeof(uint32_t);
             }
         }
+        header.records++;
     }
 
-    // Draw slicing effect when mouse is down
-    if (mouse_down && (prev_mouse_x != mouse_x || prev_mouse_y != mouse_y))
-    {
-        // Create dynamic slice trail
-        static float trailOpacity[15] = {0}; // Increased from 10 to 15 for longer trail
-        static int trailX[15] = {0};         // X positions for trail segments
-        static int trailY[15] = {0};         // Y positions for trail segments
-        static float trailWidth[15] = {0};   // Width of each trail segment
+    header.length = out - (client->out + sizeof(header));
+    memcpy(client->out, &header, sizeof(header));
+    memcpy(client->baseline, snapshot->objects, sizeof(client->baseline));
+    client->has_baseline = 1;
+    client->out_length = sizeof(header) + header.length;
+    client->out_sent = 0;
+    return client->out_length;
+}
 
-        // Shift trail values
-        for (int i = 14; i > 0; i--)
+// Write as much of a spectator's pending message as its socket takes without blocking
+// Returns 0 if the spectator has gone
+int flushSpectator(SpectatorClient *client)
+{
+    while (client->out_sent < client->out_length)
+    {
+        ssize_t sent = send(client->fd, client->out + client->out_sent, client->out_length - client->out_sent,
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0)
         {
-            trailX[i] = trailX[i - 1];
-            trailY[i] = trailY[i - 1];
-            trailOpacity[i] = trailOpacity[i - 1] * 0.85f; // Slower fade out (was 0.8f)
-            trailWidth[i] = trailWidth[i - 1] * 0.9f;      // Gradual thinning
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
         }
+        client->out_sent += sent;
+    }
+    return 1;
+}
 
-        // Add new point to trail
-        trailX[0] = mouse_x;
-        trailY[0] = mouse_y;
-        trailOpacity[0] = 1.0f; // Full opacity at start (was 0.9f)
+// Disconnect a spectator and remove it from the list
+void dropSpectator(int index, const char *reason)
+{
+    SpectatorStream *ss = &spectator_stream;
+    SpectatorClient *client = ss->clients[index];
+
+    printf("Spectator %s after %ld messages, %ld steps skipped\n", reason, client->messages, client->skipped);
+    close(client->fd);
+    free(client);
+    ss->clients[index] = ss->clients[--ss->client_count];
+    __atomic_store_n(&ss->watching, ss->client_count, __ATOMIC_RELAXED);
+}
 
-        // Calculate trail width based on mouse movement speed
-        float movement = sqrt(pow(mouse_x - prev_mouse_x, 2) + pow(mouse_y - prev_mouse_y, 2));
-        trailWidth[0] = fmin(3.5f, 1.5f + movement * 0.05f); // Thinner trail: was 6.0f max, now 3.5f max
+// Take every spectator waiting to connect; each gets a keyframe with the next step
+void acceptSpectators()
+{
+    SpectatorStream *ss = &spectator_stream;
 
-        // Draw trail with improved gradient
-        for (int i = 1; i < 15; i++)
+    int fd;
+    while ((fd = accept4(ss->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        SpectatorClient *client = calloc(1, sizeof(SpectatorClient));
+        if (client != NULL && ss->client_count == ss->client_capacity)
         {
-            if (trailOpacity[i] > 0.05f)
+            int capacity = ss->client_capacity ? ss->client_capacity * 2 : 4;
+            SpectatorClient **clients = realloc(ss->clients, capacity * sizeof(SpectatorClient *));
+            if (clients == NULL)
             {
-                int alpha = (int)(trailOpacity[i] * 255);
-                float thickness = trailWidth[i];
-                if (thickness < 0.5f)
-                    thickness = 0.5f;
-
-                // Bright core
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, alpha);
-                SDL_RenderDrawLine(renderer, trailX[i - 1], trailY[i - 1], trailX[i], trailY[i]);
-
-                // Thinner colored trail with better rainbow effect
-                for (int t = 1; t <= (int)(thickness * 1.5); t++) // Reduced multiplier from 2 to 1.5
-                {
-                    float tFactor = t / thickness;
-
-                    // Vibrant sword-like colors
-                    Uint8 r, g, b;
-                    // Calculate hue based on position in trail and current time for animation
-                    float hue = (i * 20 + SDL_GetTicks() / 10) % 360;
-
-                    // Simple HSV to RGB conversion for vibrant colors
-                    if (hue < 60)
-                    {
-                        r = 255;
-                        g = (Uint8)(hue * 4.25);
-                        b = 0;
-                    }
-                    else if (hue < 120)
-                    {
-                        r = (Uint8)((120 - hue) * 4.25);
-                        g = 255;
-                        b = 0;
-                    }
-                    else if (hue < 180)
-                    {
-                        r = 0;
-                        g = 255;
-                        b = (Uint8)((hue - 120) * 4.25);
-                    }
-                    else if (hue < 240)
-                    {
-                        r = 0;
-                        g = (Uint8)((240 - hue) * 4.25);
-                        b = 255;
-                    }
-                    else if (hue < 300)
-                    {
-                        r = (Uint8)((hue - 240) * 4.25);
-                        g = 0;
-                        b = 255;
-                    }
-                    else
-                    {
-                        r = 255;
-                        g = 0;
-                        b = (Uint8)((360 - hue) * 4.25);
-                    }
+                free(client);
+                client = NULL;
+            }
+            else
+            {
+                ss->clients = clients;
+                ss->client_capacity = capacity;
+            }
+        }
+        if (client == NULL)
+        {
+            printf("Out of memory, turning a spectator away\n");
+            close(fd);
+            continue;
+        }
 
-                    // Adjust alpha based on distance from center of trail
-                    int edgeAlpha = (int)(alpha / (tFactor + 1));
+        client->fd = fd;
+        ss->clients[ss->client_count++] = client;
+        ss->spectators_served++;
+        __atomic_store_n(&ss->watching, ss->client_count, __ATOMIC_RELAXED);
+        printf("Spectator connected (%d watching)\n", ss->client_count);
+    }
+}
 
-                    SDL_SetRenderDrawColor(renderer, r, g, b, edgeAlpha);
+// Encoder thread: sends each spectator the newest step, skipping any that can't keep up
+// Only the newest queued snapshot matters, since every message is a delta from
+// what that spectator already has. A spectator whose socket is still full of
+// its previous message skips the step instead of holding up the others, and is
+// disconnected once it has taken nothing for SPECTATE_STALL_MS.
+void *spectatorEncoder(void *arg)
+{
+    (void)arg; // Unused parameter
+    SpectatorStream *ss = &spectator_stream;
+    nameThread("ninja-spectate");
+    lowJitterThread(0);
+    TRACE_THREAD_NAME("ninja-spectate");
 
-                    // Draw parallel lines to create thickness
-                    float angle = atan2(trailY[i] - trailY[i - 1], trailX[i] - trailX[i - 1]) + M_PI / 2;
-                    float distance = t * 0.5f; // Reduced from 0.7f to 0.5f for thinner trail
+    while (1)
+    {
+        pthread_mutex_lock(&ss->mutex);
+        if (ss->queued == 0 && !ss->stopping)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += SPECTATE_WAIT_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&ss->cond, &ss->mutex, &deadline);
+        }
+        int newest = -1;
+        while (ss->queued > 0)
+        {
+            if (newest >= 0)
+            {
+                ss->free_list[ss->free_count++] = newest;
+            }
+            newest = ss->queue[ss->queue_head];
+            ss->queue_head = (ss->queue_head + 1) % SPECTATE_BUFFERS;
+            ss->queued--;
+        }
+        int stopping = ss->stopping;
+        pthread_mutex_unlock(&ss->mutex);
 
-                    int offsetX = (int)(cos(angle) * distance);
-                    int offsetY = (int)(sin(angle) * distance);
+        if (stopping)
+        {
+            break;
+        }
 
-                    SDL_RenderDrawLine(renderer,
-                                       trailX[i - 1] + offsetX, trailY[i - 1] + offsetY,
-                                       trailX[i] + offsetX, trailY[i] + offsetY);
+        acceptSpectators();
+        if (newest < 0)
+        {
+            continue;
+        }
 
-                    SDL_RenderDrawLine(renderer,
-                                       trailX[i - 1] - offsetX, trailY[i - 1] - offsetY,
-                                       trailX[i] - offsetX, trailY[i] - offsetY);
+        TRACE_BEGIN("spectatorEncode");
+        const StateSnapshot *snapshot = &ss->snapshots[newest];
+        double now = perfNowMs();
+        for (int i = ss->client_count - 1; i >= 0; i--)
+        {
+            SpectatorClient *client = ss->clients[i];
+            if (!flushSpectator(client))
+            {
+                dropSpectator(i, "disconnected");
+                continue;
+            }
+            if (client->out_sent < client->out_length)
+            {
+                client->skipped++;
+                ss->ticks_skipped++;
+                if (client->stalled_since_ms == 0.0)
+                {
+                    client->stalled_since_ms = now;
                 }
-
-                // Add smaller sparkle effects
-                if (i % 3 == 0) // Less frequent sparkles (was i % 2)
+                else if (now - client->stalled_since_ms > SPECTATE_STALL_MS)
                 {
-                    int sparkleSize = 2 - i / 7; // Smaller sparkles (was 4 - i/5)
-                    if (sparkleSize > 0)
-                    {
-                        // Brighter sparkle color
-                        SDL_SetRenderDrawColor(renderer, 255, 255, 220, alpha);
-
-                        // Draw as a filled circle instead of a rectangle for better appearance
-                        filledCircleRGBA(renderer,
-                                         trailX[i],
-                                         trailY[i],
-                                         sparkleSize,
-                                         255, 255, 220, alpha);
-                    }
+                    ss->spectators_dropped++;
+                    dropSpectator(i, "too slow, disconnected");
                 }
+                continue;
+            }
+            client->stalled_since_ms = 0.0;
+
+            int keyframe = !client->has_baseline;
+            int bytes = encodeSpectatorMessage(client, snapshot);
+            if (keyframe)
+            {
+                ss->keyframes++;
+                ss->keyframe_bytes += bytes;
+            }
+            else
+            {
+                ss->deltas++;
+                ss->delta_bytes += bytes;
+            }
+            client->messages++;
+            if (!flushSpectator(client))
+            {
+                dropSpectator(i, "disconnected");
             }
         }
+        ss->ticks_encoded++;
+        TRACE_END("spectatorEncode");
+
+        pthread_mutex_lock(&ss->mutex);
+        ss->free_list[ss->free_count++] = newest;
+        pthread_mutex_unlock(&ss->mutex);
     }
 
-    // If game over, display a message
-    if (game_state == STATE_GAME_OVER)
+    while (ss->client_count > 0)
     {
-        // Semi-transparent overlay
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
-        SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-        SDL_RenderFillRect(renderer, &overlay);
-
-        // Game over message box
-        SDL_SetRenderDrawColor(renderer, 50, 50, 70, 240);
-        SDL_Rect messageBox = {WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 100, 300, 200};
-        SDL_RenderFillRect(renderer, &messageBox);
-
-        // Box border
-        SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
-        SDL_Rect messageBorder = {WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 100, 300, 200};
-        SDL_RenderDrawRect(renderer, &messageBorder);
-
-        // Game Over Text with digital display
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-
-        // Draw "GAME OVER" text centered
-        int gameOverWidth = strlen("GAME OVER") * 18 + (strlen("GAME OVER") - 1) * 3;
-        int gameOverX = WINDOW_WIDTH / 2 - gameOverWidth / 2;
-        drawDigitalText(renderer, "GAME OVER", gameOverX, WINDOW_HEIGHT / 2 - 70, 18, 28, 3);
-
-        // Draw final score with digital display centered
-        char scoreStr[20];
-        sprintf(scoreStr, "SCORE %d", score);
-        int scoreTextWidth = strlen(scoreStr) * 14 + (strlen(scoreStr) - 1) * 3;
-        int scoreTextX = WINDOW_WIDTH / 2 - scoreTextWidth / 2;
-        drawDigitalText(renderer, scoreStr, scoreTextX, WINDOW_HEIGHT / 2 - 20, 14, 22, 3);
-
-        // Render "Restart" button
-        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
-        SDL_Rect restartButton = {WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 20, 100, 40};
-        SDL_RenderFillRect(renderer, &restartButton);
-
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(renderer, &restartButton);
-
-        // Draw "RESTART" text centered in button
-        int restartWidth = strlen("RESTART") * 10 + (strlen("RESTART") - 1) * 2;
-        int restartX = restartButton.x + (restartButton.w - restartWidth) / 2;
-        int restartY = restartButton.y + (restartButton.h - 20) / 2;
-        drawDigitalText(renderer, "RESTART", restartX, restartY, 10, 20, 2);
-
-        // Render "Leaderboard" button
-        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
-        SDL_Rect leaderboardButton = {WINDOW_WIDTH / 2 + 20, WINDOW_HEIGHT / 2 + 20, 100, 40};
-        SDL_RenderFillRect(renderer, &leaderboardButton);
-
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(renderer, &leaderboardButton);
+        dropSpectator(ss->client_count - 1, "disconnected at exit");
+    }
+    return NULL;
+}
 
-        // Draw "SCORES" text centered in button
-        int scoresWidth = strlen("SCORES") * 10 + (strlen("SCORES") - 1) * 2;
-        int scoresX = leaderboardButton.x + (leaderboardButton.w - scoresWidth) / 2;
-        int scoresY = leaderboardButton.y + (leaderboardButton.h - 20) / 2;
-        drawDigitalText(renderer, "SCORES", scoresX, scoresY, 10, 20, 2);
+// Stop the encoder, disconnect spectators and report what was sent
+void stopSpectatorStream()
+{
+    SpectatorStream *ss = &spectator_stream;
+    if (!ss->active)
+    {
+        return;
     }
-    // Display leaderboard
-    else if (game_state == STATE_LEADERBOARD)
+    ss->active = 0;
+
+    pthread_mutex_lock(&ss->mutex);
+    ss->stopping = 1;
+    pthread_cond_signal(&ss->cond);
+    pthread_mutex_unlock(&ss->mutex);
+    pthread_join(ss->thread, NULL);
+
+    close(ss->listen_fd);
+    ss->listen_fd = -1;
+    unlink(ss->path);
+    free(ss->clients);
+    ss->clients = NULL;
+    pthread_cond_destroy(&ss->cond);
+    pthread_mutex_destroy(&ss->mutex);
+
+    printf("Spectator stream: %ld spectators, %ld steps encoded, %ld dropped before encoding, %ld skipped for slow spectators, %ld disconnected for stalling\n",
+           ss->spectators_served, ss->ticks_encoded, ss->ticks_dropped, ss->ticks_skipped, ss->spectators_dropped);
+    if (ss->keyframes > 0)
     {
-        // Semi-transparent overlay
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
-        SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-        SDL_RenderFillRect(renderer, &overlay);
-
-        // Leaderboard box
-        SDL_SetRenderDrawColor(renderer, 50, 50, 70, 240);
-        SDL_Rect leaderboardBox = {WINDOW_WIDTH / 2 - 220, 50, 440, WINDOW_HEIGHT - 150}; // Increased width from 400 to 440
-        SDL_RenderFillRect(renderer, &leaderboardBox);
+        printf("Spectator stream: %ld keyframes averaging %ld bytes, %ld deltas averaging %ld bytes\n",
+               ss->keyframes, ss->keyframe_bytes / ss->keyframes, ss->deltas,
+               ss->deltas > 0 ? ss->delta_bytes / ss->deltas : 0L);
+    }
+}
 
-        // Box border
-        SDL_SetRenderDrawColor(renderer, 100, 100, 200, 255);
-        SDL_RenderDrawRect(renderer, &leaderboardBox);
+// Apply one complete stream message to the game globals; 0 if it is malformed
+int applySpectatorMessage(const uint8_t *message, int length)
+{
+    SpectateHeader header;
+    memcpy(&header, message, sizeof(header));
+    const uint8_t *in = message + sizeof(header);
+    const uint8_t *end = message + length;
 
-        // Draw "LEADERBOARD" title with digital display
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    if (header.type == SPECTATE_KEYFRAME)
+    {
+        for (int i = 0; i < MAX_FRUITS; i++)
+        {
+            gameObjects[i].active = 0;
+        }
+        if (header.background_seed != background_seed || background_texture == NULL)
+        {
+            background_seed = header.background_seed;
+            createBackground();
+        }
+    }
+    applyReplayFrame(&header.frame);
 
-        // Center the "LEADERBOARD" title
-        int titleWidth = strlen("LEADERBOARD") * 16 + (strlen("LEADERBOARD") - 1) * 3; // Character width * count + spacing
-        int titleX = WINDOW_WIDTH / 2 - titleWidth / 2;
-        drawDigitalText(renderer, "LEADERBOARD", titleX, 70, 16, 28, 3); // Centered
+    for (uint32_t r = 0; r < header.records; r++)
+    {
+        if (end - in < 2 || in[0] >= MAX_FRUITS)
+        {
+            return 0;
+        }
+        GameObject *object = &gameObjects[in[0]];
+        int op = in[1];
+        in += 2;
 
-        // Display each score entry with digital display
-        int maxDisplayScores = 9; // Changed from 10 to 9
-        for (int i = 0; i < num_scores && i < maxDisplayScores; i++)
+        if (op == SPECTATE_OBJ_GONE)
         {
-            int y = 130 + i * 40;
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            object->active = 0;
+        }
+        else if (op == SPECTATE_OBJ_FULL && end - in >= (long)sizeof(GameObject))
+        {
+            memcpy(object, in, sizeof(GameObject));
+            in += sizeof(GameObject);
+        }
+        else if (op == SPECTATE_OBJ_DELTA && end - in >= (long)sizeof(uint32_t))
+        {
+            uint32_t mask, words[SPECTATE_OBJECT_WORDS];
+            memcpy(&mask, in, sizeof(mask));
+            in += sizeof(mask);
+            memcpy(words, object, sizeof(words));
+            for (unsigned int w = 0; w < SPECTATE_OBJECT_WORDS; w++)
+            {
+                if (mask & (1u << w))
+                {
+                    if (end - in < (long)sizeof(uint32_t))
+                    {
+                        return 0;
+                    }
+                    memcpy(&words[w], in, sizeof(uint32_t));
+                    in += sizeof(uint32_t);
+                }
+            }
+            memcpy(object, words, sizeof(words));
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return in == end;
+}
 
-            // Calculate the width of a row to center contents
-            char fullRowText[50];
-            sprintf(fullRowText, "%d.  %d  %s", i + 1, leaderboard[i].score, leaderboard[i].date);
+// Tool mode: watch a game published with --spectator-socket
+// Draws whatever state the stream has reached with the game's own renderer,
+// at the display's rate, until the game ends or the window is closed.
+int runSpectator(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Spectator socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("Failed to connect to the game");
+        return 1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
 
-            // Rank - left aligned with padding from left edge
-            char rankStr[5];
-            sprintf(rankStr, "%d.", i + 1);
-            drawDigitalText(renderer, rankStr, leaderboardBox.x + 30, y, 12, 22, 3);
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return 1;
+    }
+    window = SDL_CreateWindow("Ninja Fruit (spectating)", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                              WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
+    Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
+    if (frame_pacer.vsync_requested)
+    {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    renderer = window != NULL ? SDL_CreateRenderer(window, -1, renderer_flags) : NULL;
+    if (renderer == NULL)
+    {
+        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+        return 1;
+    }
+    initFramePacer();
+    initSplats();
+    initRenderPaths();
+    pthread_mutex_init(&game_mutex, NULL);
+    loadScores();
 
-            // Score - centered in the middle section
-            char scoreStr[20];
-            sprintf(scoreStr, "%d", leaderboard[i].score);
-            drawDigitalText(renderer, scoreStr, WINDOW_WIDTH / 2 - (strlen(scoreStr) * 12) / 2, y, 12, 22, 3);
+    // Room for a few whole messages, so a burst never leaves one half-read for long
+    int capacity = 4 * SPECTATE_MAX_MESSAGE;
+    uint8_t *buffer = malloc(capacity);
+    int used = 0;
+    long messages = 0, bytes = 0;
+    unsigned int tick = 0;
+    int connected = buffer != NULL;
 
-            // Date (shortened to just show essential info) - right aligned with padding
-            char dateShort[15];
-            strncpy(dateShort, leaderboard[i].date, 10); // Just show the date part
-            dateShort[10] = '\0';
-            drawDigitalText(renderer, dateShort, leaderboardBox.x + leaderboardBox.w - 30 - (strlen(dateShort) * 8), y, 8, 18, 2);
+    printf("Spectating %s\n", path);
+    while (isRunning() && connected)
+    {
+        SDL_Event e;
+        while (SDL_PollEvent(&e))
+        {
+            if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+            {
+                stopRunning();
+            }
         }
 
-        // Back button
-        SDL_SetRenderDrawColor(renderer, 80, 100, 200, 255);
-        SDL_Rect backButton = {WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT - 70, 100, 40};
-        SDL_RenderFillRect(renderer, &backButton);
+        // Take everything the game has sent and apply each complete message in order
+        ssize_t got;
+        while (used < capacity && (got = recv(fd, buffer + used, capacity - used, 0)) > 0)
+        {
+            used += got;
+            bytes += got;
+        }
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            printf("The game has ended the stream\n");
+            connected = 0;
+        }
 
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(renderer, &backButton);
+        int offset = 0;
+        while (used - offset >= (int)sizeof(SpectateHeader))
+        {
+            SpectateHeader header;
+            memcpy(&header, buffer + offset, sizeof(header));
+            int length = sizeof(header) + header.length;
+            if (header.magic != SPECTATE_MAGIC || length > (int)SPECTATE_MAX_MESSAGE)
+            {
+                printf("Spectator stream is corrupt, stopping\n");
+                connected = 0;
+                break;
+            }
+            if (used - offset < length)
+            {
+                break;
+            }
+            if (!applySpectatorMessage(buffer + offset, length))
+            {
+                printf("Spectator message for step %u is malformed, stopping\n", header.tick);
+                connected = 0;
+                break;
+            }
+            tick = header.tick;
+            messages++;
+            offset += length;
+        }
+        memmove(buffer, buffer + offset, used - offset);
+        used -= offset;
 
-        // Draw "BACK" text centered in button
-        int backWidth = strlen("BACK") * 12 + (strlen("BACK") - 1) * 2;
-        int backX = backButton.x + (backButton.w - backWidth) / 2;
-        int backY = backButton.y + (backButton.h - 20) / 2;
-        drawDigitalText(renderer, "BACK", backX, backY, 12, 20, 2);
+        renderGame();
+        SDL_RenderPresent(renderer);
+        framePacerPresented();
+        framePacerWait();
     }
 
-    // Present rendered frame
-    SDL_RenderPresent(renderer);
-
-    // Unlock mutex after rendering
-    pthread_mutex_unlock(&game_mutex);
+    printf("Spectated up to step %u: %ld messages, %.1f KB\n", tick, messages, bytes / 1024.0);
+    free(buffer);
+    close(fd);
+    cleanupRenderPaths();
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
 }
 
 // Function to clean up resources
 void cleanupGame(void)
 {
+    // Finish writing any recorded frames, replay and spike dump
+    stopFrameCapture();
+    stopReplayRecording();
+    stopFlightRecorder();
+    printDrawStats();
+    printCollisionStats();
+    printFramePacing();
+    printSpawnGovernor();
+    if (blade_predictor.samples > 0)
+    {
+        printf("Blade predictor: %ld frames drawn ahead by %.1f ms, samples landed %.1f px (max %.1f) from the filter's expectation\n",
+               blade_predictor.predictions, blade_predictor.ahead_ms,
+               blade_predictor.error_sum / blade_predictor.samples, blade_predictor.error_max);
+    }
+    if (late_latch.frames_latched > 0)
+    {
+        printf("Late latch: blade tip extended in %ld frames by %ld motion events, %ld provisional hits\n",
+               late_latch.frames_latched, late_latch.events_latched, late_latch.provisional_hits);
+    }
+    closeMetrics();
+
     // Free sounds
     if (sliceSound != NULL)
     {
@@ -2452,7 +8305,16 @@ void cleanupGame(void)
         backgroundMusic = NULL;
     }
 
-    // Free background texture
+    // Free render path resources
+    cleanupRenderPaths();
+
+    // Free splat and background textures
+    if (splat_texture != NULL)
+    {
+        SDL_DestroyTexture(splat_texture);
+        splat_texture = NULL;
+    }
+
     if (background_texture != NULL)
     {
         SDL_DestroyTexture(background_texture);
@@ -2475,6 +8337,14 @@ void cleanupGame(void)
     // Close audio
     Mix_CloseAudio();
 
+    // Wait for the deadlock thread, which stops once running is cleared,
+    // before the mutex and SDL it uses go away
+    if (deadlock_thread_started)
+    {
+        pthread_join(deadlock_thread, NULL);
+        deadlock_thread_started = 0;
+    }
+
     // Quit SDL subsystems
     SDL_Quit();
 
@@ -2485,10 +8355,6 @@ void cleanupGame(void)
     close(spawn_pipe[0]);
     close(spawn_pipe[1]);
 
-    // Cancel deadlock thread
-    pthread_cancel(deadlock_thread);
-    pthread_join(deadlock_thread, NULL);
-
     // Clean up deadlock detector resources
     cleanupDeadlockDetector();
 
@@ -2509,7 +8375,7 @@ void signalHandler(int sig)
     (void)sig;
 
     printf("\nGame ending. Final score: %d\n", score);
-    running = 0;
+    stopRunning();
     saveScore();
     cleanupGame();
     exit(0);
@@ -2529,17 +8395,18 @@ void processSpawner()
     if (pid == 0)
     {
         // Child process
+        nameThread("ninja-powerup");
+        lowJitterThread(1);
         close(spawn_pipe[0]); // Close unused read end
 
-        while (running)
+        while (isRunning())
         {
             // Every few seconds, create a special power-up
             sleep(5);
 
-            if (rand() % 3 == 0)
+            int power_type = rollPowerUp();
+            if (power_type >= 0)
             {
-                int power_type = rand() % 2; // 0 for slow-mo, 1 for double points
-
                 // Write power-up type to pipe
                 if (write(spawn_pipe[1], &power_type, sizeof(power_type)) == -1)
                 {
@@ -2557,6 +8424,7 @@ void processSpawner()
     else
     {
         // Parent process
+        powerup_pid = pid;
         close(spawn_pipe[1]); // Close unused write end
 
         // Set non-blocking read
@@ -2564,25 +8432,48 @@ void processSpawner()
     }
 }
 
+// Decide whether this interval produces a power-up
+// Returns 0 for slow-mo, 1 for double points, or -1 for none
+int rollPowerUp()
+{
+    if (rand() % 3 == 0)
+    {
+        return rand() % 2;
+    }
+    return -1;
+}
+
+// Activate a power-up produced by rollPowerUp()
+void activatePowerUp(int power_type)
+{
+    if (power_type == 0)
+    {
+        printf("Power-up: SLOW MOTION activated!\n");
+        // Would slow down game objects in a real implementation
+    }
+    else
+    {
+        printf("Power-up: DOUBLE POINTS activated!\n");
+        // Would double points for a limited time
+    }
+}
+
 // Check for power-ups from child process
 void checkPowerUps()
 {
+    // In single-thread mode there is no child; power-ups are rolled in the simulation step
+    if (single_thread.enabled)
+    {
+        return;
+    }
+
     int power_type;
     int result = read(spawn_pipe[0], &power_type, sizeof(power_type));
 
     if (result > 0)
     {
         // Successfully read a power-up
-        if (power_type == 0)
-        {
-            printf("Power-up: SLOW MOTION activated!\n");
-            // Would slow down game objects in a real implementation
-        }
-        else
-        {
-            printf("Power-up: DOUBLE POINTS activated!\n");
-            // Would double points for a limited time
-        }
+        activatePowerUp(power_type);
     }
     else if (result == -1 && errno != EAGAIN)
     {
@@ -2598,14 +8489,16 @@ void resetGame()
     score = 0;
     health = 3;
     game_time = 0;
-    start_time = SDL_GetTicks();
+    start_time = simNowMs();
     game_state = STATE_PLAYING;
 
-    // Clear any existing game objects
+    // Clear any existing game objects, which the spawner may be filling in
+    lockGameMutex();
     for (int i = 0; i < MAX_FRUITS; i++)
     {
         gameObjects[i].active = 0;
     }
+    unlockGameMutex();
 
     printf("Game reset! Ready to play again.\n");
 }
@@ -2634,10 +8527,12 @@ void loadScores()
 // Save scores to file
 void saveScores()
 {
+    NINJA_PROBE1(score_save_begin, num_scores);
     FILE *file = fopen("leaderboard.txt", "w");
     if (file == NULL)
     {
         perror("Failed to open leaderboard file for writing");
+        NINJA_PROBE1(score_save_end, 0);
         return;
     }
 
@@ -2647,6 +8542,7 @@ void saveScores()
     }
 
     fclose(file);
+    NINJA_PROBE1(score_save_end, 1);
     printf("Saved %d scores to leaderboard file.\n", num_scores);
 }
 
@@ -2971,36 +8867,318 @@ void drawRightAlignedString(SDL_Renderer *renderer, const char *str, int rightX,
     drawString(renderer, str, startX, y, charWidth, charHeight, spacing);
 }
 
-int main()
+// Parse command-line options
+void parseArgs(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--recalibrate") == 0)
+        {
+            force_recalibration = 1;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            capture_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record-replay") == 0 && i + 1 < argc)
+        {
+            replay_record_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--spectator-socket") == 0 && i + 1 < argc)
+        {
+            spectator_stream.path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc)
+        {
+            spectate_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--render-replay") == 0 && i + 1 < argc)
+        {
+            replay_render_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            replay_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            replay_jobs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--metrics-name") == 0 && i + 1 < argc)
+        {
+            metrics_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-metrics") == 0)
+        {
+            metrics_enabled = 0;
+        }
+        else if (strcmp(argv[i], "--low-jitter") == 0)
+        {
+            low_jitter.enabled = 1;
+        }
+        else if (strcmp(argv[i], "--main-cpu") == 0 && i + 1 < argc)
+        {
+            low_jitter.main_cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--control-socket") == 0 && i + 1 < argc)
+        {
+            control_socket.path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--latency-test") == 0)
+        {
+            latency_test.enabled = 1;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+            {
+                latency_test.samples_wanted = atoi(argv[++i]);
+            }
+            if (latency_test.samples_wanted < 1)
+            {
+                latency_test.samples_wanted = LATENCY_DEFAULT_SAMPLES;
+            }
+        }
+        else if (strcmp(argv[i], "--no-spawn-governor") == 0)
+        {
+            spawn_governor.enabled = 0;
+        }
+        else if (strcmp(argv[i], "--single-thread") == 0)
+        {
+            single_thread.enabled = 1;
+            spawn_governor.enabled = 0; // Timing-driven, so it would break determinism
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+            {
+                single_thread.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+            }
+        }
+        else if (strcmp(argv[i], "--no-vsync") == 0)
+        {
+            frame_pacer.vsync_requested = 0;
+        }
+        else if (strcmp(argv[i], "--blade-predict") == 0)
+        {
+            blade_predictor.enabled = 1;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+            {
+                blade_predictor.ahead_ms = atof(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--no-late-latch") == 0)
+        {
+            late_latch.enabled = 0;
+        }
+        else if (strcmp(argv[i], "--latency-readback") == 0)
+        {
+            latency_test.readback = 1;
+        }
+        else if (strcmp(argv[i], "--hw-counters") == 0)
+        {
+            hw_profiling = 1;
+        }
+        else if (strcmp(argv[i], "--spike-budget") == 0)
+        {
+            flight_recorder.budget_ms = FLIGHT_DEFAULT_BUDGET_MS;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+            {
+                flight_recorder.budget_ms = atof(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+#ifdef NINJA_TRACE
+            trace_enabled = 1;
+#else
+            printf("Tracing is not compiled in; rebuild with make TRACE=1\n");
+#endif
+        }
+        else if (strcmp(argv[i], "--render-path") == 0 && i + 1 < argc)
+        {
+            i++;
+            for (int path = 0; path < RENDER_PATHS; path++)
+            {
+                if (strcmp(argv[i], render_path_names[path]) == 0)
+                {
+                    forced_render_path = path;
+                }
+            }
+            if (forced_render_path < 0)
+            {
+                printf("Unknown render path: %s\n", argv[i]);
+            }
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[i]);
+        }
+    }
+}
+
+#ifndef NINJA_NO_MAIN
+int main(int argc, char *argv[])
 {
     printf("NinjaFruit Game Starting!\n");
+    main_thread = pthread_self();
+
+    parseArgs(argc, argv);
+    TRACE_THREAD_NAME("main"); // Before initGame() starts any other thread
+
+    // Tool mode: render a replay offline instead of playing
+    if (replay_render_path != NULL)
+    {
+        return renderReplay(replay_render_path, replay_output != NULL ? replay_output : "replay_frames", replay_jobs);
+    }
+
+    // Tool mode: watch another game's spectator stream
+    if (spectate_path != NULL)
+    {
+        return runSpectator(spectate_path);
+    }
 
     initGame();
+    applyLowJitter();
+
+    // Create deadlock monitoring thread, unless it runs in the simulation step.
+    // Only now, so lowJitterThread() sees the main thread's final CPU.
+    if (!single_thread.enabled)
+    {
+        deadlock_thread_started = pthread_create(&deadlock_thread, NULL, deadlockMonitor, NULL) == 0;
+        if (!deadlock_thread_started)
+        {
+            fprintf(stderr, "Failed to create deadlock monitoring thread\n");
+        }
+    }
+
+    // Start recording if requested
+    if (capture_path != NULL)
+    {
+        startFrameCapture(capture_path);
+    }
+    if (replay_record_path != NULL)
+    {
+        startReplayRecording(replay_record_path);
+    }
+    startFlightRecorder();
+    startLatencyTest();
+    openMetrics();
+    startControlSocket();
+    startSpectatorStream();
+    if (hw_profiling)
+    {
+        hwCountersOpen(&hw_main_group);
+    }
 
-    // Launch object spawner thread
     pthread_t spawnerThread;
-    pthread_create(&spawnerThread, NULL, spawnObjects, NULL);
+    if (single_thread.enabled)
+    {
+        // Spawning, deadlock monitoring and power-ups run in the simulation step instead
+        srand(single_thread.seed);
+        printf("Single-thread mode: seed %u, background work every %d/%d/%d simulation steps\n",
+               single_thread.seed, SINGLE_THREAD_SPAWN_STEPS, SINGLE_THREAD_DEADLOCK_STEPS, SINGLE_THREAD_POWERUP_STEPS);
+    }
+    else
+    {
+        // Launch object spawner thread
+        pthread_create(&spawnerThread, NULL, spawnObjects, NULL);
 
-    // Launch power-up process
-    processSpawner();
+        // Launch power-up process
+        processSpawner();
+    }
 
     // Main game loop
-    while (running)
+    while (isRunning())
     {
+        perfBeginFrame();
+        NINJA_PROBE1(frame_begin, perf_stats.frames);
+        TRACE_BEGIN("frame");
+
         // Handle SDL events
+        TRACE_BEGIN("handleEvents");
         handleEvents();
+        TRACE_END("handleEvents");
+        perfEndPhase(PHASE_EVENTS);
 
-        // Update game state
-        updateGame();
+        // Advance the simulation in fixed steps
+        TRACE_BEGIN("updateGame");
+        for (int steps = framePacerSimSteps(); steps > 0; steps--)
+        {
+            if (single_thread.enabled)
+            {
+                singleThreadStep();
+            }
+            updateGame();
+        }
+        TRACE_END("updateGame");
+        perfEndPhase(PHASE_UPDATE);
 
         // Check for power-ups from child process
+        TRACE_BEGIN("checkPowerUps");
         checkPowerUps();
+        TRACE_END("checkPowerUps");
+        perfEndPhase(PHASE_POWERUPS);
 
-        // Render game
+        // Render game, then the overlay on top
+        TRACE_BEGIN("renderGame");
         renderGame();
+        if (collision_debug.visible)
+        {
+            drawCollisionDebug();
+        }
+        if (perf_stats.visible)
+        {
+            drawPerfOverlay();
+        }
+
+        // Bring the blade tip up to date as the last layer
+        TRACE_BEGIN("lateLatch");
+        lateLatchBlade();
+        TRACE_END("lateLatch");
+
+        // Hand the finished frame to the recorder before it is presented
+        if (frame_capture.active)
+        {
+            captureFrame();
+        }
+        TRACE_END("renderGame");
+        perfEndPhase(PHASE_RENDER);
+
+        // Present rendered frame
+        TRACE_BEGIN("present");
+        SDL_RenderPresent(renderer);
+        TRACE_END("present");
+        perfEndPhase(PHASE_PRESENT);
+        framePacerPresented();
+        latencyFramePresented();
+        NINJA_PROBE1(frame_end, perf_stats.frames);
+        publishMetrics();
+        sampleThreadStats(0);
+
+        // Let the quality governor see how long this frame's work took
+        updateQualityGovernor(framePacerWorkMs());
+        updateSpawnGovernor(framePacerWorkMs(), perf_stats.phase_ms[PHASE_UPDATE]);
+
+        // Wait for the right moment to start the next frame
+        TRACE_BEGIN("sleep");
+        framePacerWait();
+        TRACE_END("sleep");
+        TRACE_END("frame");
+    }
+
+    stopLatencyTest();
+    stopControlSocket();
+    stopSpectatorStream();
+
+    // Every other thread and process must be gone before cleanupGame()
+    // destroys the mutex and quits SDL
+    if (!single_thread.enabled)
+    {
+        // Wait for spawner thread to finish
+        pthread_join(spawnerThread, NULL);
 
-        // Cap to ~60 FPS
-        SDL_Delay(16);
+        // The child never sees running cleared, so stop it and wait for it
+        if (powerup_pid > 0)
+        {
+            kill(powerup_pid, SIGTERM);
+            waitpid(powerup_pid, NULL, 0);
+        }
     }
 
     // Save score before cleanup
@@ -3009,11 +9187,22 @@ int main()
     // Cleanup resources
     cleanupGame();
 
-    // Wait for spawner thread to finish
-    pthread_join(spawnerThread, NULL);
+    printThreadStats();
+
+    if (hw_profiling)
+    {
+        printHwCounters();
+        hwCountersClose(&hw_main_group);
+    }
 
-    // Wait for child process
-    wait(NULL);
+#ifdef NINJA_TRACE
+    // All threads have stopped - write the trace
+    if (trace_enabled)
+    {
+        writeTrace(trace_path);
+    }
+#endif
 
     return 0;
 }
+#endif
@@ -0,0 +1,53 @@
+#ifndef NINJA_METRICS_H
+#define NINJA_METRICS_H
+
+// Live metrics the game publishes in a POSIX shared-memory segment
+// The game is the only writer. It updates the segment under a sequence lock:
+// seq is odd while an update is in progress, and a reader retries if seq was
+// odd or changed while it copied. Readers never block the game.
+
+#include <stdint.h>
+
+#define NINJA_METRICS_DEFAULT_NAME "/ninja_fruit"
+#define NINJA_METRICS_MAGIC 0x544d4a4e // "NJMT"
+#define NINJA_METRICS_VERSION 1        // Bump when the layout below changes
+#define NINJA_METRICS_PHASES 5         // Events, update, power-ups, render, present
+#define NINJA_METRICS_RESOURCES 4      // Deadlock detector resource types
+
+typedef struct
+{
+    // Header, written once when the segment is created
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;  // sizeof(NinjaMetrics) in the writer
+    int32_t pid;
+
+    uint32_t seq;   // Sequence lock, odd during an update
+    uint32_t reserved;
+
+    // Payload
+    uint64_t updated_ms;    // Wall clock of the last update
+    uint64_t frames;
+    double fps;             // Over the recent frame history
+    double frame_ms_p50;
+    double frame_ms_p95;
+    double frame_ms_p99;
+    double phase_ms[NINJA_METRICS_PHASES];
+    int32_t active_objects;
+    int32_t score;
+    int32_t health;
+    int32_t game_state;     // 0 playing, 1 game over, 2 leaderboard
+    uint64_t slices;        // Fruit slices since start
+    double slices_per_sec;
+    uint64_t lock_acquisitions; // game_mutex, all threads
+    uint64_t lock_contended;    // Acquisitions that had to wait
+    double lock_wait_ms;        // Total wait across all threads
+    int32_t resources_available[NINJA_METRICS_RESOURCES];
+    uint64_t deadlock_checks;
+    uint64_t deadlocks_detected;
+    int32_t audio_channels_playing; // Mixer channels still playing sound effects
+    int32_t quality_level;
+    char render_path[16];
+} NinjaMetrics;
+
+#endif
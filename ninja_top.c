@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ninja_metrics.h"
+
+#define REFRESH_US 500000 // Screen refresh interval
+#define READ_RETRIES 100  // Give up on a snapshot if the game keeps updating mid-copy
+
+const char *state_names[] = {"playing", "game over", "leaderboard"};
+const char *phase_names[NINJA_METRICS_PHASES] = {"events", "update", "power-ups", "render", "present"};
+
+// Copy a consistent snapshot of the payload using the sequence lock
+int readMetrics(const NinjaMetrics *shared, NinjaMetrics *out)
+{
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        if (start & 1)
+        {
+            usleep(100);
+            continue;
+        }
+
+        memcpy(out, (const void *)shared, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&shared->seq, __ATOMIC_RELAXED) == start)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Open and map the game's metrics segment, checking it is a layout we understand
+const NinjaMetrics *openMetrics(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(NinjaMetrics))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    const NinjaMetrics *shared = mmap(NULL, sizeof(NinjaMetrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // The game fills the segment in after creating it, and sets the magic last
+    if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) == 0)
+    {
+        munmap((void *)shared, sizeof(NinjaMetrics));
+        return NULL;
+    }
+
+    if (shared->magic != NINJA_METRICS_MAGIC || shared->version != NINJA_METRICS_VERSION ||
+        shared->size != sizeof(NinjaMetrics))
+    {
+        fprintf(stderr, "%s: unsupported metrics layout (version %u, size %u)\n", name, shared->version, shared->size);
+        munmap((void *)shared, sizeof(NinjaMetrics));
+        exit(EXIT_FAILURE);
+    }
+
+    return shared;
+}
+
+// Print one snapshot; returns whether the game is still running
+int printMetrics(const char *name, const NinjaMetrics *m)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t now_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    int alive = kill(m->pid, 0) == 0 || errno == EPERM;
+
+    printf("ninja-top  %s  pid %d  %s", name, m->pid, alive ? "running" : "exited");
+    if (alive && now_ms > m->updated_ms + 2000)
+    {
+        printf(" (no update for %.1f s)", (now_ms - m->updated_ms) / 1000.0);
+    }
+    printf("\n\n");
+
+    printf("Frames      %10llu   FPS %6.1f\n", (unsigned long long)m->frames, m->fps);
+    printf("Frame ms    p50 %6.2f   p95 %6.2f   p99 %6.2f\n", m->frame_ms_p50, m->frame_ms_p95, m->frame_ms_p99);
+    printf("Phases ms  ");
+    for (int p = 0; p < NINJA_METRICS_PHASES; p++)
+    {
+        printf(" %s %.2f", phase_names[p], m->phase_ms[p]);
+    }
+    printf("\n\n");
+
+    printf("State       %s   score %d   health %d\n",
+           m->game_state >= 0 && m->game_state <= 2 ? state_names[m->game_state] : "?", m->score, m->health);
+    printf("Objects     %d active\n", m->active_objects);
+    printf("Slices      %llu total   %.1f/s\n", (unsigned long long)m->slices, m->slices_per_sec);
+    printf("Quality     level %d   render path %s\n\n", m->quality_level, m->render_path);
+
+    printf("game_mutex  %llu acquisitions   %llu contended (%.1f%%)   %.1f ms waited\n",
+           (unsigned long long)m->lock_acquisitions, (unsigned long long)m->lock_contended,
+           m->lock_acquisitions > 0 ? 100.0 * m->lock_contended / m->lock_acquisitions : 0.0, m->lock_wait_ms);
+    printf("Deadlocks   %llu detected in %llu checks   available",
+           (unsigned long long)m->deadlocks_detected, (unsigned long long)m->deadlock_checks);
+    for (int r = 0; r < NINJA_METRICS_RESOURCES; r++)
+    {
+        printf(" %d", m->resources_available[r]);
+    }
+    printf("\n");
+    printf("Audio       %d channels playing\n", m->audio_channels_playing);
+
+    return alive;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = NINJA_METRICS_DEFAULT_NAME;
+    int once = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-1") == 0)
+        {
+            once = 1;
+        }
+        else if (argv[i][0] == '/')
+        {
+            name = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-1] [/segment-name]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const NinjaMetrics *shared = NULL;
+    while (1)
+    {
+        if (shared == NULL)
+        {
+            shared = openMetrics(name);
+        }
+
+        if (!once)
+        {
+            printf("\033[H\033[2J"); // Home and clear
+        }
+
+        NinjaMetrics snapshot;
+        if (shared == NULL)
+        {
+            printf("ninja-top  %s  waiting for the game to start...\n", name);
+        }
+        else if (readMetrics(shared, &snapshot))
+        {
+            // A restarted game creates a fresh segment, so remap once this one's writer is gone
+            if (!printMetrics(name, &snapshot) && !once)
+            {
+                munmap((void *)shared, sizeof(NinjaMetrics));
+                shared = NULL;
+            }
+        }
+        else
+        {
+            printf("ninja-top  %s  segment busy, retrying\n", name);
+        }
+        fflush(stdout);
+
+        if (once)
+        {
+            return shared != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        usleep(REFRESH_US);
+    }
+}
@@ -0,0 +1,281 @@
+// Concurrency stress test, built with ThreadSanitizer by `make tsan`
+// The game is compiled into this file without its main(). The real spawner,
+// deadlock monitor, latency injector, control socket and spectator encoder
+// threads run against a
+// main thread that slices, updates, renders and resets as fast as it can, with
+// extra spawner threads filling in objects on top. Any data race TSan reports
+// is a bug in the game's locking, not in this file.
+#define NINJA_NO_MAIN
+#include "game.c"
+#include <limits.h>
+
+#define STRESS_DEFAULT_SECONDS 5
+#define STRESS_SPAWNERS 2           // Extra threads spawning far faster than the real spawner
+#define STRESS_SPAWN_PAUSE_US 50    // Without a pause they barge ahead of the main thread every time
+#define STRESS_SLICES_PER_FRAME 8
+#define STRESS_RESET_FRAMES 5       // Reset the game this often
+#define STRESS_CLIENT_PAUSE_US 2000 // Between control socket commands
+#define STRESS_LATENCY_SAMPLES 100000 // More than a run takes, so the injector never stops the game
+
+typedef struct
+{
+    unsigned int seed;
+    long spawned;
+} StressSpawner;
+
+// Spawn into random free slots, the same way spawnObjects() does, with almost no pacing
+void *stressSpawner(void *arg)
+{
+    StressSpawner *sp = arg;
+    nameThread("ninja-stress");
+
+    while (isRunning())
+    {
+        int index = rand_r(&sp->seed) % MAX_FRUITS;
+        lockGameMutex();
+        if (!gameObjects[index].active)
+        {
+            spawnFruit(index);
+            sp->spawned++;
+        }
+        unlockGameMutex();
+        usleep(STRESS_SPAWN_PAUSE_US);
+    }
+    return NULL;
+}
+
+// Drive the control socket like a test script would, until the game stops
+void *stressClient(void *arg)
+{
+    (void)arg;
+    nameThread("ninja-stress");
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, control_socket.path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("stress: connect to control socket");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    // Only ping answers, so each pass of the script waits for its pong
+    const char *script[] = {"move 100 300\n", "down 100 300\n", "path 100 300 700 300 40\n", "up 700 300\n",
+                            "click 400 200\n", "move 650 450\n", "ping\n"};
+    int count = sizeof(script) / sizeof(script[0]);
+    char reply[256];
+    int ok = 1;
+    while (ok && isRunning())
+    {
+        for (int i = 0; ok && i < count; i++)
+        {
+            ok = send(fd, script[i], strlen(script[i]), MSG_NOSIGNAL) >= 0;
+            usleep(STRESS_CLIENT_PAUSE_US);
+        }
+        ok = ok && read(fd, reply, sizeof(reply)) > 0;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+// Watch the spectator stream, checking every message is whole and in step order
+void *stressSpectator(void *arg)
+{
+    long *messages = arg;
+    nameThread("ninja-stress");
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, spectator_stream.path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("stress: connect to spectator socket");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    SpectateHeader header;
+    unsigned int last_tick = 0;
+    uint8_t *body = malloc(SPECTATE_MAX_MESSAGE);
+    while (body != NULL && recv(fd, &header, sizeof(header), MSG_WAITALL) == (ssize_t)sizeof(header))
+    {
+        if (header.magic != SPECTATE_MAGIC || header.length > SPECTATE_MAX_MESSAGE || header.tick <= last_tick ||
+            (*messages == 0) != (header.type == SPECTATE_KEYFRAME))
+        {
+            fprintf(stderr, "stress: bad spectator message for step %u\n", header.tick);
+            break;
+        }
+        if (header.length > 0 && recv(fd, body, header.length, MSG_WAITALL) != (ssize_t)header.length)
+        {
+            break;
+        }
+        last_tick = header.tick;
+        (*messages)++;
+    }
+
+    free(body);
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = STRESS_DEFAULT_SECONDS;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--seconds N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Events for the control socket and latency injector, and an offscreen renderer
+    if (SDL_Init(SDL_INIT_EVENTS) < 0)
+    {
+        fprintf(stderr, "SDL could not initialize: %s\n", SDL_GetError());
+        return EXIT_FAILURE;
+    }
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL)
+    {
+        fprintf(stderr, "No offscreen renderer: %s\n", SDL_GetError());
+        return EXIT_FAILURE;
+    }
+    background_seed = 1;
+    createBackground();
+    initSplats();
+    initRenderPaths();
+
+    main_thread = pthread_self();
+    pthread_mutex_init(&game_mutex, NULL);
+    if (pipe(spawn_pipe) != 0) // Nothing writes power-ups, but cleanupGame() closes it
+    {
+        perror("stress: pipe");
+        return EXIT_FAILURE;
+    }
+    metrics_enabled = 0;
+    frame_pacer.vsync_requested = 0;
+    initFramePacer();
+    resetGame();
+    health = INT_MAX; // Bombs never end the game, so nothing is written to the leaderboard
+
+    // The game's own background threads
+    initDeadlockDetector();
+    pthread_t spawner_thread;
+    if (pthread_create(&deadlock_thread, NULL, deadlockMonitor, NULL) != 0 ||
+        pthread_create(&spawner_thread, NULL, spawnObjects, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create game threads\n");
+        return EXIT_FAILURE;
+    }
+    deadlock_thread_started = 1; // cleanupGame() waits for it, as it does in the game
+
+    char socket_path[64];
+    snprintf(socket_path, sizeof(socket_path), "/tmp/ninja_stress_%d.sock", (int)getpid());
+    control_socket.path = socket_path;
+    pthread_t client_thread;
+    int client_started = startControlSocket() &&
+                         pthread_create(&client_thread, NULL, stressClient, NULL) == 0;
+
+    char spectate_socket_path[64];
+    snprintf(spectate_socket_path, sizeof(spectate_socket_path), "/tmp/ninja_stress_spectate_%d.sock", (int)getpid());
+    spectator_stream.path = spectate_socket_path;
+    long spectated = 0;
+    pthread_t spectator_thread;
+    int spectator_started = startSpectatorStream() &&
+                            pthread_create(&spectator_thread, NULL, stressSpectator, &spectated) == 0;
+
+    latency_test.enabled = 1;
+    latency_test.samples_wanted = STRESS_LATENCY_SAMPLES;
+    startLatencyTest();
+
+    StressSpawner spawners[STRESS_SPAWNERS];
+    pthread_t spawner_threads[STRESS_SPAWNERS];
+    for (int i = 0; i < STRESS_SPAWNERS; i++)
+    {
+        spawners[i] = (StressSpawner){.seed = i + 1};
+        pthread_create(&spawner_threads[i], NULL, stressSpawner, &spawners[i]);
+    }
+
+    // This thread plays the main thread: slice, update, render and reset flat out
+    printf("Stressing for %d s...\n", seconds);
+    Uint32 deadline = SDL_GetTicks() + seconds * 1000;
+    unsigned int seed = 42;
+    long frames = 0;
+    long resets = 0;
+    while (isRunning() && SDL_GetTicks() < deadline)
+    {
+        handleEvents();
+
+        for (int s = 0; s < STRESS_SLICES_PER_FRAME; s++)
+        {
+            float x1 = rand_r(&seed) % WINDOW_WIDTH, y1 = rand_r(&seed) % WINDOW_HEIGHT;
+            float x2 = rand_r(&seed) % WINDOW_WIDTH, y2 = rand_r(&seed) % WINDOW_HEIGHT;
+            lockGameMutex();
+            slicePass(x1, y1, x2, y2);
+            unlockGameMutex();
+        }
+
+        updateGame();
+        renderGame();
+        drawCollisionDebug();
+        lateLatchBlade();
+        SDL_RenderPresent(renderer);
+        latencyFramePresented();
+
+        if (++frames % STRESS_RESET_FRAMES == 0)
+        {
+            resetGame();
+            health = INT_MAX;
+            resets++;
+        }
+    }
+
+    // Tear down in the order main() does, so TSan sees the real shutdown
+    stopRunning();
+    for (int i = 0; i < STRESS_SPAWNERS; i++)
+    {
+        pthread_join(spawner_threads[i], NULL);
+    }
+    if (client_started)
+    {
+        pthread_join(client_thread, NULL);
+    }
+    stopLatencyTest();
+    stopControlSocket();
+    stopSpectatorStream(); // Disconnects the spectator, which then returns
+    if (spectator_started)
+    {
+        pthread_join(spectator_thread, NULL);
+    }
+    pthread_join(spawner_thread, NULL);
+
+    long spawned = 0;
+    for (int i = 0; i < STRESS_SPAWNERS; i++)
+    {
+        spawned += spawners[i].spawned;
+    }
+    printf("Stress: %ld frames, %ld resets, %ld extra spawns, %ld slices, %ld control commands, %ld spectator messages\n",
+           frames, resets, spawned, slices_total, control_socket.commands, spectated);
+    printf("game_mutex: %ld acquisitions, %ld contended\n",
+           lock_counters.acquisitions, lock_counters.contentions);
+
+    // No saveScore(): the stress run's score doesn't belong on the leaderboard
+    cleanupGame();
+    SDL_FreeSurface(surface);
+    return EXIT_SUCCESS;
+}